@@ -0,0 +1,35 @@
+#pragma once
+
+//
+// Transaction capture. While enabled every transfer is appended to a
+// preallocated nonpaged buffer as an SPB_CAPTURE_RECORD followed by its
+// payload, each record padded to 8 bytes. Length is written last, so a
+// zero Length marks the end of the committed records. Capture stops
+// recording once the buffer is full.
+//
+// The format is shared with the host replayer, which reads a buffer pulled
+// through the capture feature reports on any little-endian machine.
+//
+
+#if defined(DA7219_HOST_BUILD)
+#include "codec.h"
+#endif
+
+#define SPB_CAPTURE_SIZE        (64 * 1024)
+
+#define SPB_CAPTURE_READ        0x00
+#define SPB_CAPTURE_WRITE       0x01
+#define SPB_CAPTURE_ASYNC       0x80 // write queued from the request pool, Status is STATUS_PENDING
+
+typedef struct _SPB_CAPTURE_RECORD
+{
+	USHORT Length; // whole record including padding
+	UCHAR Direction;
+	UCHAR Register; // first address byte, 0 for raw writes
+	NTSTATUS Status;
+	LONG64 Timestamp; // performance counter ticks
+	USHORT DataLength; // bytes read or written after the address
+	USHORT Reserved[3];
+} SPB_CAPTURE_RECORD;
+
+C_ASSERT(sizeof(SPB_CAPTURE_RECORD) == 24);
@@ -0,0 +1,1582 @@
+#include "codec.h"
+#include "regmap.h"
+
+#define bool int
+#define true 1
+#define false 0
+
+//Register map indexed by address, a lookup is a single array index
+#define DA7219_REG_INFO_ENTRY(reg, def, flags, fields) \
+	[reg] = { (flags), (def), (UCHAR)(fields) },
+
+const DA7219_REG_INFO da7219_reg_info[DA7219_REG_COUNT] = {
+	DA7219_REGMAP(DA7219_REG_INFO_ENTRY)
+};
+
+#undef DA7219_REG_INFO_ENTRY
+
+//Every entry must fit the address space, be readable, and not claim a cached default for a volatile register
+#define DA7219_REG_CHECK(reg, def, flags, fields) \
+	C_ASSERT((reg) < DA7219_REG_COUNT); \
+	C_ASSERT(((flags) & DA7219_REG_READABLE) != 0); \
+	C_ASSERT(((flags) & (DA7219_REG_VOLATILE | DA7219_REG_DEFAULT)) != (DA7219_REG_VOLATILE | DA7219_REG_DEFAULT)); \
+	C_ASSERT((def) <= 0xFF && (fields) <= 0xFF);
+
+DA7219_REGMAP(DA7219_REG_CHECK)
+
+#undef DA7219_REG_CHECK
+
+//A switch, so a register listed twice in DA7219_REGMAP fails to compile
+const char* da7219_reg_name(uint8_t reg) {
+#define DA7219_REG_NAME_CASE(reg, def, flags, fields) \
+	case reg: return #reg;
+
+	switch (reg) {
+	DA7219_REGMAP(DA7219_REG_NAME_CASE)
+	default:
+		return NULL;
+	}
+
+#undef DA7219_REG_NAME_CASE
+}
+
+static bool da7219_volatile_register(uint8_t reg) {
+	return (da7219_reg_info[reg].Flags & DA7219_REG_VOLATILE) != 0;
+}
+
+VOID da7219_bus_set_cost(
+	_In_ PDA7219_CODEC codec,
+	ULONG busHz,
+	ULONG transactionOverheadNs
+) {
+	codec->BusCost.BusHz = busHz ? busHz : DA7219_I2C_FAST_HZ;
+	codec->BusCost.TransactionOverheadNs = transactionOverheadNs;
+}
+
+//Estimated bus time of one register transfer of count bytes
+//9 clocks per byte with ACK: device address and register address, plus the
+//repeated start and second device address of a read. START/STOP are ~1 clock each.
+static uint64_t da7219_bus_bits(
+	BOOLEAN read,
+	ULONG count
+) {
+	uint64_t bits = 9ULL * (2 + count) + 2;
+	if (read) {
+		bits += 9 + 1;
+	}
+	return bits;
+}
+
+uint64_t da7219_bus_cost_ns(
+	_In_ PDA7219_CODEC codec,
+	BOOLEAN read,
+	ULONG count
+) {
+	return da7219_bus_bits(read, count) * 1000000000ULL / codec->BusCost.BusHz + codec->BusCost.TransactionOverheadNs;
+}
+
+//Everything the core has put on the bus since the last reset, interrupt acknowledges included.
+//IrqBusStats is never cleared under a running acknowledge, a reset moves IrqBusBase up to it
+//instead. Its counters only grow, so an acknowledge caught half counted is at worst counted
+//in the next read, never lost or negative.
+VOID da7219_bus_stats(
+	_In_ PDA7219_CODEC codec,
+	_Out_ PDA7219_BUS_STATS stats,
+	BOOLEAN reset
+) {
+	DA7219_BUS_STATS irq = codec->IrqBusStats;
+
+	stats->Reads = codec->BusStats.Reads + irq.Reads - codec->IrqBusBase.Reads;
+	stats->Writes = codec->BusStats.Writes + irq.Writes - codec->IrqBusBase.Writes;
+	stats->BytesRead = codec->BusStats.BytesRead + irq.BytesRead - codec->IrqBusBase.BytesRead;
+	stats->BytesWritten = codec->BusStats.BytesWritten + irq.BytesWritten - codec->IrqBusBase.BytesWritten;
+	stats->BusTimeNs = codec->BusStats.BusTimeNs + irq.BusTimeNs - codec->IrqBusBase.BusTimeNs;
+	if (reset) {
+		RtlZeroMemory(&codec->BusStats, sizeof(codec->BusStats));
+		codec->IrqBusBase = irq;
+	}
+}
+
+//Most transactions and payload bytes a scenario may cost with every retry and poll taken;
+//raising one needs a reason.
+//Boot and cold resume are the worst case SYSTEM_STATUS poll (55/71, 41/63) plus about a tenth,
+//cold resume taking a signature mismatch before it. Warm resume is the signature read and
+//syncing back the three registers suspend changes (4/14) with one transaction spare.
+//Suspend and the interrupt scenarios are fixed transfers with no retries and stay exact.
+const DA7219_SCENARIO_BUDGET da7219_scenario_budget[Da7219ScenarioCount] = {
+	{ 60, 78 },	//Da7219ScenarioBoot
+	{ 5, 16 },	//Da7219ScenarioResumeWarm
+	{ 45, 70 },	//Da7219ScenarioResumeCold
+	{ 3, 3 },	//Da7219ScenarioSuspend
+	{ 2, 6 },	//Da7219ScenarioInsert
+	{ 2, 6 },	//Da7219ScenarioRemove
+	{ 2, 6 },	//Da7219ScenarioButton
+};
+
+//Charges the traffic since start to scenario and checks it against the budget
+static void da7219_scenario_account(
+	_In_ PDA7219_CODEC codec,
+	DA7219_SCENARIO scenario,
+	const DA7219_BUS_STATS* counters,
+	const DA7219_BUS_STATS* start
+) {
+	PDA7219_SCENARIO_STATS stats = &codec->Scenarios[scenario];
+	const DA7219_SCENARIO_BUDGET* budget = &da7219_scenario_budget[scenario];
+	DA7219_BUS_STATS run;
+
+	run.Reads = counters->Reads - start->Reads;
+	run.Writes = counters->Writes - start->Writes;
+	run.BytesRead = counters->BytesRead - start->BytesRead;
+	run.BytesWritten = counters->BytesWritten - start->BytesWritten;
+	run.BusTimeNs = counters->BusTimeNs - start->BusTimeNs;
+
+	stats->Runs++;
+	stats->Last = run;
+	if (run.Reads + run.Writes > stats->Worst.Reads + stats->Worst.Writes) {
+		stats->Worst = run;
+	}
+
+	if (run.Reads + run.Writes > budget->Transactions ||
+		run.BytesRead + run.BytesWritten > budget->Bytes) {
+		stats->OverBudget++;
+		Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_ERROR, DA7219_TRACE_BUS,
+			Da7219TraceOverBudget, (uint8_t)scenario,
+			(run.Reads + run.Writes) << 16 | (run.BytesRead + run.BytesWritten), STATUS_SUCCESS);
+	}
+}
+
+static NTSTATUS da7219_bus_read(
+	_In_ PDA7219_CODEC codec,
+	_In_ PDA7219_BUS_STATS counters,
+	uint8_t reg,
+	uint8_t* data,
+	ULONG count
+) {
+	NTSTATUS status;
+
+	counters->Reads++;
+	counters->BytesRead += count;
+	counters->BusTimeNs += da7219_bus_cost_ns(codec, TRUE, count);
+
+	status = codec->Bus.Read(codec->Bus.Context, reg, data, count);
+	Da7219Trace(codec->Trace,
+		NT_SUCCESS(status) ? DA7219_TRACE_LEVEL_VERBOSE : DA7219_TRACE_LEVEL_ERROR, DA7219_TRACE_BUS,
+		Da7219TraceRegRead, reg, count << 8 | data[0], status);
+	return status;
+}
+
+//Reads several ranges as one transaction when the bus supports it, one read per range otherwise
+static NTSTATUS da7219_bus_read_ranges(
+	_In_ PDA7219_CODEC codec,
+	const DA7219_BUS_RANGE* ranges,
+	ULONG count
+) {
+	NTSTATUS status = STATUS_SUCCESS;
+	uint64_t bits = 0;
+	ULONG i;
+
+	if (!codec->Bus.ReadRanges || count > DA7219_BUS_RANGES_MAX) {
+		for (i = 0; i < count && NT_SUCCESS(status); i++) {
+			status = da7219_bus_read(codec, &codec->BusStats, ranges[i].Reg, ranges[i].Data, ranges[i].Count);
+		}
+		return status;
+	}
+
+	codec->BusStats.Reads++;
+	for (i = 0; i < count; i++) {
+		codec->BusStats.BytesRead += ranges[i].Count;
+		bits += da7219_bus_bits(TRUE, ranges[i].Count);
+	}
+	codec->BusStats.BusTimeNs += bits * 1000000000ULL / codec->BusCost.BusHz + codec->BusCost.TransactionOverheadNs;
+
+	status = codec->Bus.ReadRanges(codec->Bus.Context, ranges, count);
+	for (i = 0; i < count; i++) {
+		Da7219Trace(codec->Trace,
+			NT_SUCCESS(status) ? DA7219_TRACE_LEVEL_VERBOSE : DA7219_TRACE_LEVEL_ERROR, DA7219_TRACE_BUS,
+			Da7219TraceRegRead, ranges[i].Reg, ranges[i].Count << 8 | ranges[i].Data[0], status);
+	}
+	return status;
+}
+
+static NTSTATUS da7219_bus_write(
+	_In_ PDA7219_CODEC codec,
+	_In_ PDA7219_BUS_STATS counters,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count,
+	BOOLEAN async
+) {
+	NTSTATUS status;
+
+	counters->Writes++;
+	counters->BytesWritten += count;
+	counters->BusTimeNs += da7219_bus_cost_ns(codec, FALSE, count);
+
+	if (async && codec->Bus.WriteAsync) {
+		status = codec->Bus.WriteAsync(codec->Bus.Context, reg, data, count);
+	}
+	else {
+		status = codec->Bus.Write(codec->Bus.Context, reg, data, count);
+	}
+	Da7219Trace(codec->Trace,
+		NT_SUCCESS(status) ? DA7219_TRACE_LEVEL_VERBOSE : DA7219_TRACE_LEVEL_ERROR, DA7219_TRACE_BUS,
+		Da7219TraceRegWrite, reg, count << 8 | data[0], status);
+	return status;
+}
+
+static void da7219_cache_store(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	uint8_t val
+) {
+	if (da7219_volatile_register(reg)) {
+		return;
+	}
+	codec->RegCache[reg] = val;
+	codec->RegCacheValid[reg] = TRUE;
+}
+
+static void da7219_cache_invalidate(
+	_In_ PDA7219_CODEC codec
+) {
+	RtlZeroMemory(codec->RegCacheValid, sizeof(codec->RegCacheValid));
+}
+
+static void da7219_cache_load_defaults(
+	_In_ PDA7219_CODEC codec
+) {
+	da7219_cache_invalidate(codec);
+	for (ULONG reg = 0; reg < DA7219_REG_COUNT; reg++) {
+		if (da7219_reg_info[reg].Flags & DA7219_REG_DEFAULT) {
+			da7219_cache_store(codec, (uint8_t)reg, da7219_reg_info[reg].Default);
+		}
+	}
+}
+
+NTSTATUS da7219_reg_read(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	unsigned int* data
+) {
+	if (codec->RegCacheValid[reg]) {
+		*data = codec->RegCache[reg];
+		return STATUS_SUCCESS;
+	}
+
+	uint8_t raw_data = 0;
+	NTSTATUS status = da7219_bus_read(codec, &codec->BusStats, reg, &raw_data, sizeof(uint8_t));
+	if (NT_SUCCESS(status)) {
+		da7219_cache_store(codec, reg, raw_data);
+	}
+	*data = raw_data;
+	return status;
+}
+
+NTSTATUS da7219_reg_write(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	unsigned int data
+) {
+	uint8_t val = (uint8_t)data;
+	NTSTATUS status = da7219_bus_write(codec, &codec->BusStats, reg, &val, sizeof(uint8_t), FALSE);
+	if (NT_SUCCESS(status)) {
+		da7219_cache_store(codec, reg, val);
+	}
+	else {
+		codec->RegCacheValid[reg] = FALSE;
+	}
+	return status;
+}
+
+NTSTATUS da7219_reg_bulk_read(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	uint8_t* data,
+	unsigned int count
+) {
+	//Register reads always auto-increment, so one transfer covers the range
+	NTSTATUS status = da7219_bus_read(codec, &codec->BusStats, reg, data, count);
+	if (NT_SUCCESS(status)) {
+		for (unsigned int i = 0; i < count; i++) {
+			da7219_cache_store(codec, (uint8_t)(reg + i), data[i]);
+		}
+	}
+	return status;
+}
+
+//Reads every readable, non-precious register straight from the codec into image, bypassing
+//the cache. Each run of consecutive readable registers is one auto-increment burst, holes
+//and precious registers end a run. Bytes not read are left zero and clear in valid.
+NTSTATUS da7219_reg_snapshot(
+	_In_ PDA7219_CODEC codec,
+	_Out_ uint8_t* image,
+	_Out_ uint8_t* valid,
+	_Out_opt_ PULONG bursts
+) {
+	NTSTATUS status = STATUS_SUCCESS;
+	ULONG count = 0;
+	ULONG reg = 0;
+
+	RtlZeroMemory(image, DA7219_REG_COUNT);
+	RtlZeroMemory(valid, DA7219_REG_COUNT / 8);
+
+	while (reg < DA7219_REG_COUNT) {
+		ULONG end = reg;
+
+		while (end < DA7219_REG_COUNT &&
+			(da7219_reg_info[end].Flags & (DA7219_REG_READABLE | DA7219_REG_PRECIOUS)) == DA7219_REG_READABLE) {
+			end++;
+		}
+
+		if (end == reg) {
+			reg++;
+			continue;
+		}
+
+		status = da7219_bus_read(codec, &codec->BusStats, (uint8_t)reg, &image[reg], end - reg);
+		count++;
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		for (; reg < end; reg++) {
+			valid[reg / 8] |= 1 << (reg % 8);
+		}
+	}
+
+	if (bursts) {
+		*bursts = count;
+	}
+	return status;
+}
+
+static NTSTATUS da7219_reg_submit(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	const uint8_t* data,
+	unsigned int count,
+	BOOLEAN async
+) {
+	NTSTATUS status;
+
+	if (count == 0 || reg + count > DA7219_REG_COUNT) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	//Writes auto-increment while CIF_I2C_WRITE_MODE is left in page mode (reset default)
+	status = da7219_bus_write(codec, &codec->BusStats, reg, data, count, async);
+	for (unsigned int i = 0; i < count; i++) {
+		if (NT_SUCCESS(status)) {
+			da7219_cache_store(codec, (uint8_t)(reg + i), data[i]);
+		}
+		else {
+			codec->RegCacheValid[(uint8_t)(reg + i)] = FALSE;
+		}
+	}
+	return status;
+}
+
+NTSTATUS da7219_reg_bulk_write(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	const uint8_t* data,
+	unsigned int count
+) {
+	return da7219_reg_submit(codec, reg, data, count, FALSE);
+}
+
+//Queues the write without waiting, the cache is updated as if it succeeded
+NTSTATUS da7219_reg_bulk_write_async(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	const uint8_t* data,
+	unsigned int count
+) {
+	return da7219_reg_submit(codec, reg, data, count, TRUE);
+}
+
+//Waits for queued writes, dropping the cache if any of them failed
+NTSTATUS da7219_reg_flush(
+	_In_ PDA7219_CODEC codec
+) {
+	NTSTATUS status = STATUS_SUCCESS;
+	if (codec->Bus.Flush) {
+		status = codec->Bus.Flush(codec->Bus.Context);
+		Da7219Trace(codec->Trace,
+			NT_SUCCESS(status) ? DA7219_TRACE_LEVEL_VERBOSE : DA7219_TRACE_LEVEL_ERROR, DA7219_TRACE_BUS,
+			Da7219TraceBusFlush, 0, 0, status);
+	}
+	if (!NT_SUCCESS(status)) {
+		da7219_cache_invalidate(codec);
+	}
+	return status;
+}
+
+NTSTATUS da7219_reg_update(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	unsigned int mask,
+	unsigned int val
+) {
+	unsigned int tmp = 0, orig = 0;
+
+	//Served from the register cache unless reg is volatile
+	NTSTATUS status = da7219_reg_read(codec, reg, &orig);
+	if (!NT_SUCCESS(status)) {
+		return status;
+	}
+
+	tmp = orig & ~mask;
+	tmp |= val & mask;
+
+	if (tmp != orig) {
+		status = da7219_reg_write(codec, reg, tmp);
+	}
+	return status;
+}
+
+static bool da7219_sync_register(uint8_t reg) {
+	switch (reg) {
+	case DA7219_CHIP_ID1:
+	case DA7219_CHIP_ID2:
+	case DA7219_CHIP_REVISION:
+	case DA7219_SYSTEM_ACTIVE:
+		return false;
+	default:
+		return !da7219_volatile_register(reg);
+	}
+}
+
+//Restored ahead of / after the address ordered pass, matching the boot order
+static const uint8_t da7219_sync_first[] = { DA7219_IO_CTRL, DA7219_REFERENCES };
+static const uint8_t da7219_sync_last[] = { DA7219_ACCDET_CONFIG_1 };
+
+static bool da7219_sync_ordered(uint8_t reg) {
+	ULONG i;
+	for (i = 0; i < ARRAYSIZE(da7219_sync_first); i++) {
+		if (da7219_sync_first[i] == reg)
+			return true;
+	}
+	for (i = 0; i < ARRAYSIZE(da7219_sync_last); i++) {
+		if (da7219_sync_last[i] == reg)
+			return true;
+	}
+	return false;
+}
+
+static bool da7219_cache_dirty(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg
+) {
+	if (!codec->RegImageValid[reg] || !da7219_sync_register(reg)) {
+		return false;
+	}
+	return !codec->RegCacheValid[reg] || codec->RegCache[reg] != codec->RegImage[reg];
+}
+
+static void da7219_cache_save_image(
+	_In_ PDA7219_CODEC codec
+) {
+	RtlCopyMemory(codec->RegImage, codec->RegCache, sizeof(codec->RegImage));
+	RtlCopyMemory(codec->RegImageValid, codec->RegCacheValid, sizeof(codec->RegImageValid));
+	codec->RegImageSaved = TRUE;
+}
+
+static NTSTATUS da7219_cache_sync_one(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg
+) {
+	if (!da7219_cache_dirty(codec, reg)) {
+		return STATUS_SUCCESS;
+	}
+	return da7219_reg_write(codec, reg, codec->RegImage[reg]);
+}
+
+//Writes back every register whose cached value differs from the saved image
+static NTSTATUS da7219_cache_sync(
+	_In_ PDA7219_CODEC codec
+) {
+	NTSTATUS status = STATUS_SUCCESS;
+	ULONG i;
+
+	for (i = 0; i < ARRAYSIZE(da7219_sync_first); i++) {
+		status = da7219_cache_sync_one(codec, da7219_sync_first[i]);
+		if (!NT_SUCCESS(status)) {
+			return status;
+		}
+	}
+
+	//Coalesce runs of dirty registers into auto-increment bursts, written straight from RegImage
+	ULONG reg = 0;
+	while (reg < DA7219_REG_COUNT) {
+		ULONG count = 0;
+		while (reg + count < DA7219_REG_COUNT &&
+			!da7219_sync_ordered((uint8_t)(reg + count)) &&
+			da7219_cache_dirty(codec, (uint8_t)(reg + count))) {
+			count++;
+		}
+
+		if (count == 0) {
+			reg++;
+			continue;
+		}
+
+		status = da7219_reg_bulk_write(codec, (uint8_t)reg, &codec->RegImage[reg], count);
+		if (!NT_SUCCESS(status)) {
+			return status;
+		}
+		reg += count;
+	}
+
+	for (i = 0; i < ARRAYSIZE(da7219_sync_last); i++) {
+		status = da7219_cache_sync_one(codec, da7219_sync_last[i]);
+		if (!NT_SUCCESS(status)) {
+			return status;
+		}
+	}
+	return status;
+}
+
+//Registers read back on resume to decide whether the codec kept its state while we were out
+//of D0: chip identity, clocking, the accessory detect setup and the system enable
+static const DA7219_BUS_RANGE da7219_resume_signature[] = {
+	{ DA7219_PLL_CTRL, NULL, 1 },
+	{ DA7219_DAI_CTRL, NULL, 1 },
+	{ DA7219_CHIP_REVISION, NULL, 1 },
+	{ DA7219_ACCDET_CONFIG_1, NULL, DA7219_ACCDET_CONFIG_7 - DA7219_ACCDET_CONFIG_1 + 1 },
+	{ DA7219_SYSTEM_ACTIVE, NULL, 1 },
+};
+
+C_ASSERT(ARRAYSIZE(da7219_resume_signature) <= DA7219_BUS_RANGES_MAX);
+
+//Compares the signature, read in a single transaction, against what the cache says the codec
+//should hold now, falling back to the saved image for registers the cache lost track of
+static bool da7219_state_retained(
+	_In_ PDA7219_CODEC codec
+) {
+	DA7219_BUS_RANGE ranges[ARRAYSIZE(da7219_resume_signature)];
+	uint8_t hw[DA7219_REG_COUNT];
+	ULONG i;
+
+	for (i = 0; i < ARRAYSIZE(ranges); i++) {
+		ranges[i] = da7219_resume_signature[i];
+		ranges[i].Data = &hw[ranges[i].Reg];
+	}
+
+	if (!NT_SUCCESS(da7219_bus_read_ranges(codec, ranges, ARRAYSIZE(ranges)))) {
+		return false;
+	}
+
+	for (i = 0; i < ARRAYSIZE(ranges); i++) {
+		for (ULONG reg = ranges[i].Reg; reg < ranges[i].Reg + ranges[i].Count; reg++) {
+			uint8_t expected;
+
+			if (codec->RegCacheValid[reg]) {
+				expected = codec->RegCache[reg];
+			}
+			else if (codec->RegImageValid[reg]) {
+				expected = codec->RegImage[reg];
+			}
+			else {
+				return false;
+			}
+
+			if (hw[reg] != expected) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+VOID da7219_codec_init(
+	_In_ PDA7219_CODEC codec,
+	const DA7219_BUS* bus
+) {
+	RtlZeroMemory(codec, sizeof(*codec));
+	codec->Bus = *bus;
+	da7219_bus_set_cost(codec, DA7219_I2C_FAST_HZ, 0);
+
+	//Audio stacks that never send stream reports get both paths powered whenever booted
+	codec->Streams = DA7219_PATH_STREAMS;
+}
+
+/* Gain ramping, pop-free HP defaults, tone gen and AAD init, common to every platform */
+#define DA7219_SEQ_DEFAULTS \
+	/* Default PC counter to free-running */ \
+	DA7219_SEQ_UPDATE(DA7219_PC_COUNT, DA7219_PC_FREERUN_MASK, DA7219_PC_FREERUN_MASK), \
+	/* Default gain ramping */ \
+	DA7219_SEQ_UPDATE(DA7219_MIXIN_L_CTRL, DA7219_MIXIN_L_AMP_RAMP_EN_MASK, DA7219_MIXIN_L_AMP_RAMP_EN_MASK), \
+	DA7219_SEQ_UPDATE(DA7219_ADC_L_CTRL, DA7219_ADC_L_RAMP_EN_MASK, DA7219_ADC_L_RAMP_EN_MASK), \
+	DA7219_SEQ_UPDATE(DA7219_DAC_L_CTRL, DA7219_DAC_L_RAMP_EN_MASK, DA7219_DAC_L_RAMP_EN_MASK), \
+	DA7219_SEQ_UPDATE(DA7219_DAC_R_CTRL, DA7219_DAC_R_RAMP_EN_MASK, DA7219_DAC_R_RAMP_EN_MASK), \
+	DA7219_SEQ_UPDATE(DA7219_HP_L_CTRL, DA7219_HP_L_AMP_RAMP_EN_MASK, DA7219_HP_L_AMP_RAMP_EN_MASK), \
+	DA7219_SEQ_UPDATE(DA7219_HP_R_CTRL, DA7219_HP_R_AMP_RAMP_EN_MASK, DA7219_HP_R_AMP_RAMP_EN_MASK), \
+	/* Default minimum gain on HP to avoid pops during DAPM sequencing */ \
+	DA7219_SEQ_UPDATE(DA7219_HP_L_CTRL, DA7219_HP_L_AMP_MIN_GAIN_EN_MASK, DA7219_HP_L_AMP_MIN_GAIN_EN_MASK), \
+	DA7219_SEQ_UPDATE(DA7219_HP_R_CTRL, DA7219_HP_R_AMP_MIN_GAIN_EN_MASK, DA7219_HP_R_AMP_MIN_GAIN_EN_MASK), \
+	/* Default infinite tone gen, start/stop by Kcontrol */ \
+	DA7219_SEQ_WRITE(DA7219_TONE_GEN_CYCLES, DA7219_BEEP_CYCLES_MASK), \
+	/* AAD init */ \
+	DA7219_SEQ_UPDATE(DA7219_ACCDET_CONFIG_1, DA7219_MIC_DET_THRESH_MASK, DA7219_AAD_MIC_DET_THR_500_OHMS), \
+	DA7219_SEQ_UPDATE(DA7219_ACCDET_CONFIG_2, DA7219_JACKDET_DEBOUNCE_MASK | DA7219_JACK_DETECT_RATE_MASK | DA7219_JACKDET_REM_DEB_MASK, \
+		DA7219_AAD_JACK_INS_DEB_20MS | DA7219_AAD_JACK_DET_RATE_32_64MS | DA7219_AAD_JACK_REM_DEB_1MS), \
+	DA7219_SEQ_WRITE(DA7219_ACCDET_CONFIG_3, 0xA), \
+	DA7219_SEQ_WRITE(DA7219_ACCDET_CONFIG_4, 0x16), \
+	DA7219_SEQ_WRITE(DA7219_ACCDET_CONFIG_5, 0x21), \
+	DA7219_SEQ_WRITE(DA7219_ACCDET_CONFIG_6, 0x3e), \
+	DA7219_SEQ_UPDATE(DA7219_ACCDET_CONFIG_7, DA7219_BUTTON_AVERAGE_MASK | DA7219_ADC_1_BIT_REPEAT_MASK, DA7219_AAD_BTN_AVG_4 | DA7219_AAD_ADC_1BIT_RPT_1)
+
+/* 48kHz with the PLL in SRM mode, used by Intel (AVS and SOF) and Ryzen */
+#define DA7219_SEQ_CLOCK_SRM \
+	DA7219_SEQ_WRITE(DA7219_SR, DA7219_SR_48000), \
+	DA7219_SEQ_WRITE(DA7219_PLL_CTRL, DA7219_PLL_MODE_SRM | DA7219_PLL_INDIV_9_TO_18_MHZ | DA7219_PLL_INDIV_4_5_TO_9_MHZ), \
+	DA7219_SEQ_WRITE(DA7219_DAI_CLK_MODE, DA7219_DAI_BCLKS_PER_WCLK_64), \
+	DA7219_SEQ_WRITE(DA7219_PLL_FRAC_TOP, 0x1E & DA7219_PLL_FBDIV_FRAC_TOP_MASK), \
+	DA7219_SEQ_WRITE(DA7219_PLL_FRAC_BOT, 0xB8 & DA7219_PLL_FBDIV_FRAC_BOT_MASK), \
+	DA7219_SEQ_WRITE(DA7219_PLL_INTEGER, 0x28 & DA7219_PLL_FBDIV_INTEGER_MASK)
+
+/* 48kHz from the PLL in normal mode, codec is the DAI clock master on Stoney */
+#define DA7219_SEQ_CLOCK_STONEY \
+	DA7219_SEQ_WRITE(DA7219_SR, DA7219_SR_48000), \
+	DA7219_SEQ_WRITE(DA7219_PLL_CTRL, DA7219_PLL_MODE_NORMAL | DA7219_PLL_INDIV_36_TO_54_MHZ), \
+	DA7219_SEQ_WRITE(DA7219_PLL_FRAC_TOP, 0x18 & DA7219_PLL_FBDIV_FRAC_TOP_MASK), \
+	DA7219_SEQ_WRITE(DA7219_PLL_FRAC_BOT, 0x93 & DA7219_PLL_FBDIV_FRAC_BOT_MASK), \
+	DA7219_SEQ_WRITE(DA7219_PLL_INTEGER, 0x20 & DA7219_PLL_FBDIV_INTEGER_MASK), \
+	DA7219_SEQ_WRITE(DA7219_DAI_CLK_MODE, DA7219_DAI_CLK_EN_MASK | DA7219_DAI_BCLKS_PER_WCLK_64)
+
+/* DAI routing, capture and playback paths left powered down, then arm jack detection */
+#define DA7219_SEQ_PATHS \
+	DA7219_SEQ_WRITE(DA7219_DIG_ROUTING_DAI, 0), \
+	DA7219_SEQ_WRITE(DA7219_DAI_CTRL, DA7219_DAI_FORMAT_I2S | (2 << DA7219_DAI_CH_NUM_SHIFT) | DA7219_DAI_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_DAI_TDM_CTRL, DA7219_DAI_OE_MASK), \
+	DA7219_SEQ_WRITE(DA7219_MIXIN_L_SELECT, DA7219_MIXIN_L_MIX_SELECT_MASK), \
+	DA7219_SEQ_WRITE(DA7219_MIXIN_L_GAIN, 0xA), \
+	DA7219_SEQ_WRITE(DA7219_MIC_1_GAIN, 0x5), \
+	DA7219_SEQ_WRITE(DA7219_CP_CTRL, 0xE0 & ~DA7219_CP_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_HP_L_GAIN, 0x3F), \
+	DA7219_SEQ_WRITE(DA7219_HP_R_GAIN, 0x3F), \
+	DA7219_SEQ_WRITE(DA7219_MIXOUT_L_SELECT, DA7219_MIXOUT_L_MIX_SELECT_MASK), \
+	DA7219_SEQ_WRITE(DA7219_MIXOUT_R_SELECT, DA7219_MIXOUT_R_MIX_SELECT_MASK), \
+	DA7219_SEQ_WRITE(DA7219_MICBIAS_CTRL, 0x0D & ~DA7219_MICBIAS1_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_MIC_1_CTRL, 0), \
+	DA7219_SEQ_WRITE(DA7219_MIXIN_L_CTRL, DA7219_MIXIN_L_AMP_RAMP_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_ADC_L_CTRL, DA7219_ADC_L_RAMP_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_DAC_L_CTRL, 8 | DA7219_DAC_L_RAMP_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_DAC_R_CTRL, DA7219_DAC_R_RAMP_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_HP_L_CTRL, DA7219_HP_L_AMP_RAMP_EN_MASK | DA7219_HP_L_AMP_MIN_GAIN_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_HP_R_CTRL, DA7219_HP_R_AMP_RAMP_EN_MASK | DA7219_HP_R_AMP_MIN_GAIN_EN_MASK), \
+	DA7219_SEQ_WRITE(DA7219_MIXOUT_L_CTRL, 0), \
+	DA7219_SEQ_WRITE(DA7219_MIXOUT_R_CTRL, 0), \
+	DA7219_SEQ_WRITE(DA7219_GAIN_RAMP_CTRL, DA7219_GAIN_RAMP_RATE_NOMINAL), \
+	DA7219_SEQ_WRITE(DA7219_PC_COUNT, DA7219_PC_RESYNC_AUTO_MASK), \
+	DA7219_SEQ_WRITE(DA7219_ACCDET_CONFIG_1, 0xD9), \
+	DA7219_SEQ_WRITE(DA7219_ACCDET_CONFIG_2, 0x04)
+
+static const DA7219_SEQ_ENTRY da7219_intel_power[] = {
+	DA7219_SEQ_WRITE(DA7219_IO_CTRL, DA7219_IO_VOLTAGE_LEVEL_2_5V_3_6V),
+	DA7219_SEQ_UPDATE(DA7219_REFERENCES, DA7219_BIAS_EN_MASK, DA7219_BIAS_EN_MASK),
+};
+
+static const DA7219_SEQ_ENTRY da7219_intel_setup[] = {
+	DA7219_SEQ_DEFAULTS,
+	DA7219_SEQ_CLOCK_SRM,
+	DA7219_SEQ_PATHS,
+};
+
+static const DA7219_SEQ_ENTRY da7219_stoney_power[] = {
+	DA7219_SEQ_WRITE(DA7219_IO_CTRL, DA7219_IO_VOLTAGE_LEVEL_1_2V_2_8V),
+	DA7219_SEQ_UPDATE(DA7219_REFERENCES, DA7219_BIAS_EN_MASK, DA7219_BIAS_EN_MASK),
+};
+
+static const DA7219_SEQ_ENTRY da7219_stoney_setup[] = {
+	DA7219_SEQ_DEFAULTS,
+	DA7219_SEQ_CLOCK_STONEY,
+	DA7219_SEQ_PATHS,
+};
+
+static const DA7219_SEQ_ENTRY da7219_ryzen_power[] = {
+	DA7219_SEQ_WRITE(DA7219_IO_CTRL, DA7219_IO_VOLTAGE_LEVEL_2_5V_3_6V),
+	DA7219_SEQ_UPDATE(DA7219_REFERENCES, DA7219_BIAS_EN_MASK, DA7219_BIAS_EN_MASK),
+};
+
+static const DA7219_SEQ_ENTRY da7219_ryzen_setup[] = {
+	DA7219_SEQ_DEFAULTS,
+	DA7219_SEQ_CLOCK_SRM,
+	DA7219_SEQ_PATHS,
+};
+
+//Indexed by Platform, unknown platforms get the Intel settings
+static const DA7219_PLATFORM_INIT da7219_platform_init[] = {
+	{ da7219_intel_power, ARRAYSIZE(da7219_intel_power), da7219_intel_setup, ARRAYSIZE(da7219_intel_setup) },	//PlatformNone
+	{ da7219_intel_power, ARRAYSIZE(da7219_intel_power), da7219_intel_setup, ARRAYSIZE(da7219_intel_setup) },	//PlatformIntel
+	{ da7219_stoney_power, ARRAYSIZE(da7219_stoney_power), da7219_stoney_setup, ARRAYSIZE(da7219_stoney_setup) },	//PlatformStoney
+	{ da7219_ryzen_power, ARRAYSIZE(da7219_ryzen_power), da7219_ryzen_setup, ARRAYSIZE(da7219_ryzen_setup) },	//PlatformRyzen
+};
+
+static NTSTATUS da7219_seq_update(
+	_In_ PDA7219_CODEC codec,
+	uint8_t reg,
+	unsigned int mask,
+	unsigned int val
+) {
+	unsigned int orig = 0;
+	uint8_t tmp;
+
+	//Served from the register cache unless reg is volatile
+	NTSTATUS status = da7219_reg_read(codec, reg, &orig);
+	if (!NT_SUCCESS(status)) {
+		return status;
+	}
+
+	tmp = (uint8_t)((orig & ~mask) | (val & mask));
+	if (tmp == orig) {
+		return status;
+	}
+	return da7219_reg_bulk_write_async(codec, reg, &tmp, 1);
+}
+
+//Runs seq from *cursor, returning STATUS_PENDING with *delay set when an entry asks to wait.
+//Writes are pipelined and only waited for before returning.
+static NTSTATUS da7219_run_sequence(
+	_In_ PDA7219_CODEC codec,
+	const DA7219_SEQ_ENTRY* seq,
+	ULONG length,
+	PULONG cursor,
+	PULONG delay
+) {
+	NTSTATUS status = STATUS_SUCCESS;
+	ULONG i = *cursor;
+
+	while (i < length) {
+		const DA7219_SEQ_ENTRY* entry = &seq[i];
+		ULONG count = 1;
+
+		switch (entry->Op) {
+		case Da7219SeqWrite: {
+			uint8_t burst[DA7219_REG_BURST_MAX];
+			burst[0] = entry->Value;
+
+			//Merge writes to the following register addresses into one burst
+			while (i + count < length &&
+				count < DA7219_REG_BURST_MAX &&
+				seq[i + count - 1].Delay == 0 &&
+				seq[i + count].Op == Da7219SeqWrite &&
+				(ULONG)seq[i + count].Reg == (ULONG)entry->Reg + count) {
+				burst[count] = seq[i + count].Value;
+				count++;
+			}
+
+			status = da7219_reg_bulk_write_async(codec, entry->Reg, burst, count);
+			break;
+		}
+		case Da7219SeqUpdate:
+			//No bus traffic at all when the cached value already matches
+			status = da7219_seq_update(codec, entry->Reg, entry->Mask, entry->Value);
+			break;
+		default:
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		i += count;
+		*cursor = i;
+
+		if (!NT_SUCCESS(status)) {
+			da7219_reg_flush(codec);
+			return status;
+		}
+
+		if (seq[i - 1].Delay) {
+			status = da7219_reg_flush(codec);
+			if (!NT_SUCCESS(status)) {
+				return status;
+			}
+			*delay = seq[i - 1].Delay;
+			return STATUS_PENDING;
+		}
+	}
+	return da7219_reg_flush(codec);
+}
+
+typedef enum _DA7219_WIDGET_TYPE
+{
+	Da7219WidgetInput,	//endpoint, active when its stream runs or always connected
+	Da7219WidgetOutput,
+	Da7219WidgetPga,
+	Da7219WidgetSupply
+} DA7219_WIDGET_TYPE;
+
+typedef struct _DA7219_WIDGET_INFO
+{
+	const char* Name;
+
+	UCHAR Type;
+
+	UCHAR Stage; // power up order, lower first, walked backwards to power down
+
+	UCHAR Reg;
+
+	UCHAR Mask; // enable bits in Reg, endpoints have none
+
+	UCHAR MinGain; // held while the amp changes state so it never switches at gain
+
+} DA7219_WIDGET_INFO;
+
+#define DA7219_DAPM_STAGES 4
+
+//Indexed by DA7219_WIDGET
+static const DA7219_WIDGET_INFO da7219_widgets[Da7219WidgetCount] = {
+	{ "AIF In", Da7219WidgetInput, 0, 0, 0, 0 },
+	{ "AIF Out", Da7219WidgetOutput, 0, 0, 0, 0 },
+	{ "Mic", Da7219WidgetInput, 0, 0, 0, 0 },
+	{ "Headphones", Da7219WidgetOutput, 0, 0, 0, 0 },
+	{ "Mic Bias", Da7219WidgetSupply, 0, DA7219_MICBIAS_CTRL, DA7219_MICBIAS1_EN_MASK, 0 },
+	{ "Charge Pump", Da7219WidgetSupply, 0, DA7219_CP_CTRL, DA7219_CP_EN_MASK, 0 },
+	{ "Mic PGA", Da7219WidgetPga, 1, DA7219_MIC_1_CTRL, DA7219_MIC_1_AMP_EN_MASK, 0 },
+	{ "Mixin PGA", Da7219WidgetPga, 2, DA7219_MIXIN_L_CTRL, DA7219_MIXIN_L_AMP_EN_MASK | DA7219_MIXIN_L_MIX_EN_MASK, 0 },
+	{ "ADC", Da7219WidgetPga, 3, DA7219_ADC_L_CTRL, DA7219_ADC_L_EN_MASK, 0 },
+	{ "DACL", Da7219WidgetPga, 1, DA7219_DAC_L_CTRL, DA7219_DAC_L_EN_MASK, 0 },
+	{ "DACR", Da7219WidgetPga, 1, DA7219_DAC_R_CTRL, DA7219_DAC_R_EN_MASK, 0 },
+	{ "Mixout Left PGA", Da7219WidgetPga, 2, DA7219_MIXOUT_L_CTRL, DA7219_MIXOUT_L_AMP_EN_MASK, 0 },
+	{ "Mixout Right PGA", Da7219WidgetPga, 2, DA7219_MIXOUT_R_CTRL, DA7219_MIXOUT_R_AMP_EN_MASK, 0 },
+	{ "Headphone Left PGA", Da7219WidgetPga, 3, DA7219_HP_L_CTRL, DA7219_HP_L_AMP_OE_MASK | DA7219_HP_L_AMP_EN_MASK, DA7219_HP_L_AMP_MIN_GAIN_EN_MASK },
+	{ "Headphone Right PGA", Da7219WidgetPga, 3, DA7219_HP_R_CTRL, DA7219_HP_R_AMP_OE_MASK | DA7219_HP_R_AMP_EN_MASK, DA7219_HP_R_AMP_MIN_GAIN_EN_MASK },
+};
+
+C_ASSERT(Da7219WidgetCount <= sizeof(USHORT) * 8);
+
+typedef struct _DA7219_ROUTE
+{
+	UCHAR Sink;
+
+	UCHAR Source;
+
+} DA7219_ROUTE;
+
+static const DA7219_ROUTE da7219_routes[] = {
+	/* Playback */
+	{ Da7219WidgetDacL, Da7219WidgetAifIn },
+	{ Da7219WidgetDacR, Da7219WidgetAifIn },
+	{ Da7219WidgetMixoutL, Da7219WidgetDacL },
+	{ Da7219WidgetMixoutR, Da7219WidgetDacR },
+	{ Da7219WidgetHpL, Da7219WidgetMixoutL },
+	{ Da7219WidgetHpR, Da7219WidgetMixoutR },
+	{ Da7219WidgetHeadphones, Da7219WidgetHpL },
+	{ Da7219WidgetHeadphones, Da7219WidgetHpR },
+	{ Da7219WidgetHpL, Da7219WidgetCp },
+	{ Da7219WidgetHpR, Da7219WidgetCp },
+
+	/* Capture */
+	{ Da7219WidgetMic1, Da7219WidgetMic },
+	{ Da7219WidgetMixinL, Da7219WidgetMic1 },
+	{ Da7219WidgetAdcL, Da7219WidgetMixinL },
+	{ Da7219WidgetAifOut, Da7219WidgetAdcL },
+	{ Da7219WidgetMic1, Da7219WidgetMicBias },
+};
+
+const char* da7219_widget_name(
+	DA7219_WIDGET widget
+) {
+	return widget < Da7219WidgetCount ? da7219_widgets[widget].Name : "?";
+}
+
+//Widgets that should be powered for the running streams and the jack
+USHORT da7219_dapm_wanted(
+	_In_ PDA7219_CODEC codec
+) {
+	USHORT forward = DA7219_WIDGET_BIT(Da7219WidgetMic);
+	USHORT backward = DA7219_WIDGET_BIT(Da7219WidgetHeadphones);
+	USHORT wanted;
+	ULONG last;
+	ULONG i;
+
+	if (codec->Streams & DA7219_PATH_PLAYBACK) {
+		forward |= DA7219_WIDGET_BIT(Da7219WidgetAifIn);
+	}
+	if (codec->Streams & DA7219_PATH_CAPTURE) {
+		backward |= DA7219_WIDGET_BIT(Da7219WidgetAifOut);
+	}
+
+	//Walk the signal routes out from the active inputs and back from the active outputs
+	do {
+		last = (ULONG)backward << 16 | forward;
+		for (i = 0; i < ARRAYSIZE(da7219_routes); i++) {
+			const DA7219_ROUTE* route = &da7219_routes[i];
+
+			if (da7219_widgets[route->Source].Type == Da7219WidgetSupply) {
+				continue;
+			}
+			if (forward & DA7219_WIDGET_BIT(route->Source)) {
+				forward |= DA7219_WIDGET_BIT(route->Sink);
+			}
+			if (backward & DA7219_WIDGET_BIT(route->Sink)) {
+				backward |= DA7219_WIDGET_BIT(route->Source);
+			}
+		}
+	} while (last != ((ULONG)backward << 16 | forward));
+
+	wanted = forward & backward;
+
+	for (i = 0; i < ARRAYSIZE(da7219_routes); i++) {
+		const DA7219_ROUTE* route = &da7219_routes[i];
+
+		if (da7219_widgets[route->Source].Type == Da7219WidgetSupply &&
+			(wanted & DA7219_WIDGET_BIT(route->Sink))) {
+			wanted |= DA7219_WIDGET_BIT(route->Source);
+		}
+	}
+
+	if (codec->Headset) {
+		wanted |= DA7219_WIDGET_BIT(Da7219WidgetMicBias);
+	}
+
+	//Endpoints have no power of their own
+	for (i = 0; i < Da7219WidgetCount; i++) {
+		if (!da7219_widgets[i].Mask) {
+			wanted &= ~DA7219_WIDGET_BIT(i);
+		}
+	}
+	return wanted;
+}
+
+//Appends the writes for every widget in mask at one stage, in register order so runs of
+//neighbouring registers go out as a single auto-increment burst
+static ULONG da7219_dapm_emit(
+	const uint8_t* values,
+	USHORT mask,
+	_Out_ PDA7219_SEQ_ENTRY plan,
+	ULONG length
+) {
+	ULONG reg = 0;
+
+	for (;;) {
+		ULONG next = DA7219_REG_COUNT;
+		ULONG i;
+
+		for (i = 0; i < Da7219WidgetCount; i++) {
+			if ((mask & DA7219_WIDGET_BIT(i)) && da7219_widgets[i].Reg >= reg && da7219_widgets[i].Reg < next) {
+				next = da7219_widgets[i].Reg;
+			}
+		}
+		if (next == DA7219_REG_COUNT) {
+			return length;
+		}
+
+		plan[length].Op = Da7219SeqWrite;
+		plan[length].Reg = (UCHAR)next;
+		plan[length].Mask = 0xFF;
+		plan[length].Value = values[next];
+		plan[length].Delay = 0;
+		length++;
+		reg = next + 1;
+	}
+}
+
+//Plans the register writes that take the codec from WidgetsOn to wanted, touching only
+//widgets that change. Power down runs outputs first, power up supplies first, and the HP
+//amps only ever switch at minimum gain. Sets *length to the number of entries written to
+//plan. Fails without a plan when a widget register cannot be read, since every write
+//carries the rest of its register along.
+NTSTATUS da7219_dapm_plan(
+	_In_ PDA7219_CODEC codec,
+	USHORT wanted,
+	_Out_ PDA7219_SEQ_ENTRY plan,
+	_Out_ PULONG length
+) {
+	USHORT down = codec->WidgetsOn & ~wanted;
+	USHORT up = wanted & ~codec->WidgetsOn;
+	USHORT gain = 0;
+	uint8_t values[DA7219_REG_COUNT];
+	ULONG i;
+	LONG stage;
+
+	*length = 0;
+
+	for (i = 0; i < Da7219WidgetCount; i++) {
+		const DA7219_WIDGET_INFO* widget = &da7219_widgets[i];
+		unsigned int value;
+		NTSTATUS status;
+
+		if (!widget->Mask) {
+			continue;
+		}
+		status = da7219_reg_read(codec, widget->Reg, &value);
+		if (!NT_SUCCESS(status)) {
+			return status;
+		}
+		values[widget->Reg] = (uint8_t)value;
+
+		if (widget->MinGain && ((down | up) & DA7219_WIDGET_BIT(i))) {
+			gain |= DA7219_WIDGET_BIT(i);
+		}
+	}
+
+	//Drop to minimum gain and let the ramp finish before the amps switch off
+	if (gain & down) {
+		for (i = 0; i < Da7219WidgetCount; i++) {
+			if (gain & down & DA7219_WIDGET_BIT(i)) {
+				values[da7219_widgets[i].Reg] |= da7219_widgets[i].MinGain;
+			}
+		}
+		*length = da7219_dapm_emit(values, gain & down, plan, *length);
+		plan[*length - 1].Delay = DA7219_MIN_GAIN_DELAY;
+	}
+
+	for (stage = DA7219_DAPM_STAGES - 1; stage >= 0; stage--) {
+		USHORT mask = 0;
+
+		for (i = 0; i < Da7219WidgetCount; i++) {
+			if ((down & DA7219_WIDGET_BIT(i)) && da7219_widgets[i].Stage == stage) {
+				values[da7219_widgets[i].Reg] &= ~da7219_widgets[i].Mask;
+				mask |= DA7219_WIDGET_BIT(i);
+			}
+		}
+		*length = da7219_dapm_emit(values, mask, plan, *length);
+	}
+
+	//Amps come up still at minimum gain, settle, then ramp to the programmed gain
+	for (stage = 0; stage < DA7219_DAPM_STAGES; stage++) {
+		USHORT mask = 0;
+
+		for (i = 0; i < Da7219WidgetCount; i++) {
+			if ((up & DA7219_WIDGET_BIT(i)) && da7219_widgets[i].Stage == stage) {
+				values[da7219_widgets[i].Reg] |= da7219_widgets[i].Mask | da7219_widgets[i].MinGain;
+				mask |= DA7219_WIDGET_BIT(i);
+			}
+		}
+		*length = da7219_dapm_emit(values, mask, plan, *length);
+	}
+
+	if (gain & up) {
+		plan[*length - 1].Delay = DA7219_SETTLING_DELAY;
+		for (i = 0; i < Da7219WidgetCount; i++) {
+			if (gain & up & DA7219_WIDGET_BIT(i)) {
+				values[da7219_widgets[i].Reg] &= ~da7219_widgets[i].MinGain;
+			}
+		}
+		*length = da7219_dapm_emit(values, gain & up, plan, *length);
+	}
+	return STATUS_SUCCESS;
+}
+
+static uint64_t da7219_now(
+	_In_ PDA7219_CODEC codec
+) {
+	return codec->Bus.Now ? codec->Bus.Now(codec->Bus.Context) : 0;
+}
+
+//Takes whatever a failed plan got through from the cache so the next plan finishes the job.
+//Widgets the cache lost track of are marked opposite to target, forcing a rewrite.
+static VOID da7219_dapm_recover(
+	_In_ PDA7219_CODEC codec,
+	USHORT target
+) {
+	codec->WidgetsOn = 0;
+	for (ULONG i = 0; i < Da7219WidgetCount; i++) {
+		const DA7219_WIDGET_INFO* widget = &da7219_widgets[i];
+
+		if (!widget->Mask) {
+			continue;
+		}
+		if (!codec->RegCacheValid[widget->Reg]) {
+			codec->WidgetsOn |= ~target & DA7219_WIDGET_BIT(i);
+		}
+		else if ((codec->RegCache[widget->Reg] & widget->Mask) == widget->Mask) {
+			codec->WidgetsOn |= DA7219_WIDGET_BIT(i);
+		}
+	}
+}
+
+//Runs widget power changes until the codec matches the running streams and the jack, or
+//all paths are off once PathsLive is cleared. Returns STATUS_PENDING with *delay in ms when
+//a step has to wait and the caller should call back in; calling back early only returns
+//what is left of the wait.
+NTSTATUS da7219_dapm_advance(
+	_In_ PDA7219_CODEC codec,
+	_Out_ PULONG delay
+) {
+	NTSTATUS status;
+	USHORT before;
+
+	*delay = 0;
+
+	for (;;) {
+		if (codec->DapmRunning) {
+			uint64_t now = da7219_now(codec);
+
+			if (codec->Bus.Now && now < codec->DapmResumeUs) {
+				*delay = (ULONG)((codec->DapmResumeUs - now + 999) / 1000);
+				return STATUS_PENDING;
+			}
+		}
+		else {
+			USHORT wanted = codec->PathsLive ? da7219_dapm_wanted(codec) : 0;
+
+			if (wanted == codec->WidgetsOn) {
+				return STATUS_SUCCESS;
+			}
+
+			//Nothing is written on a failed read, the next call plans again
+			status = da7219_dapm_plan(codec, wanted, codec->DapmPlan, &codec->DapmPlanLength);
+			if (!NT_SUCCESS(status)) {
+				Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_ERROR, DA7219_TRACE_POWER,
+					Da7219TracePaths, 0, (ULONG)codec->WidgetsOn << 16 | codec->WidgetsOn, status);
+				return status;
+			}
+
+			codec->DapmTarget = wanted;
+			codec->DapmIndex = 0;
+			codec->DapmRunning = TRUE;
+		}
+
+		status = da7219_run_sequence(codec, codec->DapmPlan, codec->DapmPlanLength,
+			&codec->DapmIndex, delay);
+		if (status == STATUS_PENDING) {
+			codec->DapmResumeUs = da7219_now(codec) + (uint64_t)*delay * 1000;
+			return status;
+		}
+
+		codec->DapmRunning = FALSE;
+		before = codec->WidgetsOn;
+		if (NT_SUCCESS(status)) {
+			codec->WidgetsOn = codec->DapmTarget;
+		}
+		else {
+			da7219_dapm_recover(codec, codec->DapmTarget);
+		}
+
+		Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_POWER,
+			Da7219TracePaths, 0, (ULONG)before << 16 | codec->WidgetsOn, status);
+		if (!NT_SUCCESS(status)) {
+			return status;
+		}
+	}
+}
+
+//Runs widget power changes to the end, waiting through the bus Delay hook
+NTSTATUS da7219_dapm_blocking(
+	_In_ PDA7219_CODEC codec
+) {
+	NTSTATUS status;
+	ULONG delay;
+
+	while ((status = da7219_dapm_advance(codec, &delay)) == STATUS_PENDING) {
+		if (codec->Bus.Delay) {
+			codec->Bus.Delay(codec->Bus.Context, delay);
+		}
+	}
+	return status;
+}
+
+//Starts bringing widget power in line with what changed. A plan already in flight plans
+//again once it is through, so its caller has nothing more to do.
+static NTSTATUS da7219_dapm_sync(
+	_In_ PDA7219_CODEC codec,
+	_Out_ PULONG delay
+) {
+	*delay = 0;
+	if (codec->DapmRunning) {
+		return STATUS_SUCCESS;
+	}
+	return da7219_dapm_advance(codec, delay);
+}
+
+//Stream start/stop from the audio stack. Before boot completes only the request is recorded.
+//The first report drops the always-on default, from then on only reported streams are powered.
+//Returns STATUS_PENDING with *delay like da7219_dapm_advance when the paths are still changing.
+NTSTATUS da7219_codec_stream(
+	_In_ PDA7219_CODEC codec,
+	UCHAR paths,
+	BOOLEAN active,
+	_Out_ PULONG delay
+) {
+	*delay = 0;
+
+	if (paths & ~DA7219_PATH_STREAMS) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if (!codec->StreamsReported) {
+		codec->StreamsReported = TRUE;
+		codec->Streams = 0;
+	}
+
+	if (active) {
+		codec->Streams |= paths;
+	}
+	else {
+		codec->Streams &= ~paths;
+	}
+	return da7219_dapm_sync(codec, delay);
+}
+
+//Fast first checks, then back off to DA7219_SYS_STAT_CHECK_DELAY
+static const ULONG da7219_sys_stat_poll_ms[] = { 2, 5, 10, 20, 40 };
+
+static ULONG da7219_sys_stat_poll_interval(ULONG attempt) {
+	if (attempt < ARRAYSIZE(da7219_sys_stat_poll_ms)) {
+		return da7219_sys_stat_poll_ms[attempt];
+	}
+	return DA7219_SYS_STAT_CHECK_DELAY;
+}
+
+//Charges the time since the last transition to the state being left, waits included
+static void da7219_boot_enter(
+	_In_ PDA7219_CODEC codec,
+	DA7219_BOOT_STATE state
+) {
+	uint64_t now = da7219_now(codec);
+
+	if (codec->BootState < BootStateComplete) {
+		codec->BootStateUs[codec->BootState] += (ULONG)(now - codec->BootStateEntered);
+	}
+	codec->BootStateEntered = now;
+	codec->BootState = state;
+}
+
+//Arms the boot state machine, the caller then drives it with da7219_boot_advance
+VOID da7219_boot_start(
+	_In_ PDA7219_CODEC codec,
+	Platform platform
+) {
+	codec->BootPlatform = platform;
+	codec->BootState = BootStateStart;
+	codec->BootStateEntered = da7219_now(codec);
+	RtlZeroMemory(codec->BootStateUs, sizeof(codec->BootStateUs));
+	codec->BootResume = codec->RegImageSaved;
+	codec->BootWarm = FALSE;
+	codec->BootStart = codec->BusStats;
+	codec->PathsLive = FALSE;
+	codec->Headset = FALSE;
+
+	//A path change left waiting when the device went down is dropped, every boot path ends
+	//with all paths off
+	codec->DapmRunning = FALSE;
+	codec->WidgetsOn = 0;
+}
+
+//Runs the boot state machine until it either completes or has to wait for the codec.
+//Returns STATUS_PENDING with *delay in ms when the caller should wait and call back in,
+//STATUS_SUCCESS once booted, STATUS_INVALID_DEVICE_STATE if no boot was started.
+NTSTATUS da7219_boot_advance(
+	_In_ PDA7219_CODEC codec,
+	_Out_ PULONG delay
+) {
+	const DA7219_PLATFORM_INIT* init = &da7219_platform_init[codec->BootPlatform];
+	NTSTATUS status;
+	unsigned int value;
+
+	*delay = 0;
+
+	for (;;) {
+		Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_BOOT,
+			Da7219TraceBootState, 0, codec->BootState, STATUS_SUCCESS);
+
+		switch (codec->BootState) {
+		case BootStateStart:
+			if (codec->RegImageSaved && da7219_state_retained(codec)) {
+				//Codec kept its state, only undo what OnD0Exit changed
+				if (NT_SUCCESS(da7219_cache_sync(codec))) {
+					codec->BootWarm = TRUE;
+					da7219_boot_enter(codec, BootStateComplete);
+					break;
+				}
+			}
+
+			//The codec may have lost power since the cache was last filled
+			da7219_cache_invalidate(codec);
+
+			da7219_reg_read(codec, DA7219_SYSTEM_ACTIVE, &value);
+			if (value) {
+				da7219_reg_write(codec, DA7219_GAIN_RAMP_CTRL,
+					DA7219_GAIN_RAMP_RATE_NOMINAL);
+				da7219_reg_write(codec, DA7219_SYSTEM_MODES_INPUT, 0x00);
+				da7219_reg_write(codec, DA7219_SYSTEM_MODES_OUTPUT, 0x01);
+
+				codec->BootPollCount = 0;
+				codec->BootPollElapsed = 0;
+				da7219_boot_enter(codec, BootStateWaitStandby);
+			}
+			else {
+				da7219_boot_enter(codec, BootStateReset);
+			}
+			break;
+
+		case BootStateWaitStandby:
+			da7219_reg_read(codec, DA7219_SYSTEM_STATUS, &value);
+			if (!value ||
+				codec->BootPollElapsed >= DA7219_SYS_STAT_CHECK_RETRIES * DA7219_SYS_STAT_CHECK_DELAY) {
+				da7219_boot_enter(codec, BootStateReset);
+				break;
+			}
+
+			*delay = da7219_sys_stat_poll_interval(codec->BootPollCount++);
+			codec->BootPollElapsed += *delay;
+			Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_BOOT,
+				Da7219TraceBootWait, 0, *delay, STATUS_PENDING);
+			return STATUS_PENDING;
+
+		case BootStateReset:
+			/* Soft reset component */
+			da7219_reg_update(codec, DA7219_ACCDET_CONFIG_1,
+				DA7219_ACCDET_EN_MASK, 0);
+			da7219_reg_update(codec, DA7219_CIF_CTRL,
+				DA7219_CIF_REG_SOFT_RESET_MASK,
+				DA7219_CIF_REG_SOFT_RESET_MASK);
+			da7219_cache_load_defaults(codec);
+
+			//Toggle unconditionally, the cache cannot tell whether the reset already did
+			da7219_reg_write(codec, DA7219_SYSTEM_ACTIVE, 0);
+			da7219_reg_write(codec, DA7219_SYSTEM_ACTIVE, DA7219_SYSTEM_ACTIVE_MASK);
+
+			if (codec->RegImageSaved) {
+				//Cache now holds the reset defaults, so this only writes what the boot sequence changed
+				da7219_cache_sync(codec);
+				da7219_boot_enter(codec, BootStateComplete);
+			}
+			else {
+				codec->BootSeqIndex = 0;
+				da7219_boot_enter(codec, BootStatePower);
+			}
+			break;
+
+		case BootStatePower:
+			status = da7219_run_sequence(codec, init->Power, init->PowerLength,
+				&codec->BootSeqIndex, delay);
+			if (status == STATUS_PENDING) {
+				Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_BOOT,
+					Da7219TraceBootWait, 0, *delay, STATUS_PENDING);
+				return status;
+			}
+
+			da7219_reg_read(codec, DA7219_CHIP_REVISION, &value);
+			Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_BOOT,
+				Da7219TraceChipRevision, DA7219_CHIP_REVISION, value, STATUS_SUCCESS);
+			if ((value & DA7219_CHIP_MINOR_MASK) == 0) {
+				da7219_reg_write(codec, DA7219_REFERENCES, 0x08);
+			}
+
+			codec->BootSeqIndex = 0;
+			da7219_boot_enter(codec, BootStateSetup);
+			break;
+
+		case BootStateSetup:
+			status = da7219_run_sequence(codec, init->Setup, init->SetupLength,
+				&codec->BootSeqIndex, delay);
+			if (status == STATUS_PENDING) {
+				Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_BOOT,
+					Da7219TraceBootWait, 0, *delay, STATUS_PENDING);
+				return status;
+			}
+
+			da7219_cache_save_image(codec);
+			da7219_boot_enter(codec, BootStateComplete);
+			break;
+
+		case BootStateComplete:
+			//Every boot path leaves the codec matching the image, all paths off. Bringing them
+			//back up for the running streams is da7219_dapm_advance's job, not charged here.
+			codec->WidgetsOn = 0;
+			codec->PathsLive = TRUE;
+
+			da7219_boot_enter(codec, BootStateIdle);
+			da7219_scenario_account(codec,
+				!codec->BootResume ? Da7219ScenarioBoot :
+				codec->BootWarm ? Da7219ScenarioResumeWarm : Da7219ScenarioResumeCold,
+				&codec->BusStats, &codec->BootStart);
+			return STATUS_SUCCESS;
+
+		default:
+			return STATUS_INVALID_DEVICE_STATE;
+		}
+	}
+}
+
+//Boots synchronously and brings the paths back up, waiting through the bus Delay hook
+NTSTATUS da7219_boot_blocking(
+	_In_ PDA7219_CODEC codec,
+	Platform platform
+) {
+	NTSTATUS status;
+	ULONG delay;
+
+	da7219_boot_start(codec, platform);
+	while ((status = da7219_boot_advance(codec, &delay)) == STATUS_PENDING) {
+		if (codec->Bus.Delay) {
+			codec->Bus.Delay(codec->Bus.Context, delay);
+		}
+	}
+	if (!NT_SUCCESS(status)) {
+		return status;
+	}
+	return da7219_dapm_blocking(codec);
+}
+
+//Powers every path down, then puts the codec in standby. Returns STATUS_PENDING with *delay
+//in ms while the paths are still going down, the caller waits and calls back in.
+NTSTATUS da7219_codec_suspend(
+	_In_ PDA7219_CODEC codec,
+	_Out_ PULONG delay
+) {
+	DA7219_BUS_STATS start;
+	NTSTATUS status;
+
+	codec->BootState = BootStateIdle;
+
+	//Keep Streams so whatever was running comes back up on resume. Not charged to the
+	//suspend budget, the audio stack normally stops its streams before we get here.
+	codec->PathsLive = FALSE;
+	if (da7219_dapm_advance(codec, delay) == STATUS_PENDING) {
+		return STATUS_PENDING;
+	}
+
+	start = codec->BusStats;
+
+	da7219_reg_write(codec, DA7219_PLL_CTRL, DA7219_PLL_MODE_SRM | DA7219_PLL_INDIV_9_TO_18_MHZ | DA7219_PLL_INDIV_4_5_TO_9_MHZ);
+	da7219_reg_write(codec, DA7219_DAI_CLK_MODE, DA7219_DAI_BCLKS_PER_WCLK_64);
+
+	status = da7219_reg_update(codec, DA7219_REFERENCES, DA7219_BIAS_EN_MASK, 0);
+
+	da7219_scenario_account(codec, Da7219ScenarioSuspend, &codec->BusStats, &start);
+	return status;
+}
+
+//Suspends synchronously, waiting through the bus Delay hook
+NTSTATUS da7219_suspend_blocking(
+	_In_ PDA7219_CODEC codec
+) {
+	NTSTATUS status;
+	ULONG delay;
+
+	while ((status = da7219_codec_suspend(codec, &delay)) == STATUS_PENDING) {
+		if (codec->Bus.Delay) {
+			codec->Bus.Delay(codec->Bus.Context, delay);
+		}
+	}
+	return status;
+}
+
+static VOID da7219_irq_events(
+	const DA7219_IRQ_RECORD* record,
+	_Out_ PDA7219_IRQ_EVENTS events
+) {
+	unsigned int status_a = record->StatusA;
+	unsigned int reg_a = record->EventA;
+	unsigned int reg_b = record->EventB;
+
+	RtlZeroMemory(events, sizeof(*events));
+
+	if (status_a & DA7219_JACK_INSERTION_STS_MASK) {
+		if (reg_a & DA7219_E_JACK_INSERTED_MASK) {
+			events->JackInserted = TRUE;
+		}
+		if (reg_a & DA7219_E_JACK_DETECT_COMPLETE_MASK) {
+			events->DetectComplete = TRUE;
+		}
+
+		if (status_a & DA7219_JACK_TYPE_STS_MASK) {
+			for (int i = 0; i < DA7219_AAD_MAX_BUTTONS; ++i) {
+				/* Button Release */
+				if (reg_b &
+					(DA7219_E_BUTTON_A_RELEASED_MASK >> i)) {
+					events->ButtonsReleased |= (1 << i);
+				}
+			}
+		}
+	}
+	else if (reg_a & DA7219_E_JACK_REMOVED_MASK) {
+		events->JackRemoved = TRUE;
+	}
+}
+
+//Interrupt side: one burst read of the accessory detect status and events, one burst
+//write to clear them. Everything else is left to da7219_codec_irq_decode. The registers
+//are volatile so the cache is never touched, and the traffic is charged to IrqBusStats
+//and the jack scenarios only: the acknowledge shares no state with the rest of the
+//core and may run alongside it, though not alongside itself.
+NTSTATUS da7219_codec_irq_ack(
+	_In_ PDA7219_CODEC codec,
+	_Out_ PDA7219_IRQ_RECORD record
+) {
+	DA7219_BUS_STATS start = codec->IrqBusStats;
+	DA7219_IRQ_EVENTS events;
+
+	RtlZeroMemory(record, sizeof(*record));
+
+	//ACCDET_STATUS_A, ACCDET_STATUS_B, ACCDET_IRQ_EVENT_A, ACCDET_IRQ_EVENT_B in one transfer
+	uint8_t accdet[4] = { 0 };
+	NTSTATUS status = da7219_bus_read(codec, &codec->IrqBusStats, DA7219_ACCDET_STATUS_A, accdet, sizeof(accdet));
+	if (!NT_SUCCESS(status))
+		return status;
+
+	record->StatusA = accdet[0];
+	record->StatusB = accdet[1];
+	record->EventA = accdet[2];
+	record->EventB = accdet[3];
+
+	Da7219Trace(codec->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_IRQ,
+		Da7219TraceInterrupt, 0, record->StatusA | record->EventA << 8 | record->EventB << 16, status);
+
+	//Clear events in one burst. If the clear fails the events stay latched
+	//and the line stays up, so the record is not handed on and the next
+	//interrupt reads them again.
+	if (record->EventA || record->EventB) {
+		status = da7219_bus_write(codec, &codec->IrqBusStats, DA7219_ACCDET_IRQ_EVENT_A, &accdet[2], 2, FALSE);
+		if (!NT_SUCCESS(status))
+			return status;
+	}
+
+	da7219_irq_events(record, &events);
+	if (events.JackRemoved) {
+		da7219_scenario_account(codec, Da7219ScenarioRemove, &codec->IrqBusStats, &start);
+	}
+	else if (events.JackInserted || events.DetectComplete) {
+		da7219_scenario_account(codec, Da7219ScenarioInsert, &codec->IrqBusStats, &start);
+	}
+	else if (events.ButtonsReleased || record->EventB) {
+		da7219_scenario_account(codec, Da7219ScenarioButton, &codec->IrqBusStats, &start);
+	}
+
+	return status;
+}
+
+//Deferred side: decodes an acknowledged record into events and follows the jack with MICBIAS.
+//Returns STATUS_PENDING with *delay like da7219_dapm_advance when MICBIAS is still changing.
+NTSTATUS da7219_codec_irq_decode(
+	_In_ PDA7219_CODEC codec,
+	const DA7219_IRQ_RECORD* record,
+	_Out_ PDA7219_IRQ_EVENTS events,
+	_Out_ PULONG delay
+) {
+	*delay = 0;
+
+	da7219_irq_events(record, events);
+
+	if (events->DetectComplete || events->JackRemoved) {
+		codec->Headset = events->DetectComplete && (record->StatusA & DA7219_JACK_TYPE_STS_MASK);
+		return da7219_dapm_sync(codec, delay);
+	}
+	return STATUS_SUCCESS;
+}
+
+//Acknowledges and decodes in one go, waiting out any path change through the bus Delay
+//hook, for callers with nothing to defer
+NTSTATUS da7219_codec_irq(
+	_In_ PDA7219_CODEC codec,
+	_Out_ PDA7219_IRQ_EVENTS events
+) {
+	DA7219_IRQ_RECORD record;
+	ULONG delay;
+
+	NTSTATUS status = da7219_codec_irq_ack(codec, &record);
+	if (!NT_SUCCESS(status)) {
+		RtlZeroMemory(events, sizeof(*events));
+		return status;
+	}
+
+	if (da7219_codec_irq_decode(codec, &record, events, &delay) == STATUS_PENDING) {
+		da7219_dapm_blocking(codec);
+	}
+	return status;
+}
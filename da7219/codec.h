@@ -0,0 +1,504 @@
+#if !defined(_DA7219_CODEC_H_)
+#define _DA7219_CODEC_H_
+
+//
+// Portable DA7219 codec core. Register cache, sequence tables, boot state
+// machine and interrupt decode live here with no WDF dependencies; all bus
+// traffic goes through DA7219_BUS so the same code runs under the KMDF
+// adapter in da7219.c or against a simulated bus in a host build.
+//
+
+#if defined(DA7219_HOST_BUILD)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef int32_t NTSTATUS;
+typedef uint32_t ULONG, *PULONG;
+typedef int32_t LONG;
+typedef int64_t LONG64;
+typedef uint8_t UCHAR, *PUCHAR, BOOLEAN;
+typedef uint16_t USHORT;
+typedef void VOID, *PVOID;
+
+#define TRUE 1
+#define FALSE 0
+
+#define NT_SUCCESS(Status)              (((NTSTATUS)(Status)) >= 0)
+#define STATUS_SUCCESS                  ((NTSTATUS)0x00000000L)
+#define STATUS_PENDING                  ((NTSTATUS)0x00000103L)
+#define STATUS_INVALID_PARAMETER        ((NTSTATUS)0xC000000DL)
+#define STATUS_INVALID_DEVICE_STATE     ((NTSTATUS)0xC0000184L)
+
+#define C_ASSERT(e) typedef char __C_ASSERT__[(e) ? 1 : -1]
+#define RtlCopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+#define ARRAYSIZE(A) (sizeof(A) / sizeof((A)[0]))
+#define UNREFERENCED_PARAMETER(P) ((void)(P))
+
+#define _In_
+#define _Out_
+#define _In_opt_
+#define _Out_opt_
+#define IN
+#define OUT
+
+#else
+
+#include <wdm.h>
+#include <stdint.h>
+
+#endif
+
+#include "trace.h"
+
+typedef enum platform {
+	PlatformNone,
+	PlatformIntel,
+	PlatformStoney,
+	PlatformRyzen
+} Platform;
+
+//
+// Largest run of sequence table writes merged into one auto-increment transfer
+//
+
+#define DA7219_REG_BURST_MAX       16
+
+//
+// Size of the codec register address space
+//
+
+#define DA7219_REG_COUNT           0x100
+
+//
+// Register map, built from DA7219_REGMAP in regmap.h and indexed by address.
+// Addresses without a register have no flags set.
+//
+
+#define DA7219_REG_READABLE        0x01
+#define DA7219_REG_WRITABLE        0x02
+#define DA7219_REG_VOLATILE        0x04 // never cached, the codec changes it
+#define DA7219_REG_PRECIOUS        0x08 // reading has side effects, none on the DA7219
+#define DA7219_REG_DEFAULT         0x10 // reset value known, seeds the cache
+
+#define DA7219_REG_RO              DA7219_REG_READABLE
+#define DA7219_REG_RW              (DA7219_REG_READABLE | DA7219_REG_WRITABLE)
+
+typedef struct _DA7219_REG_INFO
+{
+	UCHAR Flags;
+
+	UCHAR Default;
+
+	UCHAR Fields; // OR of the documented field masks
+
+} DA7219_REG_INFO;
+
+//
+// Bus backend. Read and Write move count registers starting at reg with
+// auto-increment. ReadRanges reads up to DA7219_BUS_RANGES_MAX separate
+// ranges in a single transaction. WriteAsync may queue the write and
+// return before it is on the bus, Flush waits for everything queued.
+// ReadRanges, WriteAsync and Flush are optional.
+//
+
+typedef struct _DA7219_BUS_RANGE
+{
+	uint8_t Reg;
+
+	uint8_t* Data;
+
+	ULONG Count;
+
+} DA7219_BUS_RANGE;
+
+#define DA7219_BUS_RANGES_MAX      8
+
+typedef struct _DA7219_BUS
+{
+	PVOID Context;
+
+	NTSTATUS (*Read)(PVOID Context, uint8_t reg, uint8_t* data, ULONG count);
+
+	NTSTATUS (*Write)(PVOID Context, uint8_t reg, const uint8_t* data, ULONG count);
+
+	NTSTATUS (*ReadRanges)(PVOID Context, const DA7219_BUS_RANGE* ranges, ULONG count); // one transaction, optional
+
+	NTSTATUS (*WriteAsync)(PVOID Context, uint8_t reg, const uint8_t* data, ULONG count);
+
+	NTSTATUS (*Flush)(PVOID Context);
+
+	VOID (*Delay)(PVOID Context, ULONG ms);
+
+	uint64_t (*Now)(PVOID Context); // monotonic microseconds
+
+} DA7219_BUS;
+
+//
+// I2C cost model. Every transfer is charged its bit times at BusHz plus a
+// fixed per-transaction overhead for controller and driver latency, giving
+// an estimated wall-clock bus time for any code path.
+//
+
+#define DA7219_I2C_STANDARD_HZ     100000
+#define DA7219_I2C_FAST_HZ         400000
+#define DA7219_I2C_FAST_PLUS_HZ    1000000
+
+typedef struct _DA7219_BUS_COST
+{
+	ULONG BusHz;
+
+	ULONG TransactionOverheadNs;
+
+} DA7219_BUS_COST;
+
+typedef struct _DA7219_BUS_STATS
+{
+	ULONG Reads;
+
+	ULONG Writes;
+
+	ULONG BytesRead;
+
+	ULONG BytesWritten;
+
+	uint64_t BusTimeNs;
+
+} DA7219_BUS_STATS, *PDA7219_BUS_STATS;
+
+//
+// Driver scenarios whose bus traffic is accounted against committed budgets
+//
+
+typedef enum _DA7219_SCENARIO
+{
+	Da7219ScenarioBoot,
+	Da7219ScenarioResumeWarm, // codec kept its state, signature check and sync only
+	Da7219ScenarioResumeCold, // codec lost its state, reset and restore from the image
+	Da7219ScenarioSuspend,
+	Da7219ScenarioInsert,
+	Da7219ScenarioRemove,
+	Da7219ScenarioButton,
+	Da7219ScenarioCount
+} DA7219_SCENARIO;
+
+typedef struct _DA7219_SCENARIO_BUDGET
+{
+	ULONG Transactions;
+
+	ULONG Bytes;
+
+} DA7219_SCENARIO_BUDGET;
+
+typedef struct _DA7219_SCENARIO_STATS
+{
+	ULONG Runs;
+
+	ULONG OverBudget;
+
+	DA7219_BUS_STATS Last;
+
+	DA7219_BUS_STATS Worst; // run with the most transactions
+
+} DA7219_SCENARIO_STATS, *PDA7219_SCENARIO_STATS;
+
+//
+// Register programming sequences, run by da7219_run_sequence
+//
+
+typedef enum _DA7219_SEQ_OP
+{
+	Da7219SeqWrite,
+	Da7219SeqUpdate
+} DA7219_SEQ_OP;
+
+typedef struct _DA7219_SEQ_ENTRY
+{
+	UCHAR Op;
+
+	UCHAR Reg;
+
+	UCHAR Mask;
+
+	UCHAR Value;
+
+	USHORT Delay; // milliseconds to wait after this entry
+
+} DA7219_SEQ_ENTRY, *PDA7219_SEQ_ENTRY;
+
+#define DA7219_SEQ_WRITE(reg, val)          { Da7219SeqWrite, (reg), 0xFF, (val), 0 }
+#define DA7219_SEQ_UPDATE(reg, mask, val)   { Da7219SeqUpdate, (reg), (mask), (val), 0 }
+
+typedef struct _DA7219_PLATFORM_INIT
+{
+	const DA7219_SEQ_ENTRY* Power;
+
+	ULONG PowerLength;
+
+	const DA7219_SEQ_ENTRY* Setup;
+
+	ULONG SetupLength;
+
+} DA7219_PLATFORM_INIT;
+
+typedef enum _DA7219_BOOT_STATE
+{
+	BootStateIdle,
+	BootStateStart,
+	BootStateWaitStandby,
+	BootStateReset,
+	BootStatePower,
+	BootStateSetup,
+	BootStateComplete
+} DA7219_BOOT_STATE;
+
+//
+// Streams the audio stack can run, each powering its analog path only while active
+//
+
+#define DA7219_PATH_PLAYBACK       0x01
+#define DA7219_PATH_CAPTURE        0x02
+#define DA7219_PATH_STREAMS        (DA7219_PATH_PLAYBACK | DA7219_PATH_CAPTURE)
+
+//
+// DAPM style power widgets. Routes in codec.c join them into
+// AIF in -> DAC -> MIXOUT -> HP -> headphones and
+// mic -> MIC_1 -> MIXIN_L -> ADC_L -> AIF out. A widget is powered when it
+// sits on a route from an active input to an active output, supplies
+// (charge pump, MICBIAS) whenever something they feed is. MICBIAS is also
+// held up while a headset is plugged in, button detection needs it.
+//
+
+typedef enum _DA7219_WIDGET
+{
+	Da7219WidgetAifIn,
+	Da7219WidgetAifOut,
+	Da7219WidgetMic,
+	Da7219WidgetHeadphones,
+	Da7219WidgetMicBias,
+	Da7219WidgetCp,
+	Da7219WidgetMic1,
+	Da7219WidgetMixinL,
+	Da7219WidgetAdcL,
+	Da7219WidgetDacL,
+	Da7219WidgetDacR,
+	Da7219WidgetMixoutL,
+	Da7219WidgetMixoutR,
+	Da7219WidgetHpL,
+	Da7219WidgetHpR,
+	Da7219WidgetCount
+} DA7219_WIDGET;
+
+#define DA7219_WIDGET_BIT(w)       ((USHORT)(1 << (w)))
+
+//
+// Longest plan da7219_dapm_plan can produce: an off and an on write per
+// widget plus the min gain steps around the HP amps
+//
+
+#define DA7219_DAPM_PLAN_MAX       32
+
+//
+// Accessory detect events decoded from one interrupt
+//
+
+typedef struct _DA7219_IRQ_EVENTS
+{
+	BOOLEAN JackInserted;
+
+	BOOLEAN DetectComplete;
+
+	BOOLEAN JackRemoved;
+
+	UCHAR ButtonsReleased; // bit i set when button i was released
+
+} DA7219_IRQ_EVENTS, *PDA7219_IRQ_EVENTS;
+
+//
+// Raw accessory detect registers captured when an interrupt is acknowledged
+//
+
+typedef struct _DA7219_IRQ_RECORD
+{
+	UCHAR StatusA;
+
+	UCHAR StatusB;
+
+	UCHAR EventA;
+
+	UCHAR EventB;
+
+} DA7219_IRQ_RECORD, *PDA7219_IRQ_RECORD;
+
+typedef struct _DA7219_CODEC
+{
+	DA7219_BUS Bus;
+
+	PDA7219_TRACE Trace; // optional
+
+	DA7219_BUS_COST BusCost;
+
+	DA7219_BUS_STATS BusStats;
+
+	DA7219_BUS_STATS IrqBusStats; // da7219_codec_irq_ack traffic, kept apart so the acknowledge shares no counters
+
+	DA7219_BUS_STATS IrqBusBase; // IrqBusStats at the last reset, only the acknowledge ever writes IrqBusStats
+
+	DA7219_BUS_STATS BootStart;
+
+	DA7219_SCENARIO_STATS Scenarios[Da7219ScenarioCount];
+
+	//
+	// Boot state machine, resumed by the caller after each wait
+	//
+
+	DA7219_BOOT_STATE BootState;
+
+	Platform BootPlatform;
+
+	ULONG BootSeqIndex;
+
+	ULONG BootPollCount;
+
+	ULONG BootPollElapsed;
+
+	BOOLEAN BootResume; // a saved register image existed when the boot started
+
+	BOOLEAN BootWarm; // the codec kept its state, the boot only synced the cache back
+
+	uint64_t BootStateEntered; // Bus.Now when BootState was last changed
+
+	ULONG BootStateUs[BootStateComplete]; // time spent in each state by the current boot
+
+	//
+	// Shadow copy of the non-volatile codec registers
+	//
+
+	UCHAR RegCache[DA7219_REG_COUNT];
+
+	BOOLEAN RegCacheValid[DA7219_REG_COUNT];
+
+	//
+	// Register image saved after the last full boot, replayed on resume
+	//
+
+	UCHAR RegImage[DA7219_REG_COUNT];
+
+	BOOLEAN RegImageValid[DA7219_REG_COUNT];
+
+	BOOLEAN RegImageSaved;
+
+	//
+	// Analog path power, the image above is always saved with every path off
+	//
+
+	BOOLEAN PathsLive; // booted and not suspended since, WidgetsOn matches the codec
+
+	BOOLEAN Headset; // headset plugged in, buttons need MICBIAS
+
+	UCHAR Streams; // DA7219_PATH_STREAMS the audio stack has running
+
+	BOOLEAN StreamsReported; // the audio stack reports its streams, until then both paths stay powered
+
+	USHORT WidgetsOn; // DA7219_WIDGET_BIT of every widget currently powered
+
+	//
+	// Widget power change in flight, resumed by the caller after each wait
+	// like the boot. Streams and the jack only record what they want while
+	// it runs, da7219_dapm_advance plans again once it is through.
+	//
+
+	DA7219_SEQ_ENTRY DapmPlan[DA7219_DAPM_PLAN_MAX];
+
+	ULONG DapmPlanLength;
+
+	ULONG DapmIndex;
+
+	uint64_t DapmResumeUs; // Bus.Now the plan may go on at, valid while DapmRunning
+
+	USHORT DapmTarget; // WidgetsOn once the plan is through
+
+	BOOLEAN DapmRunning;
+
+} DA7219_CODEC, *PDA7219_CODEC;
+
+//
+// Register access
+//
+
+NTSTATUS da7219_reg_read(_In_ PDA7219_CODEC codec, uint8_t reg, unsigned int* data);
+
+NTSTATUS da7219_reg_write(_In_ PDA7219_CODEC codec, uint8_t reg, unsigned int data);
+
+NTSTATUS da7219_reg_bulk_read(_In_ PDA7219_CODEC codec, uint8_t reg, uint8_t* data, unsigned int count);
+
+NTSTATUS da7219_reg_bulk_write(_In_ PDA7219_CODEC codec, uint8_t reg, const uint8_t* data, unsigned int count);
+
+NTSTATUS da7219_reg_bulk_write_async(_In_ PDA7219_CODEC codec, uint8_t reg, const uint8_t* data, unsigned int count);
+
+NTSTATUS da7219_reg_flush(_In_ PDA7219_CODEC codec);
+
+NTSTATUS da7219_reg_update(_In_ PDA7219_CODEC codec, uint8_t reg, unsigned int mask, unsigned int val);
+
+NTSTATUS da7219_reg_snapshot(_In_ PDA7219_CODEC codec, _Out_ uint8_t* image, _Out_ uint8_t* valid, _Out_opt_ PULONG bursts);
+
+extern const DA7219_REG_INFO da7219_reg_info[DA7219_REG_COUNT];
+
+const char* da7219_reg_name(uint8_t reg);
+
+//
+// Bus accounting
+//
+
+VOID da7219_bus_set_cost(_In_ PDA7219_CODEC codec, ULONG busHz, ULONG transactionOverheadNs);
+
+uint64_t da7219_bus_cost_ns(_In_ PDA7219_CODEC codec, BOOLEAN read, ULONG count);
+
+//Safe against a concurrent da7219_codec_irq_ack, serialized with everything else
+VOID da7219_bus_stats(_In_ PDA7219_CODEC codec, _Out_ PDA7219_BUS_STATS stats, BOOLEAN reset);
+
+extern const DA7219_SCENARIO_BUDGET da7219_scenario_budget[Da7219ScenarioCount];
+
+//
+// Codec lifecycle
+//
+
+VOID da7219_codec_init(_In_ PDA7219_CODEC codec, const DA7219_BUS* bus);
+
+VOID da7219_boot_start(_In_ PDA7219_CODEC codec, Platform platform);
+
+NTSTATUS da7219_boot_advance(_In_ PDA7219_CODEC codec, _Out_ PULONG delay);
+
+NTSTATUS da7219_boot_blocking(_In_ PDA7219_CODEC codec, Platform platform);
+
+NTSTATUS da7219_codec_suspend(_In_ PDA7219_CODEC codec, _Out_ PULONG delay);
+
+NTSTATUS da7219_suspend_blocking(_In_ PDA7219_CODEC codec);
+
+//Touches only the ACCDET status and event registers, IrqBusStats and the jack scenarios,
+//so it needs no lock against the calls above and below, only against itself
+NTSTATUS da7219_codec_irq_ack(_In_ PDA7219_CODEC codec, _Out_ PDA7219_IRQ_RECORD record);
+
+NTSTATUS da7219_codec_irq_decode(_In_ PDA7219_CODEC codec, const DA7219_IRQ_RECORD* record, _Out_ PDA7219_IRQ_EVENTS events, _Out_ PULONG delay);
+
+NTSTATUS da7219_codec_irq(_In_ PDA7219_CODEC codec, _Out_ PDA7219_IRQ_EVENTS events);
+
+NTSTATUS da7219_codec_stream(_In_ PDA7219_CODEC codec, UCHAR paths, BOOLEAN active, _Out_ PULONG delay);
+
+//
+// Power widgets
+//
+
+USHORT da7219_dapm_wanted(_In_ PDA7219_CODEC codec);
+
+NTSTATUS da7219_dapm_plan(_In_ PDA7219_CODEC codec, USHORT wanted, _Out_ PDA7219_SEQ_ENTRY plan, _Out_ PULONG length);
+
+NTSTATUS da7219_dapm_advance(_In_ PDA7219_CODEC codec, _Out_ PULONG delay);
+
+NTSTATUS da7219_dapm_blocking(_In_ PDA7219_CODEC codec);
+
+const char* da7219_widget_name(DA7219_WIDGET widget);
+
+#endif
@@ -45,50 +45,6 @@ DriverEntry(
 	return status;
 }
 
-NTSTATUS da7219_reg_read(
-	_In_ PDA7219_CONTEXT pDevice,
-	uint8_t reg,
-	unsigned int* data
-) {
-	uint8_t raw_data = 0;
-	NTSTATUS status = SpbXferDataSynchronously(&pDevice->I2CContext, &reg, sizeof(uint8_t), &raw_data, sizeof(uint8_t));
-	*data = raw_data;
-	return status;
-}
-
-NTSTATUS da7219_reg_write(
-	_In_ PDA7219_CONTEXT pDevice,
-	uint8_t reg,
-	unsigned int data
-) {
-	uint8_t buf[2];
-	buf[0] = reg;
-	buf[1] = data;
-	return SpbWriteDataSynchronously(&pDevice->I2CContext, buf, sizeof(buf));
-}
-
-NTSTATUS da7219_reg_update(
-	_In_ PDA7219_CONTEXT pDevice,
-	uint8_t reg,
-	unsigned int mask,
-	unsigned int val
-) {
-	unsigned int tmp = 0, orig = 0;
-
-	NTSTATUS status = da7219_reg_read(pDevice, reg, &orig);
-	if (!NT_SUCCESS(status)) {
-		return status;
-	}
-
-	tmp = orig & ~mask;
-	tmp |= val & mask;
-
-	if (tmp != orig) {
-		status = da7219_reg_write(pDevice, reg, tmp);
-	}
-	return status;
-}
-
 static Platform GetPlatform() {
 	int cpuinfo[4];
 	__cpuidex(cpuinfo, 0, 0);
@@ -255,174 +211,260 @@ Status
 	return status;
 }
 
-VOID
-DA7219BootWorkItem(
-	IN WDFWORKITEM  WorkItem
+static NTSTATUS
+Da7219BusRead(
+	PVOID Context,
+	uint8_t reg,
+	uint8_t* data,
+	ULONG count
+) {
+	return SpbXferDataSynchronously((SPB_CONTEXT*)Context, &reg, sizeof(uint8_t), data, count);
+}
+
+C_ASSERT(DA7219_BUS_RANGES_MAX <= SPB_MAX_READ_RANGES);
+
+static NTSTATUS
+Da7219BusReadRanges(
+	PVOID Context,
+	const DA7219_BUS_RANGE* ranges,
+	ULONG count
+) {
+	UCHAR addresses[DA7219_BUS_RANGES_MAX];
+	PVOID buffers[DA7219_BUS_RANGES_MAX];
+	ULONG lengths[DA7219_BUS_RANGES_MAX];
+
+	if (count > DA7219_BUS_RANGES_MAX) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	for (ULONG i = 0; i < count; i++) {
+		addresses[i] = ranges[i].Reg;
+		buffers[i] = ranges[i].Data;
+		lengths[i] = ranges[i].Count;
+	}
+	return SpbReadRegistersSynchronously((SPB_CONTEXT*)Context, addresses, buffers, lengths, count);
+}
+
+static NTSTATUS
+Da7219BusWrite(
+	PVOID Context,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count
+) {
+	return SpbWriteRegisterSynchronously((SPB_CONTEXT*)Context, &reg, sizeof(uint8_t), (PVOID)data, count);
+}
+
+static NTSTATUS
+Da7219BusWriteAsync(
+	PVOID Context,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count
+) {
+	return SpbWriteRegisterAsynchronously((SPB_CONTEXT*)Context, &reg, sizeof(uint8_t), (PVOID)data, count, NULL, NULL);
+}
+
+static NTSTATUS
+Da7219BusFlush(
+	PVOID Context
+) {
+	return SpbWaitForIdle((SPB_CONTEXT*)Context);
+}
+
+static VOID
+Da7219BusDelay(
+	PVOID Context,
+	ULONG ms
+) {
+	LARGE_INTEGER interval;
+
+	UNREFERENCED_PARAMETER(Context);
+
+	interval.QuadPart = -10LL * 1000 * ms;
+	KeDelayExecutionThread(KernelMode, FALSE, &interval);
+}
+
+//Performance counter in microseconds, interrupt time only has clock tick resolution
+static uint64_t
+Da7219QueryMicroseconds(
+	VOID
+) {
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter = KeQueryPerformanceCounter(&frequency);
+
+	return (counter.QuadPart / frequency.QuadPart) * 1000000 +
+		(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+static uint64_t
+Da7219BusNow(
+	PVOID Context
+) {
+	UNREFERENCED_PARAMETER(Context);
+
+	return Da7219QueryMicroseconds();
+}
+
+static VOID
+Da7219BootProfileCommit(
+	IN PDA7219_CONTEXT pDevice,
+	IN NTSTATUS Status
 )
 {
-	WDFDEVICE Device = (WDFDEVICE)WdfWorkItemGetParentObject(WorkItem);
-	PDA7219_CONTEXT pDevice = GetDeviceContext(Device);
+	Da7219BootProfileRecord* record = &pDevice->BootProfileCurrent;
 
-	Platform platform = GetPlatform();
-
-	unsigned int system_active, system_status;
-	int i;
-	da7219_reg_read(pDevice, DA7219_SYSTEM_ACTIVE, &system_active);
-	if (system_active) {
-		da7219_reg_write(pDevice, DA7219_GAIN_RAMP_CTRL,
-			DA7219_GAIN_RAMP_RATE_NOMINAL);
-		da7219_reg_write(pDevice, DA7219_SYSTEM_MODES_INPUT, 0x00);
-		da7219_reg_write(pDevice, DA7219_SYSTEM_MODES_OUTPUT, 0x01);
-
-		for (i = 0; i < DA7219_SYS_STAT_CHECK_RETRIES; ++i) {
-			da7219_reg_read(pDevice, DA7219_SYSTEM_STATUS,
-				&system_status);
-			if (!system_status)
-				break;
+	record->Resume = pDevice->Codec.BootResume;
+	record->Status = Status;
+	record->TotalUs = (ULONG)(Da7219QueryMicroseconds() - pDevice->D0EntryUs);
 
-			LARGE_INTEGER Interval;
-			Interval.QuadPart = -10 * 1000 * DA7219_SYS_STAT_CHECK_DELAY;
-			KeDelayExecutionThread(KernelMode, false, &Interval);
-		}
+	record->PhaseUs[Da7219BootPhaseStart] = pDevice->Codec.BootStateUs[BootStateStart];
+	record->PhaseUs[Da7219BootPhaseWaitStandby] = pDevice->Codec.BootStateUs[BootStateWaitStandby];
+	record->PhaseUs[Da7219BootPhaseReset] = pDevice->Codec.BootStateUs[BootStateReset];
+	record->PhaseUs[Da7219BootPhasePower] = pDevice->Codec.BootStateUs[BootStatePower];
+	record->PhaseUs[Da7219BootPhaseSetup] = pDevice->Codec.BootStateUs[BootStateSetup];
+
+	WdfSpinLockAcquire(pDevice->BootProfileLock);
+
+	record->Sequence = pDevice->BootProfileRuns;
+	pDevice->BootProfile[pDevice->BootProfileRuns % DA7219_BOOT_PROFILE_RUNS] = *record;
+	pDevice->BootProfileRuns++;
+
+	WdfSpinLockRelease(pDevice->BootProfileLock);
+}
+
+VOID
+Da7219DapmContinue(
+	IN PDA7219_CONTEXT pDevice,
+	IN NTSTATUS Status,
+	IN ULONG Delay
+)
+/*++
+
+Routine Description:
+
+Hands a path power change the codec core left waiting to DapmTimer, so
+no thread sleeps under CodecLock while the amps settle. Called with
+CodecLock held, after any core call that may start one.
+
+Arguments:
+
+pDevice - Pointer to the device context
+Status - what the core call returned
+Delay - the wait in ms it asked for when Status is STATUS_PENDING
+
+Return Value:
+
+None
+
+--*/
+{
+	if (Status == STATUS_PENDING && !pDevice->BootStopping) {
+		WdfTimerStart(pDevice->DapmTimer, WDF_REL_TIMEOUT_IN_MS(Delay));
 	}
+}
+
+VOID
+DA7219DapmTimer(
+	IN WDFTIMER Timer
+)
+{
+	WDFDEVICE Device = (WDFDEVICE)WdfTimerGetParentObject(Timer);
+	PDA7219_CONTEXT pDevice = GetDeviceContext(Device);
+	NTSTATUS status;
+	ULONG delay;
 
-	/* Soft reset component */
-	da7219_reg_update(pDevice, DA7219_ACCDET_CONFIG_1,
-		DA7219_ACCDET_EN_MASK, 0);
-	da7219_reg_update(pDevice, DA7219_CIF_CTRL,
-		DA7219_CIF_REG_SOFT_RESET_MASK,
-		DA7219_CIF_REG_SOFT_RESET_MASK);
-	da7219_reg_update(pDevice, DA7219_SYSTEM_ACTIVE,
-		DA7219_SYSTEM_ACTIVE_MASK, 0);
-	da7219_reg_update(pDevice, DA7219_SYSTEM_ACTIVE,
-		DA7219_SYSTEM_ACTIVE_MASK, 1);
-
-	//stoney uses DA7219_IO_VOLTAGE_LEVEL_1_2V_2_8V
-	da7219_reg_write(pDevice, DA7219_IO_CTRL, platform != PlatformStoney ? DA7219_IO_VOLTAGE_LEVEL_2_5V_3_6V : DA7219_IO_VOLTAGE_LEVEL_1_2V_2_8V);
-
-	da7219_reg_update(pDevice, DA7219_REFERENCES, DA7219_BIAS_EN_MASK, DA7219_BIAS_EN_MASK);
-
-	unsigned int rev;
-	da7219_reg_read(pDevice, DA7219_CHIP_REVISION, &rev);
-	DbgPrint("DA7219 revision: %d\n", rev & DA7219_CHIP_MINOR_MASK);
-	if ((rev & DA7219_CHIP_MINOR_MASK) == 0) {
-		da7219_reg_write(pDevice, DA7219_REFERENCES, 0x08);
-	}
-
-	/* Default PC counter to free-running */
-	da7219_reg_update(pDevice, DA7219_PC_COUNT, DA7219_PC_FREERUN_MASK,
-		DA7219_PC_FREERUN_MASK);
-
-	/* Default gain ramping */
-	da7219_reg_update(pDevice, DA7219_MIXIN_L_CTRL,
-		DA7219_MIXIN_L_AMP_RAMP_EN_MASK,
-		DA7219_MIXIN_L_AMP_RAMP_EN_MASK);
-	da7219_reg_update(pDevice, DA7219_ADC_L_CTRL, DA7219_ADC_L_RAMP_EN_MASK,
-		DA7219_ADC_L_RAMP_EN_MASK);
-	da7219_reg_update(pDevice, DA7219_DAC_L_CTRL, DA7219_DAC_L_RAMP_EN_MASK,
-		DA7219_DAC_L_RAMP_EN_MASK);
-	da7219_reg_update(pDevice, DA7219_DAC_R_CTRL, DA7219_DAC_R_RAMP_EN_MASK,
-		DA7219_DAC_R_RAMP_EN_MASK);
-	da7219_reg_update(pDevice, DA7219_HP_L_CTRL,
-		DA7219_HP_L_AMP_RAMP_EN_MASK,
-		DA7219_HP_L_AMP_RAMP_EN_MASK);
-	da7219_reg_update(pDevice, DA7219_HP_R_CTRL,
-		DA7219_HP_R_AMP_RAMP_EN_MASK,
-		DA7219_HP_R_AMP_RAMP_EN_MASK);
-
-	/* Default minimum gain on HP to avoid pops during DAPM sequencing */
-	da7219_reg_update(pDevice, DA7219_HP_L_CTRL,
-		DA7219_HP_L_AMP_MIN_GAIN_EN_MASK,
-		DA7219_HP_L_AMP_MIN_GAIN_EN_MASK);
-	da7219_reg_update(pDevice, DA7219_HP_R_CTRL,
-		DA7219_HP_R_AMP_MIN_GAIN_EN_MASK,
-		DA7219_HP_R_AMP_MIN_GAIN_EN_MASK);
-
-	/* Default infinite tone gen, start/stop by Kcontrol */
-	da7219_reg_write(pDevice, DA7219_TONE_GEN_CYCLES, DA7219_BEEP_CYCLES_MASK);
-
-	{ //AAD init
-		da7219_reg_update(pDevice, DA7219_ACCDET_CONFIG_1, DA7219_MIC_DET_THRESH_MASK, DA7219_AAD_MIC_DET_THR_500_OHMS);
-
-		da7219_reg_update(pDevice, DA7219_ACCDET_CONFIG_2, DA7219_JACKDET_DEBOUNCE_MASK | DA7219_JACK_DETECT_RATE_MASK | DA7219_JACKDET_REM_DEB_MASK,
-			DA7219_AAD_JACK_INS_DEB_20MS | DA7219_AAD_JACK_DET_RATE_32_64MS | DA7219_AAD_JACK_REM_DEB_1MS);
-
-		da7219_reg_write(pDevice, DA7219_ACCDET_CONFIG_3,
-			0xA);
-		da7219_reg_write(pDevice, DA7219_ACCDET_CONFIG_4,
-			0x16);
-		da7219_reg_write(pDevice, DA7219_ACCDET_CONFIG_5,
-			0x21);
-		da7219_reg_write(pDevice, DA7219_ACCDET_CONFIG_6,
-			0x3e);
-
-		da7219_reg_update(pDevice, DA7219_ACCDET_CONFIG_7, DA7219_BUTTON_AVERAGE_MASK | DA7219_ADC_1_BIT_REPEAT_MASK, DA7219_AAD_BTN_AVG_4 | DA7219_AAD_ADC_1BIT_RPT_1);
+	WdfWaitLockAcquire(pDevice->CodecLock, NULL);
+	if (!pDevice->BootStopping) {
+		status = da7219_dapm_advance(&pDevice->Codec, &delay);
+		Da7219DapmContinue(pDevice, status, delay);
 	}
+	WdfWaitLockRelease(pDevice->CodecLock);
+}
 
-	{
-		//Set sample rate
-		da7219_reg_write(pDevice, DA7219_SR, DA7219_SR_48000);
-		
-		//Set PLL
-		da7219_reg_write(pDevice, DA7219_PLL_CTRL, DA7219_PLL_MODE_SRM | DA7219_PLL_INDIV_9_TO_18_MHZ | DA7219_PLL_INDIV_4_5_TO_9_MHZ);
-		da7219_reg_write(pDevice, DA7219_DAI_CLK_MODE, DA7219_DAI_BCLKS_PER_WCLK_64);
-		
-		if (platform != PlatformStoney) {
-			da7219_reg_write(pDevice, DA7219_PLL_FRAC_TOP, 0x1E & DA7219_PLL_FBDIV_FRAC_TOP_MASK);
-			da7219_reg_write(pDevice, DA7219_PLL_FRAC_BOT, 0xB8 & DA7219_PLL_FBDIV_FRAC_BOT_MASK);
-			da7219_reg_write(pDevice, DA7219_PLL_INTEGER, 0x28 & DA7219_PLL_FBDIV_INTEGER_MASK);
-		}
-		else {
-			da7219_reg_write(pDevice, DA7219_PLL_CTRL, DA7219_PLL_MODE_NORMAL | DA7219_PLL_INDIV_36_TO_54_MHZ);
-			da7219_reg_write(pDevice, DA7219_PLL_FRAC_TOP, 0x18 & DA7219_PLL_FBDIV_FRAC_TOP_MASK);
-			da7219_reg_write(pDevice, DA7219_PLL_FRAC_BOT, 0x93 & DA7219_PLL_FBDIV_FRAC_BOT_MASK);
-			da7219_reg_write(pDevice, DA7219_PLL_INTEGER, 0x20 & DA7219_PLL_FBDIV_INTEGER_MASK);
-			da7219_reg_write(pDevice, DA7219_DAI_CLK_MODE, DA7219_DAI_CLK_EN_MASK | DA7219_DAI_BCLKS_PER_WCLK_64);
-		}
+VOID
+Da7219BootAdvance(
+	IN PDA7219_CONTEXT pDevice
+)
+/*++
 
-		da7219_reg_write(pDevice, DA7219_DIG_ROUTING_DAI, 0);
-		da7219_reg_write(pDevice, DA7219_DAI_CTRL, DA7219_DAI_FORMAT_I2S | (2 << DA7219_DAI_CH_NUM_SHIFT) | DA7219_DAI_EN_MASK);
-		da7219_reg_write(pDevice, DA7219_DAI_TDM_CTRL, DA7219_DAI_OE_MASK);
+Routine Description:
+
+Runs the codec boot state machine until it either completes or has to
+wait for the codec. Waits are handed to BootTimer, which calls back in
+here, so no thread is held while the codec settles.
+
+Arguments:
 
-		da7219_reg_write(pDevice, DA7219_MIXIN_L_SELECT, DA7219_MIXIN_L_MIX_SELECT_MASK);
-		da7219_reg_write(pDevice, DA7219_MIXIN_L_GAIN, 0xA);
+pDevice - Pointer to the device context
 
-		da7219_reg_write(pDevice, DA7219_MIC_1_GAIN, 0x5);
+Return Value:
 
-		da7219_reg_write(pDevice, DA7219_CP_CTRL, 0xE0);
-		da7219_reg_write(pDevice, DA7219_HP_L_GAIN, 0x3F);
-		da7219_reg_write(pDevice, DA7219_HP_R_GAIN, 0x3F);
+None
 
-		da7219_reg_write(pDevice, DA7219_MIXOUT_L_SELECT, DA7219_MIXOUT_L_MIX_SELECT_MASK);
-		da7219_reg_write(pDevice, DA7219_MIXOUT_R_SELECT, DA7219_MIXOUT_R_MIX_SELECT_MASK);
+--*/
+{
+	NTSTATUS status;
+	ULONG delay;
 
-		da7219_reg_write(pDevice, DA7219_MICBIAS_CTRL, 0x0D);
-		da7219_reg_write(pDevice, DA7219_MIC_1_CTRL, DA7219_MIC_1_AMP_EN_MASK);
-		da7219_reg_write(pDevice, DA7219_MIXIN_L_CTRL, DA7219_MIXIN_L_AMP_EN_MASK | DA7219_MIXIN_L_AMP_RAMP_EN_MASK | DA7219_MIXIN_L_MIX_EN_MASK);
-		da7219_reg_write(pDevice, DA7219_ADC_L_CTRL, DA7219_ADC_L_EN_MASK | DA7219_ADC_L_RAMP_EN_MASK);
+	WdfWaitLockAcquire(pDevice->CodecLock, NULL);
+	if (pDevice->BootStopping) {
+		WdfWaitLockRelease(pDevice->CodecLock);
+		return;
+	}
+	status = da7219_boot_advance(&pDevice->Codec, &delay);
+	if (status == STATUS_PENDING) {
+		//Armed under the lock so OnD0Exit either sees it armed or we see BootStopping
+		WdfTimerStart(pDevice->BootTimer, WDF_REL_TIMEOUT_IN_MS(delay));
+		WdfWaitLockRelease(pDevice->CodecLock);
+		return;
+	}
+	if (NT_SUCCESS(status)) {
+		//Bring back the paths of streams that were running, outside the resume profile
+		NTSTATUS pathStatus = da7219_dapm_advance(&pDevice->Codec, &delay);
+		Da7219DapmContinue(pDevice, pathStatus, delay);
+	}
+	WdfWaitLockRelease(pDevice->CodecLock);
 
-		da7219_reg_write(pDevice, DA7219_DAC_L_CTRL, 8 | DA7219_DAC_L_RAMP_EN_MASK | DA7219_DAC_L_EN_MASK);
-		da7219_reg_write(pDevice, DA7219_DAC_R_CTRL, DA7219_DAC_R_RAMP_EN_MASK | DA7219_DAC_R_EN_MASK);
-		da7219_reg_write(pDevice, DA7219_HP_L_CTRL, DA7219_HP_L_AMP_OE_MASK | DA7219_HP_L_AMP_RAMP_EN_MASK | DA7219_HP_L_AMP_EN_MASK);
-		da7219_reg_write(pDevice, DA7219_HP_R_CTRL, DA7219_HP_R_AMP_OE_MASK | DA7219_HP_R_AMP_RAMP_EN_MASK | DA7219_HP_R_AMP_EN_MASK);
-		da7219_reg_write(pDevice, DA7219_HP_R_CTRL, DA7219_HP_R_AMP_OE_MASK | DA7219_HP_R_AMP_RAMP_EN_MASK | DA7219_HP_R_AMP_EN_MASK);
+	if (NT_SUCCESS(status)) {
+		uint64_t idleStart = Da7219QueryMicroseconds();
 
-		da7219_reg_write(pDevice, DA7219_MIXOUT_L_CTRL, DA7219_MIXOUT_L_AMP_EN_MASK);
-		da7219_reg_write(pDevice, DA7219_MIXOUT_R_CTRL, DA7219_MIXOUT_R_AMP_EN_MASK);
+		pDevice->DevicePoweredOn = TRUE;
 
-		da7219_reg_write(pDevice, DA7219_GAIN_RAMP_CTRL, DA7219_GAIN_RAMP_RATE_NOMINAL);
-		da7219_reg_write(pDevice, DA7219_PC_COUNT, DA7219_PC_RESYNC_AUTO_MASK);
+		Da7219CompleteIdleIrp(pDevice);
 
-		da7219_reg_write(pDevice, DA7219_ACCDET_CONFIG_1, 0xD9);
-		da7219_reg_write(pDevice, DA7219_ACCDET_CONFIG_2, 0x04);
+		pDevice->BootProfileCurrent.PhaseUs[Da7219BootPhaseIdleIrp] =
+			(ULONG)(Da7219QueryMicroseconds() - idleStart);
 	}
 
-	pDevice->DevicePoweredOn = TRUE;
+	Da7219BootProfileCommit(pDevice, status);
+}
+
+VOID
+DA7219BootTimer(
+	IN WDFTIMER Timer
+)
+{
+	WDFDEVICE Device = (WDFDEVICE)WdfTimerGetParentObject(Timer);
+	PDA7219_CONTEXT pDevice = GetDeviceContext(Device);
+
+	Da7219BootAdvance(pDevice);
+}
+
+VOID
+DA7219BootWorkItem(
+	IN WDFWORKITEM  WorkItem
+)
+{
+	WDFDEVICE Device = (WDFDEVICE)WdfWorkItemGetParentObject(WorkItem);
+	PDA7219_CONTEXT pDevice = GetDeviceContext(Device);
+
+	pDevice->BootProfileCurrent.PhaseUs[Da7219BootPhaseDispatch] =
+		(ULONG)(Da7219QueryMicroseconds() - pDevice->D0EntryUs);
 
-	Da7219CompleteIdleIrp(pDevice);
+	da7219_boot_start(&pDevice->Codec, GetPlatform());
 
-end:
-	WdfObjectDelete(WorkItem);
+	Da7219BootAdvance(pDevice);
 }
 
 NTSTATUS
@@ -447,27 +489,20 @@ Status
 
 --*/
 {
-	UNREFERENCED_PARAMETER(FxPreviousState);
-
 	PDA7219_CONTEXT pDevice = GetDeviceContext(FxDevice);
 	NTSTATUS status = STATUS_SUCCESS;
 
-	pDevice->JackType = 0;
-
-	WDF_OBJECT_ATTRIBUTES attributes;
-	WDF_WORKITEM_CONFIG workitemConfig;
-	WDFWORKITEM hWorkItem;
+	Da7219Trace(&pDevice->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_POWER,
+		Da7219TraceD0Entry, 0, FxPreviousState, STATUS_SUCCESS);
 
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(&attributes, DA7219_CONTEXT);
-	attributes.ParentObject = pDevice->FxDevice;
-	WDF_WORKITEM_CONFIG_INIT(&workitemConfig, DA7219BootWorkItem);
+	pDevice->D0EntryUs = Da7219QueryMicroseconds();
+	RtlZeroMemory(&pDevice->BootProfileCurrent, sizeof(pDevice->BootProfileCurrent));
+	pDevice->BootProfileCurrent.PhaseUs[Da7219BootPhaseSuspend] = pDevice->SuspendUs;
 
-	WdfWorkItemCreate(&workitemConfig,
-		&attributes,
-		&hWorkItem);
+	pDevice->JackType = 0;
 
-	WdfWorkItemEnqueue(hWorkItem);
+	pDevice->BootStopping = FALSE;
+	WdfWorkItemEnqueue(pDevice->BootWorkItem);
 
 	return status;
 }
@@ -494,21 +529,119 @@ Status
 
 --*/
 {
-	UNREFERENCED_PARAMETER(FxPreviousState);
-
 	PDA7219_CONTEXT pDevice = GetDeviceContext(FxDevice);
 	NTSTATUS status = STATUS_SUCCESS;
+	uint64_t exitStart = Da7219QueryMicroseconds();
 
-	da7219_reg_write(pDevice, DA7219_PLL_CTRL, DA7219_PLL_MODE_SRM | DA7219_PLL_INDIV_9_TO_18_MHZ | DA7219_PLL_INDIV_4_5_TO_9_MHZ);
-	da7219_reg_write(pDevice, DA7219_DAI_CLK_MODE, DA7219_DAI_BCLKS_PER_WCLK_64);
-
-	da7219_reg_update(pDevice, DA7219_REFERENCES, DA7219_BIAS_EN_MASK, 0);
+	Da7219Trace(&pDevice->Trace, DA7219_TRACE_LEVEL_INFO, DA7219_TRACE_POWER,
+		Da7219TraceD0Exit, 0, FxPreviousState, STATUS_SUCCESS);
 
+	//The ISR acknowledges without CodecLock, so turn it away and wait out one already
+	//running before any suspend write goes out
 	pDevice->DevicePoweredOn = FALSE;
+	WdfInterruptAcquireLock(pDevice->Interrupt);
+	WdfInterruptReleaseLock(pDevice->Interrupt);
+
+	//Stop a boot that is still waiting on the codec
+	WdfWaitLockAcquire(pDevice->CodecLock, NULL);
+	pDevice->BootStopping = TRUE;
+	WdfWaitLockRelease(pDevice->CodecLock);
+	WdfWorkItemFlush(pDevice->BootWorkItem);
+	WdfTimerStop(pDevice->BootTimer, TRUE);
+	WdfTimerStop(pDevice->DapmTimer, TRUE);
+
+	//Report whatever the last interrupts raised before the codec goes down
+	WdfWorkItemFlush(pDevice->IrqWorkItem);
+
+	//Paths go down first and may have to wait for the amps, never with CodecLock held
+	for (;;) {
+		ULONG delay;
+
+		WdfWaitLockAcquire(pDevice->CodecLock, NULL);
+		status = da7219_codec_suspend(&pDevice->Codec, &delay);
+		WdfWaitLockRelease(pDevice->CodecLock);
+		if (status != STATUS_PENDING) {
+			break;
+		}
+		Da7219BusDelay(NULL, delay);
+	}
+
+	pDevice->SuspendUs = (ULONG)(Da7219QueryMicroseconds() - exitStart);
 
 	return STATUS_SUCCESS;
 }
 
+//Returns FALSE when the record was merged into Spill instead of queued
+static BOOLEAN
+Da7219IrqQueuePush(
+	IN PDA7219_IRQ_QUEUE Queue,
+	IN const DA7219_IRQ_RECORD* Record,
+	IN uint64_t Timestamp
+)
+{
+	LONG head = ReadNoFence(&Queue->Head);
+	PDA7219_IRQ_SLOT slot;
+
+	if (ReadAcquire(&Queue->Spill) != 0 ||
+		(ULONG)head - (ULONG)ReadAcquire(&Queue->Tail) >= DA7219_IRQ_QUEUE_SIZE)
+	{
+		if (ReadNoFence(&Queue->Spill) == 0)
+		{
+			Queue->SpillTimestamp = Timestamp;
+		}
+		WriteNoFence(&Queue->SpillStatus, Record->StatusA | Record->StatusB << 8);
+		InterlockedOr(&Queue->Spill, Record->EventA | Record->EventB << 8 | DA7219_IRQ_SPILL_PRESENT);
+		InterlockedIncrement(&Queue->Overflows);
+		return FALSE;
+	}
+
+	slot = &Queue->Slots[head & (DA7219_IRQ_QUEUE_SIZE - 1)];
+	slot->Record = *Record;
+	slot->Timestamp = Timestamp;
+	WriteRelease(&Queue->Head, (LONG)((ULONG)head + 1));
+
+	return TRUE;
+}
+
+//Hands out the queued records in order, then Spill
+static BOOLEAN
+Da7219IrqQueuePop(
+	IN PDA7219_IRQ_QUEUE Queue,
+	OUT PDA7219_IRQ_RECORD Record,
+	OUT uint64_t* Timestamp
+)
+{
+	LONG tail = ReadNoFence(&Queue->Tail);
+	PDA7219_IRQ_SLOT slot;
+	LONG spill;
+	LONG status;
+
+	if (tail == ReadAcquire(&Queue->Head))
+	{
+		if (ReadAcquire(&Queue->Spill) == 0)
+		{
+			return FALSE;
+		}
+
+		//Taken whole, a record merged after this starts a new Spill
+		*Timestamp = Queue->SpillTimestamp;
+		spill = InterlockedExchange(&Queue->Spill, 0);
+		status = ReadNoFence(&Queue->SpillStatus);
+		Record->StatusA = (UCHAR)status;
+		Record->StatusB = (UCHAR)(status >> 8);
+		Record->EventA = (UCHAR)spill;
+		Record->EventB = (UCHAR)(spill >> 8);
+		return TRUE;
+	}
+
+	slot = &Queue->Slots[tail & (DA7219_IRQ_QUEUE_SIZE - 1)];
+	*Record = slot->Record;
+	*Timestamp = slot->Timestamp;
+	WriteRelease(&Queue->Tail, (LONG)((ULONG)tail + 1));
+
+	return TRUE;
+}
+
 BOOLEAN OnInterruptIsr(
 	WDFINTERRUPT Interrupt,
 	ULONG MessageID) {
@@ -516,69 +649,133 @@ BOOLEAN OnInterruptIsr(
 
 	WDFDEVICE Device = WdfInterruptGetDevice(Interrupt);
 	PDA7219_CONTEXT pDevice = GetDeviceContext(Device);
+	uint64_t isrEntry = Da7219QueryMicroseconds();
 
 	if (!pDevice->DevicePoweredOn)
 		return true;
 
 	NTSTATUS status = STATUS_SUCCESS;
 
-	unsigned int reg_a;
-	unsigned int reg_b;
+	//Acknowledge only, decoding and reporting happen in Da7219IrqWorkItem.
+	//The acknowledge keeps to its own registers and counters, so the ISR
+	//never waits on CodecLock behind a boot or a stream change.
+	DA7219_IRQ_RECORD record;
+	status = da7219_codec_irq_ack(&pDevice->Codec, &record);
+	if (!NT_SUCCESS(status))
+		return true;
+
+	if (!Da7219IrqQueuePush(&pDevice->IrqQueue, &record, isrEntry)) {
+		Da7219Trace(&pDevice->Trace, DA7219_TRACE_LEVEL_ERROR, DA7219_TRACE_IRQ,
+			Da7219TraceIrqMerged, 0, record.StatusA | record.EventA << 8 | record.EventB << 16,
+			STATUS_BUFFER_OVERFLOW);
+	}
 
-	da7219_reg_read(pDevice, DA7219_ACCDET_IRQ_EVENT_A, &reg_a);
-	da7219_reg_read(pDevice, DA7219_ACCDET_IRQ_EVENT_B, &reg_b);
+	WdfWorkItemEnqueue(pDevice->IrqWorkItem);
 
-	unsigned int status_a;
-	da7219_reg_read(pDevice, DA7219_ACCDET_STATUS_A, &status_a);
+	return true;
+}
 
-	//Clear events
-	da7219_reg_write(pDevice, DA7219_ACCDET_IRQ_EVENT_A, reg_a);
-	da7219_reg_write(pDevice, DA7219_ACCDET_IRQ_EVENT_B, reg_b);
+VOID
+Da7219IrqWorkItem(
+	IN WDFWORKITEM WorkItem
+)
+/*++
 
-	if (status_a & DA7219_JACK_INSERTION_STS_MASK) {
-		if (reg_a & DA7219_E_JACK_INSERTED_MASK) {
-			//DbgPrint("Jack inserted\n");
-		}
-		if (reg_a & DA7219_E_JACK_DETECT_COMPLETE_MASK) {
-			pDevice->JackType = SND_JACK_HEADSET;
+Routine Description:
 
-			CsAudioSpecialKeyReport report;
-			report.ReportID = REPORTID_SPECKEYS;
-			report.ControlCode = CONTROL_CODE_JACK_TYPE;
-			report.ControlValue = pDevice->JackType;
+Decodes the interrupts OnInterruptIsr acknowledged, in order, and
+queues the jack and button reports they raise. Latency is still
+measured from ISR entry. Each record is popped and decoded under
+CodecLock and reported after it is released. IrqWorkItemBusy keeps
+a re-enqueued instance from reporting out of order.
 
-			size_t bytesWritten;
-			Da7219ProcessVendorReport(pDevice, &report, sizeof(report), &bytesWritten);
-		}
+Arguments:
+
+WorkItem - the device's IrqWorkItem
+
+Return Value:
+
+None
+
+--*/
+{
+	WDFDEVICE Device = (WDFDEVICE)WdfWorkItemGetParentObject(WorkItem);
+	PDA7219_CONTEXT pDevice = GetDeviceContext(Device);
+	DA7219_IRQ_RECORD record;
+	DA7219_IRQ_EVENTS events;
+	uint64_t isrEntry;
+
+	for (;;) {
+		if (InterlockedCompareExchange(&pDevice->IrqWorkItemBusy, 1, 0) != 0)
+			return;
+
+		for (;;) {
+			BOOLEAN popped;
+
+			WdfWaitLockAcquire(pDevice->CodecLock, NULL);
+			popped = Da7219IrqQueuePop(&pDevice->IrqQueue, &record, &isrEntry);
+			if (popped) {
+				ULONG delay;
+				NTSTATUS status = da7219_codec_irq_decode(&pDevice->Codec, &record, &events, &delay);
+
+				Da7219DapmContinue(pDevice, status, delay);
+			}
+			WdfWaitLockRelease(pDevice->CodecLock);
+
+			if (!popped)
+				break;
+
+			if (events.DetectComplete) {
+				pDevice->JackType = SND_JACK_HEADSET;
+
+				CsAudioSpecialKeyReport report;
+				report.ReportID = REPORTID_SPECKEYS;
+				report.ControlCode = CONTROL_CODE_JACK_TYPE;
+				report.ControlValue = pDevice->JackType;
+
+				size_t bytesWritten;
+				Da7219ProcessVendorReport(pDevice, &report, sizeof(report),
+					Da7219LatencyDetect, isrEntry, &bytesWritten);
+			}
 
-		if (status_a & DA7219_JACK_TYPE_STS_MASK) {
 			for (int i = 0; i < DA7219_AAD_MAX_BUTTONS; ++i) {
-				/* Button Release */
-				if (reg_b &
-					(DA7219_E_BUTTON_A_RELEASED_MASK >> i)) {
+				if (events.ButtonsReleased & (1 << i)) {
 					Da7219MediaReport report;
 					report.ReportID = REPORTID_MEDIA;
 					report.ControlCode = i + 1;
 
 					size_t bytesWritten;
-					Da7219ProcessVendorReport(pDevice, &report, sizeof(report), &bytesWritten);
+					Da7219ProcessVendorReport(pDevice, &report, sizeof(report),
+						(UCHAR)(Da7219LatencyButtonA + i), isrEntry, &bytesWritten);
 				}
 			}
+
+			if (events.JackRemoved) {
+				pDevice->JackType = 0;
+
+				CsAudioSpecialKeyReport report;
+				report.ReportID = REPORTID_SPECKEYS;
+				report.ControlCode = CONTROL_CODE_JACK_TYPE;
+				report.ControlValue = pDevice->JackType;
+
+				size_t bytesWritten;
+				Da7219ProcessVendorReport(pDevice, &report, sizeof(report),
+					Da7219LatencyRemove, isrEntry, &bytesWritten);
+			}
+
+			if (events.JackInserted) {
+				Da7219LatencyRecord(pDevice, Da7219LatencyInsert, isrEntry);
+			}
 		}
-	}
-	else if (reg_a & DA7219_E_JACK_REMOVED_MASK) {
-		pDevice->JackType = 0;
 
-		CsAudioSpecialKeyReport report;
-		report.ReportID = REPORTID_SPECKEYS;
-		report.ControlCode = CONTROL_CODE_JACK_TYPE;
-		report.ControlValue = pDevice->JackType;
+		InterlockedExchange(&pDevice->IrqWorkItemBusy, 0);
 
-		size_t bytesWritten;
-		Da7219ProcessVendorReport(pDevice, &report, sizeof(report), &bytesWritten);
+		//A record pushed after the last pop may have been turned away by
+		//the busy check, so look again before leaving
+		if (ReadAcquire(&pDevice->IrqQueue.Head) == ReadNoFence(&pDevice->IrqQueue.Tail) &&
+			ReadAcquire(&pDevice->IrqQueue.Spill) == 0)
+			return;
 	}
-
-	return true;
 }
 
 NTSTATUS
@@ -679,6 +876,34 @@ Da7219EvtDeviceAdd(
 
 	devContext->FxDevice = device;
 
+	Da7219ReportRingInit(&devContext->ReportRing);
+	RtlZeroMemory(&devContext->IrqQueue, sizeof(devContext->IrqQueue));
+
+	Da7219LatencyReset(devContext);
+
+	da7219_trace_init(&devContext->Trace);
+
+	//
+	// Route the codec core's register traffic to the SPB target
+	//
+	{
+		DA7219_BUS bus;
+
+		RtlZeroMemory(&bus, sizeof(bus));
+		bus.Context = &devContext->I2CContext;
+		bus.Read = Da7219BusRead;
+		bus.Write = Da7219BusWrite;
+		bus.ReadRanges = Da7219BusReadRanges;
+		bus.WriteAsync = Da7219BusWriteAsync;
+		bus.Flush = Da7219BusFlush;
+		bus.Delay = Da7219BusDelay;
+		bus.Now = Da7219BusNow;
+
+		da7219_codec_init(&devContext->Codec, &bus);
+
+		devContext->Codec.Trace = &devContext->Trace;
+	}
+
 	WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
 
 	queueConfig.PowerManaged = WdfFalse;
@@ -720,53 +945,188 @@ Da7219EvtDeviceAdd(
 	}
 
 	//
-	// Create an interrupt object for hardware notifications
+	// Create passive-level timers to resume the boot sequence and path
+	// power changes after waits
 	//
-	WDF_INTERRUPT_CONFIG_INIT(
-		&interruptConfig,
-		OnInterruptIsr,
-		NULL);
-	interruptConfig.PassiveHandling = TRUE;
-
-	status = WdfInterruptCreate(
-		device,
-		&interruptConfig,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&devContext->Interrupt);
-
-	if (!NT_SUCCESS(status))
 	{
-		Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
-			"Error creating WDF interrupt object - %!STATUS!",
-			status);
+		WDF_TIMER_CONFIG timerConfig;
+		WDF_OBJECT_ATTRIBUTES timerAttributes;
 
-		return status;
-	}
+		WDF_TIMER_CONFIG_INIT(&timerConfig, DA7219BootTimer);
+		timerConfig.AutomaticSerialization = FALSE;
 
-	return status;
-}
+		WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+		timerAttributes.ParentObject = device;
+		timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
 
-void
-Da7219IdleIrpWorkItem
-(
-	IN WDFWORKITEM IdleWorkItem
-)
-{
-	NTSTATUS status;
-	PIDLE_WORKITEM_CONTEXT idleWorkItemContext;
-	PDA7219_CONTEXT deviceContext;
-	PHID_SUBMIT_IDLE_NOTIFICATION_CALLBACK_INFO idleCallbackInfo;
+		status = WdfTimerCreate(&timerConfig, &timerAttributes, &devContext->BootTimer);
 
-	idleWorkItemContext = GetIdleWorkItemContext(IdleWorkItem);
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
+				"Error creating boot timer - %!STATUS!",
+				status);
+
+			return status;
+		}
+
+		WDF_TIMER_CONFIG_INIT(&timerConfig, DA7219DapmTimer);
+		timerConfig.AutomaticSerialization = FALSE;
+
+		status = WdfTimerCreate(&timerConfig, &timerAttributes, &devContext->DapmTimer);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
+				"Error creating path power timer - %!STATUS!",
+				status);
+
+			return status;
+		}
+	}
+
+	//
+	// Create the boot and idle work items up front so D0 entry and idle
+	// notifications only have to enqueue them
+	//
+	{
+		WDF_WORKITEM_CONFIG workitemConfig;
+		WDF_OBJECT_ATTRIBUTES workItemAttributes;
+
+		WDF_WORKITEM_CONFIG_INIT(&workitemConfig, DA7219BootWorkItem);
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&workItemAttributes);
+		workItemAttributes.ParentObject = device;
+
+		status = WdfWorkItemCreate(&workitemConfig, &workItemAttributes, &devContext->BootWorkItem);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
+				"Error creating boot work item - %!STATUS!",
+				status);
+
+			return status;
+		}
+
+		WDF_WORKITEM_CONFIG_INIT(&workitemConfig, Da7219IdleIrpWorkItem);
+
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&workItemAttributes, IDLE_WORKITEM_CONTEXT);
+		workItemAttributes.ParentObject = device;
+
+		status = WdfWorkItemCreate(&workitemConfig, &workItemAttributes, &devContext->IdleWorkItem);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
+				"Error creating idle work item - %!STATUS!",
+				status);
+
+			return status;
+		}
+
+		GetIdleWorkItemContext(devContext->IdleWorkItem)->FxDevice = device;
+		devContext->IdleWorkItemBusy = 0;
+		devContext->IrqWorkItemBusy = 0;
+
+		WDF_WORKITEM_CONFIG_INIT(&workitemConfig, Da7219IrqWorkItem);
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&workItemAttributes);
+		workItemAttributes.ParentObject = device;
+
+		status = WdfWorkItemCreate(&workitemConfig, &workItemAttributes, &devContext->IrqWorkItem);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
+				"Error creating interrupt work item - %!STATUS!",
+				status);
+
+			return status;
+		}
+	}
+
+	{
+		WDF_OBJECT_ATTRIBUTES lockAttributes;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&lockAttributes);
+		lockAttributes.ParentObject = device;
+
+		status = WdfSpinLockCreate(&lockAttributes, &devContext->BootProfileLock);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
+				"Error creating boot profile lock - %!STATUS!",
+				status);
+
+			return status;
+		}
+
+		status = WdfWaitLockCreate(&lockAttributes, &devContext->CodecLock);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
+				"Error creating codec lock - %!STATUS!",
+				status);
+
+			return status;
+		}
+	}
+
+	//
+	// Create an interrupt object for hardware notifications
+	//
+	WDF_INTERRUPT_CONFIG_INIT(
+		&interruptConfig,
+		OnInterruptIsr,
+		NULL);
+	interruptConfig.PassiveHandling = TRUE;
+
+	status = WdfInterruptCreate(
+		device,
+		&interruptConfig,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&devContext->Interrupt);
+
+	if (!NT_SUCCESS(status))
+	{
+		Da7219Print(DEBUG_LEVEL_ERROR, DBG_PNP,
+			"Error creating WDF interrupt object - %!STATUS!",
+			status);
+
+		return status;
+	}
+
+	return status;
+}
+
+void
+Da7219IdleIrpWorkItem
+(
+	IN WDFWORKITEM IdleWorkItem
+)
+{
+	NTSTATUS status;
+	PIDLE_WORKITEM_CONTEXT idleWorkItemContext;
+	PDA7219_CONTEXT deviceContext;
+	PHID_SUBMIT_IDLE_NOTIFICATION_CALLBACK_INFO idleCallbackInfo;
+	WDFREQUEST request;
+
+	idleWorkItemContext = GetIdleWorkItemContext(IdleWorkItem);
 	NT_ASSERT(idleWorkItemContext != NULL);
 
 	deviceContext = GetDeviceContext(idleWorkItemContext->FxDevice);
 	NT_ASSERT(deviceContext != NULL);
 
+	request = idleWorkItemContext->FxRequest;
+	idleWorkItemContext->FxRequest = NULL;
+
 	//
-	// Get the idle callback info from the workitem context
+	// Get the idle callback info from the request
 	//
-	PIRP irp = WdfRequestWdmGetIrp(idleWorkItemContext->FxRequest);
+	PIRP irp = WdfRequestWdmGetIrp(request);
 	PIO_STACK_LOCATION stackLocation = IoGetCurrentIrpStackLocation(irp);
 
 	idleCallbackInfo = (PHID_SUBMIT_IDLE_NOTIFICATION_CALLBACK_INFO)
@@ -782,7 +1142,7 @@ Da7219IdleIrpWorkItem
 	// This way if the IRP was cancelled, WDF will cancel it for us
 	//
 	status = WdfRequestForwardToIoQueue(
-		idleWorkItemContext->FxRequest,
+		request,
 		deviceContext->IdleQueue);
 
 	if (!NT_SUCCESS(status))
@@ -796,28 +1156,28 @@ Da7219IdleIrpWorkItem
 
 		Da7219Print(DEBUG_LEVEL_INFO, DBG_IOCTL,
 			"Error forwarding idle notification Request:0x%p to IdleQueue:0x%p - %!STATUS!",
-			idleWorkItemContext->FxRequest,
+			request,
 			deviceContext->IdleQueue,
 			status);
 
 		//
 		// Complete the request if we couldnt forward to the Idle Queue
 		//
-		WdfRequestComplete(idleWorkItemContext->FxRequest, status);
+		WdfRequestComplete(request, status);
 	}
 	else
 	{
 		Da7219Print(DEBUG_LEVEL_INFO, DBG_IOCTL,
 			"Forwarded idle notification Request:0x%p to IdleQueue:0x%p - %!STATUS!",
-			idleWorkItemContext->FxRequest,
+			request,
 			deviceContext->IdleQueue,
 			status);
 	}
 
 	//
-	// Delete the workitem since we're done with it
+	// Hand the workitem back for the next idle notification
 	//
-	WdfObjectDelete(IdleWorkItem);
+	InterlockedExchange(&deviceContext->IdleWorkItemBusy, 0);
 
 	return;
 }
@@ -875,42 +1235,26 @@ Da7219ProcessIdleRequest(
 
 	{
 		//
-		// Create a workitem for the idle callback
+		// Claim the preallocated workitem for the idle callback. HIDClass
+		// keeps at most one idle notification outstanding, so finding it
+		// busy means a duplicate request.
 		//
-		WDF_OBJECT_ATTRIBUTES workItemAttributes;
-		WDF_WORKITEM_CONFIG workitemConfig;
-		WDFWORKITEM idleWorkItem;
-		PIDLE_WORKITEM_CONTEXT idleWorkItemContext;
-
-		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&workItemAttributes, IDLE_WORKITEM_CONTEXT);
-		workItemAttributes.ParentObject = pDevice->FxDevice;
-
-		WDF_WORKITEM_CONFIG_INIT(&workitemConfig, Da7219IdleIrpWorkItem);
-
-		status = WdfWorkItemCreate(
-			&workitemConfig,
-			&workItemAttributes,
-			&idleWorkItem
-		);
-
-		if (!NT_SUCCESS(status)) {
+		if (InterlockedCompareExchange(&pDevice->IdleWorkItemBusy, 1, 0) != 0)
+		{
+			status = STATUS_DEVICE_BUSY;
 			Da7219Print(DEBUG_LEVEL_INFO, DBG_IOCTL,
-				"Error creating creating idle work item - %!STATUS!",
+				"Error: Idle Notification request %p while another is pending - %!STATUS!",
+				Request,
 				status);
 			goto exit;
 		}
 
-		//
-		// Set the workitem context
-		//
-		idleWorkItemContext = GetIdleWorkItemContext(idleWorkItem);
-		idleWorkItemContext->FxDevice = pDevice->FxDevice;
-		idleWorkItemContext->FxRequest = Request;
+		GetIdleWorkItemContext(pDevice->IdleWorkItem)->FxRequest = Request;
 
 		//
 		// Enqueue a workitem for the idle callback
 		//
-		WdfWorkItemEnqueue(idleWorkItem);
+		WdfWorkItemEnqueue(pDevice->IdleWorkItem);
 
 		//
 		// Mark the request as pending so that 
@@ -1458,7 +1802,38 @@ Da7219WriteReport(
 				report.ControlValue = DevContext->JackType;
 
 				size_t bytesWritten;
-				Da7219ProcessVendorReport(DevContext, &report, sizeof(report), &bytesWritten);
+				Da7219ProcessVendorReport(DevContext, &report, sizeof(report),
+					Da7219LatencyNone, 0, &bytesWritten);
+				break;
+			case REPORTID_STREAM:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219StreamReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219StreamReport* streamReport = (Da7219StreamReport*)transferPacket->reportBuffer;
+					ULONG delay;
+
+					//Completes once the change is started, DapmTimer sees it through
+					WdfWaitLockAcquire(DevContext->CodecLock, NULL);
+					status = da7219_codec_stream(&DevContext->Codec, streamReport->Streams, streamReport->Active != 0, &delay);
+					Da7219DapmContinue(DevContext, status, delay);
+					WdfWaitLockRelease(DevContext->CodecLock);
+					if (status == STATUS_PENDING)
+					{
+						status = STATUS_SUCCESS;
+					}
+
+					if (!NT_SUCCESS(status))
+					{
+						Da7219Print(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+							"Da7219WriteReport stream 0x%x active %d failed - %!STATUS!\n",
+							streamReport->Streams, streamReport->Active, status);
+					}
+				}
+
 				break;
 			default:
 
@@ -1479,82 +1854,284 @@ Da7219WriteReport(
 
 }
 
-NTSTATUS
-Da7219ProcessVendorReport(
-	IN PDA7219_CONTEXT DevContext,
-	IN PVOID ReportBuffer,
-	IN ULONG ReportBufferLen,
-	OUT size_t* BytesWritten
+VOID
+Da7219DrainReports(
+	IN PDA7219_CONTEXT DevContext
 )
 {
-	NTSTATUS status = STATUS_SUCCESS;
+	NTSTATUS status;
 	WDFREQUEST reqRead;
+	UCHAR report[DA7219_REPORT_MAX_LENGTH];
+	ULONG reportLength;
+	UCHAR latencyEvent;
+	uint64_t timestamp;
 	PVOID pReadReport = NULL;
 	size_t bytesReturned = 0;
 
-	Da7219Print(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
-		"Da7219ProcessVendorReport Entry\n");
-
-	status = WdfIoQueueRetrieveNextRequest(DevContext->ReportQueue,
-		&reqRead);
+	//
+	// Whoever publishes a report drains afterwards, so a read that is
+	// handed back below is always picked up again by someone
+	//
 
-	if (NT_SUCCESS(status))
+	while (Da7219ReportRingReady(&DevContext->ReportRing))
 	{
-		status = WdfRequestRetrieveOutputBuffer(reqRead,
-			ReportBufferLen,
-			&pReadReport,
-			&bytesReturned);
+		status = WdfIoQueueRetrieveNextRequest(DevContext->ReportQueue,
+			&reqRead);
 
-		if (NT_SUCCESS(status))
+		if (!NT_SUCCESS(status))
 		{
 			//
-			// Copy ReportBuffer into read request
+			// No read pending, the report waits in the ring for the next one
 			//
 
-			if (bytesReturned > ReportBufferLen)
+			return;
+		}
+
+		if (!Da7219ReportRingPop(&DevContext->ReportRing, report, &reportLength,
+			&latencyEvent, &timestamp))
+		{
+			status = WdfRequestRequeue(reqRead);
+
+			if (!NT_SUCCESS(status))
 			{
-				bytesReturned = ReportBufferLen;
+				Da7219Print(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+					"WdfRequestRequeue failed Status 0x%x\n", status);
+
+				WdfRequestComplete(reqRead, status);
 			}
+			continue;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(reqRead,
+			reportLength,
+			&pReadReport,
+			&bytesReturned);
 
-			RtlCopyMemory(pReadReport,
-				ReportBuffer,
-				bytesReturned);
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+				"WdfRequestRetrieveOutputBuffer failed Status 0x%x\n", status);
 
-			//
-			// Complete read with the number of bytes returned as info
-			//
+			WdfRequestComplete(reqRead, status);
+			continue;
+		}
 
-			WdfRequestCompleteWithInformation(reqRead,
-				status,
-				bytesReturned);
+		//
+		// Copy the report into read request
+		//
 
-			Da7219Print(DEBUG_LEVEL_INFO, DBG_IOCTL,
-				"Da7219ProcessVendorReport %d bytes returned\n", bytesReturned);
+		if (bytesReturned > reportLength)
+		{
+			bytesReturned = reportLength;
+		}
 
-			//
-			// Return the number of bytes written for the write request completion
-			//
+		RtlCopyMemory(pReadReport,
+			report,
+			bytesReturned);
 
-			*BytesWritten = bytesReturned;
+		//
+		// Complete read with the number of bytes returned as info
+		//
 
-			Da7219Print(DEBUG_LEVEL_INFO, DBG_IOCTL,
-				"%s completed, Queue:0x%p, Request:0x%p\n",
-				DbgHidInternalIoctlString(IOCTL_HID_READ_REPORT),
-				DevContext->ReportQueue,
-				reqRead);
+		WdfRequestCompleteWithInformation(reqRead,
+			status,
+			bytesReturned);
+
+		Da7219LatencyRecord(DevContext, latencyEvent, timestamp);
+
+		Da7219Print(DEBUG_LEVEL_INFO, DBG_IOCTL,
+			"%s completed, Queue:0x%p, Request:0x%p\n",
+			DbgHidInternalIoctlString(IOCTL_HID_READ_REPORT),
+			DevContext->ReportQueue,
+			reqRead);
+	}
+}
+
+VOID
+Da7219LatencyReset(
+	IN PDA7219_CONTEXT DevContext
+)
+{
+	//
+	// Not atomic against a concurrent record, a sample landing mid-reset
+	// may be lost or counted without its bucket
+	//
+
+	for (ULONG i = 0; i < Da7219LatencyCount; i++)
+	{
+		PDA7219_LATENCY_HISTOGRAM histogram = &DevContext->Latency[i];
+
+		InterlockedExchange(&histogram->Count, 0);
+		InterlockedExchange(&histogram->MinUs, MAXLONG);
+		InterlockedExchange(&histogram->MaxUs, 0);
+		InterlockedExchange64(&histogram->SumUs, 0);
+
+		for (ULONG j = 0; j < DA7219_LATENCY_BUCKETS; j++)
+		{
+			InterlockedExchange(&histogram->Buckets[j], 0);
 		}
-		else
+	}
+}
+
+VOID
+Da7219LatencyRecord(
+	IN PDA7219_CONTEXT DevContext,
+	IN UCHAR LatencyEvent,
+	IN uint64_t Timestamp
+)
+{
+	PDA7219_LATENCY_HISTOGRAM histogram;
+	LONG latency;
+	LONG current;
+	ULONG bucket = 0;
+
+	if (LatencyEvent >= Da7219LatencyCount)
+	{
+		return;
+	}
+
+	histogram = &DevContext->Latency[LatencyEvent];
+	latency = (LONG)min(Da7219QueryMicroseconds() - Timestamp, (uint64_t)MAXLONG);
+
+	if (latency >= 2)
+	{
+		_BitScanReverse(&bucket, (ULONG)latency);
+		bucket = min(bucket, DA7219_LATENCY_BUCKETS - 1);
+	}
+
+	InterlockedIncrement(&histogram->Buckets[bucket]);
+	InterlockedAdd64(&histogram->SumUs, latency);
+	InterlockedIncrement(&histogram->Count);
+
+	current = ReadNoFence(&histogram->MinUs);
+	while (latency < current)
+	{
+		LONG prev = InterlockedCompareExchange(&histogram->MinUs, latency, current);
+		if (prev == current)
 		{
-			Da7219Print(DEBUG_LEVEL_ERROR, DBG_IOCTL,
-				"WdfRequestRetrieveOutputBuffer failed Status 0x%x\n", status);
+			break;
+		}
+		current = prev;
+	}
+
+	current = ReadNoFence(&histogram->MaxUs);
+	while (latency > current)
+	{
+		LONG prev = InterlockedCompareExchange(&histogram->MaxUs, latency, current);
+		if (prev == current)
+		{
+			break;
+		}
+		current = prev;
+	}
+}
+
+//
+// Upper edge of the bucket holding the given percentile, clamped to the maximum
+//
+
+static ULONG
+Da7219LatencyPercentile(
+	IN Da7219LatencyHistogramReport* Histogram,
+	IN ULONG Percent
+)
+{
+	ULONG target = (ULONG)(((ULONG64)Histogram->Count * Percent + 99) / 100);
+	ULONG seen = 0;
+
+	for (ULONG i = 0; i < DA7219_LATENCY_BUCKETS; i++)
+	{
+		seen += Histogram->Buckets[i];
+		if (seen >= target && i < DA7219_LATENCY_BUCKETS - 1)
+		{
+			return min((ULONG)2 << i, Histogram->MaxUs);
 		}
 	}
+
+	return Histogram->MaxUs;
+}
+
+VOID
+Da7219LatencySnapshot(
+	IN PDA7219_CONTEXT DevContext,
+	OUT Da7219LatencyReport* Report
+)
+{
+	RtlZeroMemory(Report, sizeof(*Report));
+	Report->ReportID = REPORTID_LATENCY;
+
+	for (ULONG i = 0; i < Da7219LatencyCount; i++)
+	{
+		PDA7219_LATENCY_HISTOGRAM histogram = &DevContext->Latency[i];
+		Da7219LatencyHistogramReport* out = &Report->Events[i];
+		LONG64 sum = ReadNoFence64(&histogram->SumUs);
+
+		//
+		// Buckets are summed for the count so the percentiles stay consistent
+		//
+
+		for (ULONG j = 0; j < DA7219_LATENCY_BUCKETS; j++)
+		{
+			out->Buckets[j] = (ULONG)ReadNoFence(&histogram->Buckets[j]);
+			out->Count += out->Buckets[j];
+		}
+
+		if (out->Count == 0)
+		{
+			continue;
+		}
+
+		out->MinUs = (ULONG)ReadNoFence(&histogram->MinUs);
+		out->MaxUs = (ULONG)ReadNoFence(&histogram->MaxUs);
+		out->MeanUs = (ULONG)(sum / out->Count);
+		out->P50Us = Da7219LatencyPercentile(out, 50);
+		out->P90Us = Da7219LatencyPercentile(out, 90);
+		out->P99Us = Da7219LatencyPercentile(out, 99);
+	}
+}
+
+NTSTATUS
+Da7219ProcessVendorReport(
+	IN PDA7219_CONTEXT DevContext,
+	IN PVOID ReportBuffer,
+	IN ULONG ReportBufferLen,
+	IN UCHAR LatencyEvent,
+	IN uint64_t Timestamp,
+	OUT size_t* BytesWritten
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	Da7219Print(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
+		"Da7219ProcessVendorReport Entry\n");
+
+	//
+	// Queue the report and hand it to a pending read if there is one,
+	// otherwise it is returned by the next IOCTL_HID_READ_REPORT
+	//
+
+	if (Da7219ReportRingPush(&DevContext->ReportRing, ReportBuffer, ReportBufferLen,
+		LatencyEvent, Timestamp))
+	{
+		*BytesWritten = ReportBufferLen;
+
+		Da7219Trace(&DevContext->Trace, DA7219_TRACE_LEVEL_VERBOSE, DA7219_TRACE_HID,
+			Da7219TraceReportQueued, ((PUCHAR)ReportBuffer)[0], ReportBufferLen, status);
+	}
 	else
 	{
+		status = STATUS_DEVICE_BUSY;
+
+		Da7219Trace(&DevContext->Trace, DA7219_TRACE_LEVEL_ERROR, DA7219_TRACE_HID,
+			Da7219TraceReportDropped, ((PUCHAR)ReportBuffer)[0], ReportBufferLen, status);
+
 		Da7219Print(DEBUG_LEVEL_ERROR, DBG_IOCTL,
-			"WdfIoQueueRetrieveNextRequest failed Status 0x%x\n", status);
+			"Da7219ProcessVendorReport report ring full, %d dropped\n",
+			DevContext->ReportRing.Overflows);
 	}
 
+	Da7219DrainReports(DevContext);
+
 	Da7219Print(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
 		"Da7219ProcessVendorReport Exit = 0x%x\n", status);
 
@@ -1590,6 +2167,12 @@ Da7219ReadReport(
 	else
 	{
 		*CompleteRequest = FALSE;
+
+		//
+		// Satisfy it straight away if reports were queued while no read was pending
+		//
+
+		Da7219DrainReports(DevContext);
 	}
 
 	Da7219Print(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
@@ -1642,6 +2225,81 @@ Da7219SetFeature(
 
 			switch (transferPacket->reportId)
 			{
+			case REPORTID_TRACE_CONTROL:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219TraceControlReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219TraceControlReport* control = (Da7219TraceControlReport*)transferPacket->reportBuffer;
+
+					DevContext->Trace.Level = control->Level;
+					DevContext->Trace.Categories = control->Categories;
+				}
+
+				break;
+
+			case REPORTID_LATENCY:
+
+				if (transferPacket->reportBufferLen < FIELD_OFFSET(Da7219LatencyReport, Events))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else if (((Da7219LatencyReport*)transferPacket->reportBuffer)->Reset)
+				{
+					Da7219LatencyReset(DevContext);
+				}
+
+				break;
+
+			case REPORTID_SPB_STATS:
+
+				if (transferPacket->reportBufferLen < FIELD_OFFSET(Da7219SpbStatsReport, Frequency))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else if (((Da7219SpbStatsReport*)transferPacket->reportBuffer)->Reset)
+				{
+					SPB_STATISTICS snapshot;
+
+					SpbGetStatistics(&DevContext->I2CContext, &snapshot, TRUE);
+				}
+
+				break;
+
+			case REPORTID_CAPTURE_CONTROL:
+
+				if (transferPacket->reportBufferLen < FIELD_OFFSET(Da7219CaptureControlReport, Used))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else if (((Da7219CaptureControlReport*)transferPacket->reportBuffer)->Enable)
+				{
+					SpbCaptureStart(&DevContext->I2CContext);
+				}
+				else
+				{
+					SpbCaptureStop(&DevContext->I2CContext);
+				}
+
+				break;
+
+			case REPORTID_CAPTURE_DATA:
+
+				if (transferPacket->reportBufferLen < FIELD_OFFSET(Da7219CaptureDataReport, Length))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					DevContext->I2CContext.Capture.ReadOffset =
+						((Da7219CaptureDataReport*)transferPacket->reportBuffer)->Offset;
+				}
+
+				break;
+
 			default:
 
 				Da7219Print(DEBUG_LEVEL_ERROR, DBG_IOCTL,
@@ -1704,6 +2362,231 @@ Da7219GetFeature(
 
 			switch (transferPacket->reportId)
 			{
+			case REPORTID_TRACE_CONTROL:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219TraceControlReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219TraceControlReport* control = (Da7219TraceControlReport*)transferPacket->reportBuffer;
+
+					control->ReportID = REPORTID_TRACE_CONTROL;
+					control->Level = (BYTE)DevContext->Trace.Level;
+					control->Categories = (BYTE)DevContext->Trace.Categories;
+					control->Next = DevContext->Trace.Next;
+					control->ReadCursor = DevContext->Trace.ReadCursor;
+					control->Frequency = DevContext->Trace.Frequency;
+
+					WdfRequestSetInformation(Request, sizeof(Da7219TraceControlReport));
+				}
+
+				break;
+
+			case REPORTID_TRACE_DATA:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219TraceDataReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219TraceDataReport* data = (Da7219TraceDataReport*)transferPacket->reportBuffer;
+					DA7219_TRACE_RECORD records[DA7219_TRACE_REPORT_RECORDS];
+					ULONG first;
+					ULONG count = da7219_trace_read(&DevContext->Trace, &first, records, DA7219_TRACE_REPORT_RECORDS);
+
+					RtlZeroMemory(data, sizeof(Da7219TraceDataReport));
+					data->ReportID = REPORTID_TRACE_DATA;
+					data->First = first;
+					data->Count = (BYTE)count;
+
+					for (ULONG i = 0; i < count; i++)
+					{
+						data->Records[i].Sequence = records[i].Sequence;
+						data->Records[i].Event = records[i].Event;
+						data->Records[i].Reg = records[i].Reg;
+						data->Records[i].Level = records[i].Level;
+						data->Records[i].Timestamp = records[i].Timestamp;
+						data->Records[i].Value = records[i].Value;
+						data->Records[i].Status = records[i].Status;
+					}
+
+					WdfRequestSetInformation(Request, sizeof(Da7219TraceDataReport));
+				}
+
+				break;
+
+			case REPORTID_BOOT_PROFILE:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219BootProfileReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219BootProfileReport* profile = (Da7219BootProfileReport*)transferPacket->reportBuffer;
+					ULONG count;
+
+					RtlZeroMemory(profile, sizeof(Da7219BootProfileReport));
+					profile->ReportID = REPORTID_BOOT_PROFILE;
+
+					WdfSpinLockAcquire(DevContext->BootProfileLock);
+
+					count = min(DevContext->BootProfileRuns, DA7219_BOOT_PROFILE_RUNS);
+					profile->Runs = DevContext->BootProfileRuns;
+					profile->Count = (BYTE)count;
+
+					for (ULONG i = 0; i < count; i++)
+					{
+						ULONG run = DevContext->BootProfileRuns - count + i;
+
+						profile->Records[i] = DevContext->BootProfile[run % DA7219_BOOT_PROFILE_RUNS];
+					}
+
+					WdfSpinLockRelease(DevContext->BootProfileLock);
+
+					WdfRequestSetInformation(Request, sizeof(Da7219BootProfileReport));
+				}
+
+				break;
+
+			case REPORTID_LATENCY:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219LatencyReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219LatencySnapshot(DevContext, (Da7219LatencyReport*)transferPacket->reportBuffer);
+
+					WdfRequestSetInformation(Request, sizeof(Da7219LatencyReport));
+				}
+
+				break;
+
+			case REPORTID_SPB_STATS:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219SpbStatsReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219SpbStatsReport* report = (Da7219SpbStatsReport*)transferPacket->reportBuffer;
+					SPB_STATISTICS snapshot;
+
+					SpbGetStatistics(&DevContext->I2CContext, &snapshot, FALSE);
+
+					RtlZeroMemory(report, sizeof(Da7219SpbStatsReport));
+					report->ReportID = REPORTID_SPB_STATS;
+					report->Frequency = snapshot.Frequency;
+					report->LockAcquisitions = snapshot.LockAcquisitions;
+					report->LockContentions = snapshot.LockContentions;
+					report->LockWaitTicks = snapshot.LockWaitTicks;
+					report->LockWaitMaxTicks = snapshot.LockWaitMaxTicks;
+					report->LockHeldTicks = snapshot.LockHeldTicks;
+					report->LockHeldMaxTicks = snapshot.LockHeldMaxTicks;
+					report->AsyncTransactions = snapshot.AsyncTransactions;
+
+					for (ULONG i = 0; i < 2; i++)
+					{
+						report->Transactions[i] = snapshot.Transactions[i];
+						report->Bytes[i] = snapshot.Bytes[i];
+					}
+
+					for (ULONG i = 0; i < SPB_STATUS_SLOTS; i++)
+					{
+						report->FailureStatus[i] = snapshot.FailureStatus[i];
+						report->FailureCount[i] = snapshot.FailureCount[i];
+					}
+
+					WdfRequestSetInformation(Request, sizeof(Da7219SpbStatsReport));
+				}
+
+				break;
+
+			case REPORTID_CAPTURE_CONTROL:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219CaptureControlReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219CaptureControlReport* control = (Da7219CaptureControlReport*)transferPacket->reportBuffer;
+					SPB_CAPTURE* capture = &DevContext->I2CContext.Capture;
+					LARGE_INTEGER frequency;
+
+					KeQueryPerformanceCounter(&frequency);
+
+					control->ReportID = REPORTID_CAPTURE_CONTROL;
+					control->Enable = (BYTE)ReadNoFence(&capture->Enabled);
+					control->Used = min((ULONG)ReadNoFence(&capture->Used), SPB_CAPTURE_SIZE);
+					control->Size = SPB_CAPTURE_SIZE;
+					control->Dropped = (ULONG)ReadNoFence(&capture->Dropped);
+					control->Frequency = frequency.QuadPart;
+
+					WdfRequestSetInformation(Request, sizeof(Da7219CaptureControlReport));
+				}
+
+				break;
+
+			case REPORTID_CAPTURE_DATA:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219CaptureDataReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else
+				{
+					Da7219CaptureDataReport* data = (Da7219CaptureDataReport*)transferPacket->reportBuffer;
+					SPB_CAPTURE* capture = &DevContext->I2CContext.Capture;
+
+					RtlZeroMemory(data, sizeof(Da7219CaptureDataReport));
+					data->ReportID = REPORTID_CAPTURE_DATA;
+					data->Offset = capture->ReadOffset;
+					data->Length = (BYTE)SpbCaptureRead(&DevContext->I2CContext,
+						capture->ReadOffset, data->Data, DA7219_CAPTURE_CHUNK);
+					capture->ReadOffset += data->Length;
+
+					WdfRequestSetInformation(Request, sizeof(Da7219CaptureDataReport));
+				}
+
+				break;
+
+			case REPORTID_REG_SNAPSHOT:
+
+				if (transferPacket->reportBufferLen < sizeof(Da7219RegSnapshotReport))
+				{
+					status = STATUS_BUFFER_TOO_SMALL;
+				}
+				else if (!DevContext->DevicePoweredOn || KeGetCurrentIrql() > PASSIVE_LEVEL)
+				{
+					status = STATUS_INVALID_DEVICE_STATE;
+				}
+				else
+				{
+					Da7219RegSnapshotReport* snapshot = (Da7219RegSnapshotReport*)transferPacket->reportBuffer;
+					ULONG bursts;
+
+					snapshot->ReportID = REPORTID_REG_SNAPSHOT;
+					WdfWaitLockAcquire(DevContext->CodecLock, NULL);
+					status = da7219_reg_snapshot(&DevContext->Codec,
+						snapshot->Registers, snapshot->Valid, &bursts);
+					WdfWaitLockRelease(DevContext->CodecLock);
+					snapshot->Bursts = (BYTE)bursts;
+
+					if (NT_SUCCESS(status))
+					{
+						WdfRequestSetInformation(Request, sizeof(Da7219RegSnapshotReport));
+					}
+				}
+
+				break;
+
 			default:
 
 				Da7219Print(DEBUG_LEVEL_ERROR, DBG_IOCTL,
@@ -22,12 +22,9 @@
 
 #include "spb.h"
 
-typedef enum platform {
-	PlatformNone,
-	PlatformIntel,
-	PlatformStoney,
-	PlatformRyzen
-} Platform;
+#include "codec.h"
+
+#include "ring.h"
 
 enum snd_jack_types {
 	SND_JACK_HEADPHONE = 0x0001,
@@ -76,7 +73,7 @@ HID_REPORT_DESCRIPTOR DefaultReportDescriptor[] = {
 	0xa1, 0x01,                          // COLLECTION (Application)
 	0x85, REPORTID_SPECKEYS,             //   REPORT_ID (Special Keys)
 	0x15, 0x00,                          //   LOGICAL_MINIMUM (0)
-	0x26, 0xff, 0x00,                    //   LOGICAL_MAXIMUM (256)
+	0x26, 0xff, 0x00,                    //   LOGICAL_MAXIMUM (255)
 	0x75, 0x08,                          //   REPORT_SIZE  (8)   - bits
 	0x95, 0x01,                          //   REPORT_COUNT (1)  - Bytes
 	0x09, 0x02,                          //   USAGE (Vendor Usage 1)
@@ -86,6 +83,53 @@ HID_REPORT_DESCRIPTOR DefaultReportDescriptor[] = {
 	0x09, 0x02,                          //   USAGE (Vendor Usage 1)
 	0x91, 0x02,                          //   OUTPUT (Data,Var,Abs)
 	0xc0,                                // END_COLLECTION
+
+	0x06, 0x00, 0xff,                    // USAGE_PAGE (Vendor Defined Page 1)
+	0x09, 0x05,                          // USAGE (Vendor Usage 5)
+	0xa1, 0x01,                          // COLLECTION (Application)
+	0x15, 0x00,                          //   LOGICAL_MINIMUM (0)
+	0x26, 0xff, 0x00,                    //   LOGICAL_MAXIMUM (255)
+	0x75, 0x08,                          //   REPORT_SIZE  (8)   - bits
+	0x85, REPORTID_TRACE_CONTROL,        //   REPORT_ID (Trace Control)
+	0x95, sizeof(Da7219TraceControlReport) - 1, //   REPORT_COUNT - Bytes
+	0x09, 0x06,                          //   USAGE (Vendor Usage 6)
+	0xb1, 0x02,                          //   FEATURE (Data,Var,Abs)
+	0x85, REPORTID_TRACE_DATA,           //   REPORT_ID (Trace Data)
+	0x95, sizeof(Da7219TraceDataReport) - 1, //   REPORT_COUNT - Bytes
+	0x09, 0x07,                          //   USAGE (Vendor Usage 7)
+	0xb1, 0x02,                          //   FEATURE (Data,Var,Abs)
+	0x85, REPORTID_BOOT_PROFILE,         //   REPORT_ID (Boot Profile)
+	0x96, (sizeof(Da7219BootProfileReport) - 1) & 0xff,
+		(sizeof(Da7219BootProfileReport) - 1) >> 8, //   REPORT_COUNT - Bytes
+	0x09, 0x08,                          //   USAGE (Vendor Usage 8)
+	0xb1, 0x02,                          //   FEATURE (Data,Var,Abs)
+	0x85, REPORTID_LATENCY,              //   REPORT_ID (Latency)
+	0x96, (sizeof(Da7219LatencyReport) - 1) & 0xff,
+		(sizeof(Da7219LatencyReport) - 1) >> 8, //   REPORT_COUNT - Bytes
+	0x09, 0x09,                          //   USAGE (Vendor Usage 9)
+	0xb1, 0x02,                          //   FEATURE (Data,Var,Abs)
+	0x85, REPORTID_SPB_STATS,            //   REPORT_ID (SPB Statistics)
+	0x95, sizeof(Da7219SpbStatsReport) - 1, //   REPORT_COUNT - Bytes
+	0x09, 0x0a,                          //   USAGE (Vendor Usage 10)
+	0xb1, 0x02,                          //   FEATURE (Data,Var,Abs)
+	0x85, REPORTID_CAPTURE_CONTROL,      //   REPORT_ID (Capture Control)
+	0x95, sizeof(Da7219CaptureControlReport) - 1, //   REPORT_COUNT - Bytes
+	0x09, 0x0b,                          //   USAGE (Vendor Usage 11)
+	0xb1, 0x02,                          //   FEATURE (Data,Var,Abs)
+	0x85, REPORTID_CAPTURE_DATA,         //   REPORT_ID (Capture Data)
+	0x95, sizeof(Da7219CaptureDataReport) - 1, //   REPORT_COUNT - Bytes
+	0x09, 0x0c,                          //   USAGE (Vendor Usage 12)
+	0xb1, 0x02,                          //   FEATURE (Data,Var,Abs)
+	0x85, REPORTID_REG_SNAPSHOT,         //   REPORT_ID (Register Snapshot)
+	0x96, (sizeof(Da7219RegSnapshotReport) - 1) & 0xff,
+		(sizeof(Da7219RegSnapshotReport) - 1) >> 8, //   REPORT_COUNT - Bytes
+	0x09, 0x0d,                          //   USAGE (Vendor Usage 13)
+	0xb1, 0x02,                          //   FEATURE (Data,Var,Abs)
+	0x85, REPORTID_STREAM,               //   REPORT_ID (Stream)
+	0x95, sizeof(Da7219StreamReport) - 1, //   REPORT_COUNT - Bytes
+	0x09, 0x0e,                          //   USAGE (Vendor Usage 14)
+	0x91, 0x02,                          //   OUTPUT (Data,Var,Abs)
+	0xc0,                                // END_COLLECTION
 };
 
 
@@ -106,6 +150,108 @@ CONST HID_DESCRIPTOR DefaultHidDescriptor = {
 };
 #endif
 
+//
+// Acknowledged interrupts waiting to be decoded and reported. The ISR is
+// the only producer and the IRQ work item, holding IrqWorkItemBusy, the
+// only consumer. The events were already cleared in the codec, so a record
+// the full queue cannot take is merged into Spill rather than dropped: its
+// event bits OR'd in, its status replacing the last. Spill goes to the
+// consumer once the queue ahead of it is drained, and later records merge
+// into it until then so nothing is reported out of order.
+//
+
+#define DA7219_IRQ_QUEUE_SIZE       16
+
+#define DA7219_IRQ_SPILL_PRESENT    0x10000
+
+C_ASSERT((DA7219_IRQ_QUEUE_SIZE & (DA7219_IRQ_QUEUE_SIZE - 1)) == 0);
+
+typedef struct _DA7219_IRQ_SLOT
+{
+	DA7219_IRQ_RECORD Record;
+
+	uint64_t Timestamp; // ISR entry in microseconds
+
+} DA7219_IRQ_SLOT, *PDA7219_IRQ_SLOT;
+
+typedef struct _DA7219_IRQ_QUEUE
+{
+	volatile LONG Head;
+
+	volatile LONG Tail;
+
+	volatile LONG Overflows; // acknowledged interrupts merged into Spill
+
+	volatile LONG Spill; // EventA | EventB << 8 | DA7219_IRQ_SPILL_PRESENT, 0 when empty
+
+	volatile LONG SpillStatus; // StatusA | StatusB << 8 of the last record merged
+
+	uint64_t SpillTimestamp; // ISR entry of the first record merged
+
+	DA7219_IRQ_SLOT Slots[DA7219_IRQ_QUEUE_SIZE];
+
+} DA7219_IRQ_QUEUE, *PDA7219_IRQ_QUEUE;
+
+//
+// Accessory events whose interrupt to report latency is tracked. Insert
+// raises no report of its own, it is timed to when Da7219IrqWorkItem has
+// decoded it.
+//
+
+typedef enum _DA7219_LATENCY_EVENT
+{
+	Da7219LatencyInsert,
+	Da7219LatencyDetect,
+	Da7219LatencyRemove,
+	Da7219LatencyButtonA,
+	Da7219LatencyButtonB,
+	Da7219LatencyButtonC,
+	Da7219LatencyButtonD,
+	Da7219LatencyCount,
+	Da7219LatencyNone = 0xFF
+} DA7219_LATENCY_EVENT;
+
+C_ASSERT(Da7219LatencyCount == DA7219_LATENCY_EVENTS);
+
+C_ASSERT(SPB_STATUS_SLOTS == ARRAYSIZE(((Da7219SpbStatsReport*)0)->FailureStatus));
+
+C_ASSERT(DA7219_REG_COUNT == sizeof(((Da7219RegSnapshotReport*)0)->Registers));
+
+C_ASSERT(DA7219_STREAM_PLAYBACK == DA7219_PATH_PLAYBACK && DA7219_STREAM_CAPTURE == DA7219_PATH_CAPTURE);
+
+typedef struct _DA7219_LATENCY_HISTOGRAM
+{
+	volatile LONG Count;
+
+	volatile LONG MinUs;
+
+	volatile LONG MaxUs;
+
+	volatile LONG64 SumUs;
+
+	volatile LONG Buckets[DA7219_LATENCY_BUCKETS];
+
+} DA7219_LATENCY_HISTOGRAM, *PDA7219_LATENCY_HISTOGRAM;
+
+//
+// Phases timed for each boot or resume
+//
+
+typedef enum _DA7219_BOOT_PHASE
+{
+	Da7219BootPhaseSuspend,     // OnD0Exit before this power up
+	Da7219BootPhaseDispatch,    // OnD0Entry to the boot work item running
+	Da7219BootPhaseStart,       // retained state check and warm resume
+	Da7219BootPhaseWaitStandby, // SYSTEM_STATUS wait
+	Da7219BootPhaseReset,       // soft reset and cache replay
+	Da7219BootPhasePower,       // power sequence
+	Da7219BootPhaseSetup,       // AAD, PLL and DAI setup
+	Da7219BootPhaseIdleIrp,     // Da7219CompleteIdleIrp
+	Da7219BootPhaseCount
+} DA7219_BOOT_PHASE;
+
+C_ASSERT(Da7219BootPhaseCount == DA7219_BOOT_PROFILE_PHASES);
+
 typedef struct _DA7219_CONTEXT
 {
 
@@ -113,16 +259,81 @@ typedef struct _DA7219_CONTEXT
 
 	WDFQUEUE ReportQueue;
 
+	DA7219_REPORT_RING ReportRing;
+
 	WDFQUEUE IdleQueue;
 
 	SPB_CONTEXT I2CContext;
 
-	BOOLEAN DevicePoweredOn;
+	BOOLEAN DevicePoweredOn; // the ISR acknowledges only while set, cleared first thing in OnD0Exit
 
 	WDFINTERRUPT Interrupt;
 
+	DA7219_IRQ_QUEUE IrqQueue;
+
 	INT JackType;
 
+	//
+	// Boot state machine in the codec core is resumed from BootTimer, path
+	// power changes from DapmTimer. BootStopping is set under CodecLock by
+	// OnD0Exit, a boot that sees it does not advance, and neither timer is
+	// re-armed once it is set.
+	//
+
+	WDFTIMER BootTimer;
+
+	WDFTIMER DapmTimer;
+
+	BOOLEAN BootStopping;
+
+	//
+	// Serializes the codec core between the boot, the interrupt work item
+	// and stream notifications from the audio stack. The ISR's acknowledge
+	// stays outside it.
+	//
+
+	WDFWAITLOCK CodecLock;
+
+	//
+	// Work items created once in EvtDeviceAdd and re-enqueued, so the power,
+	// idle and interrupt paths never allocate. IdleWorkItemBusy is set while
+	// IdleWorkItem owns an idle notification request, IrqWorkItemBusy while
+	// an IrqWorkItem instance is draining IrqQueue.
+	//
+
+	WDFWORKITEM BootWorkItem;
+
+	WDFWORKITEM IdleWorkItem;
+
+	WDFWORKITEM IrqWorkItem;
+
+	volatile LONG IdleWorkItemBusy;
+
+	volatile LONG IrqWorkItemBusy;
+
+	DA7219_CODEC Codec;
+
+	DA7219_TRACE Trace;
+
+	//
+	// Boot profiler, BootProfileCurrent is filled in as the boot runs and
+	// committed to the BootProfile history under BootProfileLock
+	//
+
+	WDFSPINLOCK BootProfileLock;
+
+	ULONG BootProfileRuns;
+
+	Da7219BootProfileRecord BootProfile[DA7219_BOOT_PROFILE_RUNS];
+
+	Da7219BootProfileRecord BootProfileCurrent;
+
+	uint64_t D0EntryUs;
+
+	ULONG SuspendUs;
+
+	DA7219_LATENCY_HISTOGRAM Latency[Da7219LatencyCount];
+
 } DA7219_CONTEXT, *PDA7219_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DA7219_CONTEXT, GetDeviceContext)
@@ -183,14 +394,39 @@ Da7219WriteReport(
 	IN WDFREQUEST Request
 );
 
+VOID
+Da7219DrainReports(
+	IN PDA7219_CONTEXT DevContext
+);
+
 NTSTATUS
 Da7219ProcessVendorReport(
 	IN PDA7219_CONTEXT DevContext,
 	IN PVOID ReportBuffer,
 	IN ULONG ReportBufferLen,
+	IN UCHAR LatencyEvent,
+	IN uint64_t Timestamp,
 	OUT size_t* BytesWritten
 );
 
+VOID
+Da7219LatencyReset(
+	IN PDA7219_CONTEXT DevContext
+);
+
+VOID
+Da7219LatencyRecord(
+	IN PDA7219_CONTEXT DevContext,
+	IN UCHAR LatencyEvent,
+	IN uint64_t Timestamp
+);
+
+VOID
+Da7219LatencySnapshot(
+	IN PDA7219_CONTEXT DevContext,
+	OUT Da7219LatencyReport* Report
+);
+
 NTSTATUS
 Da7219ReadReport(
 	IN PDA7219_CONTEXT DevContext,
@@ -222,6 +458,10 @@ Da7219CompleteIdleIrp(
 	IN PDA7219_CONTEXT FxDeviceContext
 );
 
+EVT_WDF_WORKITEM Da7219IdleIrpWorkItem;
+
+EVT_WDF_WORKITEM Da7219IrqWorkItem;
+
 //
 // Helper macros
 //
@@ -16,6 +16,15 @@
 
 #define REPORTID_MEDIA	0x01
 #define REPORTID_SPECKEYS		0x02
+#define REPORTID_TRACE_CONTROL	0x03
+#define REPORTID_TRACE_DATA		0x04
+#define REPORTID_BOOT_PROFILE	0x05
+#define REPORTID_LATENCY		0x06
+#define REPORTID_SPB_STATS		0x07
+#define REPORTID_CAPTURE_CONTROL	0x08
+#define REPORTID_CAPTURE_DATA	0x09
+#define REPORTID_REG_SNAPSHOT	0x0A
+#define REPORTID_STREAM			0x0B
 
 #pragma pack(1)
 typedef struct _DA7219_MEDIA_REPORT
@@ -55,4 +64,276 @@ typedef struct _CSAUDIO_SPECKEYREQ_REPORT
 } CsAudioSpecialKeyRequestReport;
 #pragma pack()
 
+//
+// Trace ring control, get returns the ring state, set changes the level and categories
+//
+
+#pragma pack(1)
+typedef struct _DA7219_TRACE_CONTROL_REPORT
+{
+
+	BYTE      ReportID;
+
+	BYTE      Level;
+
+	BYTE      Categories;
+
+	ULONG     Next;
+
+	ULONG     ReadCursor;
+
+	ULONG64   Frequency;
+
+} Da7219TraceControlReport;
+#pragma pack()
+
+//
+// Trace records from the read cursor, each get advances the cursor by Count
+//
+
+#define DA7219_TRACE_REPORT_RECORDS 8
+
+#pragma pack(1)
+typedef struct _DA7219_TRACE_REPORT_RECORD
+{
+
+	ULONG     Sequence;
+
+	USHORT    Event;
+
+	BYTE      Reg;
+
+	BYTE      Level;
+
+	ULONG64   Timestamp;
+
+	ULONG     Value;
+
+	LONG      Status;
+
+} Da7219TraceReportRecord;
+
+typedef struct _DA7219_TRACE_DATA_REPORT
+{
+
+	BYTE      ReportID;
+
+	ULONG     First;
+
+	BYTE      Count;
+
+	Da7219TraceReportRecord Records[DA7219_TRACE_REPORT_RECORDS];
+
+} Da7219TraceDataReport;
+#pragma pack()
+
+//
+// Per-phase timings of the last DA7219_BOOT_PROFILE_RUNS boots and resumes,
+// oldest first. PhaseUs is indexed by DA7219_BOOT_PHASE.
+//
+
+#define DA7219_BOOT_PROFILE_RUNS    8
+#define DA7219_BOOT_PROFILE_PHASES  8
+
+#pragma pack(1)
+typedef struct _DA7219_BOOT_PROFILE_RECORD
+{
+
+	ULONG     Sequence;
+
+	BYTE      Resume;
+
+	LONG      Status;
+
+	ULONG     TotalUs; // OnD0Entry to the idle IRP being completed
+
+	ULONG     PhaseUs[DA7219_BOOT_PROFILE_PHASES];
+
+} Da7219BootProfileRecord;
+
+typedef struct _DA7219_BOOT_PROFILE_REPORT
+{
+
+	BYTE      ReportID;
+
+	ULONG     Runs; // boots recorded since the device was added
+
+	BYTE      Count;
+
+	Da7219BootProfileRecord Records[DA7219_BOOT_PROFILE_RUNS];
+
+} Da7219BootProfileReport;
+#pragma pack()
+
+//
+// Interrupt to report latency per accessory event. Bucket 0 counts latencies
+// under 2us, bucket i those in [2^i, 2^(i+1)) us and the last bucket everything
+// above. Get returns a snapshot, set with Reset nonzero clears the histograms.
+//
+
+#define DA7219_LATENCY_EVENTS       7
+#define DA7219_LATENCY_BUCKETS      20
+
+#pragma pack(1)
+typedef struct _DA7219_LATENCY_HISTOGRAM_REPORT
+{
+
+	ULONG     Count;
+
+	ULONG     MinUs;
+
+	ULONG     MaxUs;
+
+	ULONG     MeanUs;
+
+	ULONG     P50Us;
+
+	ULONG     P90Us;
+
+	ULONG     P99Us;
+
+	ULONG     Buckets[DA7219_LATENCY_BUCKETS];
+
+} Da7219LatencyHistogramReport;
+
+typedef struct _DA7219_LATENCY_REPORT
+{
+
+	BYTE      ReportID;
+
+	BYTE      Reset;
+
+	Da7219LatencyHistogramReport Events[DA7219_LATENCY_EVENTS];
+
+} Da7219LatencyReport;
+#pragma pack()
+
+//
+// SPB lock contention and bus utilization, times in Frequency ticks.
+// Get returns a snapshot, set with Reset nonzero clears the counters.
+//
+
+#pragma pack(1)
+typedef struct _DA7219_SPB_STATS_REPORT
+{
+
+	BYTE      ReportID;
+
+	BYTE      Reset;
+
+	ULONG64   Frequency;
+
+	ULONG     LockAcquisitions;
+
+	ULONG     LockContentions;
+
+	ULONG64   LockWaitTicks;
+
+	ULONG64   LockWaitMaxTicks;
+
+	ULONG64   LockHeldTicks;
+
+	ULONG64   LockHeldMaxTicks;
+
+	ULONG     Transactions[2]; // read, write
+
+	ULONG64   Bytes[2]; // read, write
+
+	ULONG     AsyncTransactions;
+
+	LONG      FailureStatus[8];
+
+	ULONG     FailureCount[8];
+
+} Da7219SpbStatsReport;
+#pragma pack()
+
+//
+// I2C capture control. Set with Enable nonzero starts a fresh capture,
+// zero stops it. Get returns the capture state.
+//
+
+#pragma pack(1)
+typedef struct _DA7219_CAPTURE_CONTROL_REPORT
+{
+
+	BYTE      ReportID;
+
+	BYTE      Enable;
+
+	ULONG     Used;
+
+	ULONG     Size;
+
+	ULONG     Dropped;
+
+	ULONG64   Frequency;
+
+} Da7219CaptureControlReport;
+#pragma pack()
+
+//
+// I2C capture contents. Get returns the next chunk from the read offset,
+// set moves the read offset to Offset.
+//
+
+#define DA7219_CAPTURE_CHUNK 240
+
+#pragma pack(1)
+typedef struct _DA7219_CAPTURE_DATA_REPORT
+{
+
+	BYTE      ReportID;
+
+	ULONG     Offset;
+
+	BYTE      Length;
+
+	BYTE      Data[DA7219_CAPTURE_CHUNK];
+
+} Da7219CaptureDataReport;
+#pragma pack()
+
+//
+// Live codec register image read straight from the bus. Bit i of Valid is
+// set when Registers[i] was read, holes and precious registers are skipped.
+//
+
+#pragma pack(1)
+typedef struct _DA7219_REG_SNAPSHOT_REPORT
+{
+
+	BYTE      ReportID;
+
+	BYTE      Bursts; // auto-increment reads the snapshot took
+
+	BYTE      Valid[256 / 8];
+
+	BYTE      Registers[256];
+
+} Da7219RegSnapshotReport;
+#pragma pack()
+
+//
+// Output report from the audio stack when streams start or stop. The codec
+// paths named in Streams are powered while Active is set. Until the first
+// report arrives both paths are powered whenever the codec is in D0.
+//
+
+#define DA7219_STREAM_PLAYBACK	0x01
+#define DA7219_STREAM_CAPTURE	0x02
+
+#pragma pack(1)
+typedef struct _DA7219_STREAM_REPORT
+{
+
+	BYTE      ReportID;
+
+	BYTE      Streams;
+
+	BYTE      Active;
+
+} Da7219StreamReport;
+#pragma pack()
+
 #endif
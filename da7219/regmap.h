@@ -0,0 +1,254 @@
+#if !defined(_DA7219_REGMAP_H_)
+#define _DA7219_REGMAP_H_
+
+#include "registers.h"
+#include "registers-aad.h"
+
+//
+// DA7219 register map, one X(reg, default, flags, fields) entry per register
+// in address order. default is the power-on/soft reset value and only means
+// something with DA7219_REG_DEFAULT set, flags are the DA7219_REG_* access
+// flags from codec.h and fields is the OR of the register's field masks.
+// Expand DA7219_REGMAP with an X of your own to build tables from it; the
+// codec core builds da7219_reg_info this way.
+//
+
+#define DA7219_REGMAP(X) \
+	X(DA7219_MIC_1_GAIN_STATUS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_MIC_1_AMP_GAIN_STATUS_MASK) \
+	X(DA7219_MIXIN_L_GAIN_STATUS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_MIXIN_L_AMP_GAIN_STATUS_MASK) \
+	X(DA7219_ADC_L_GAIN_STATUS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_ADC_L_DIGITAL_GAIN_STATUS_MASK) \
+	X(DA7219_DAC_L_GAIN_STATUS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_DAC_L_DIGITAL_GAIN_STATUS_MASK) \
+	X(DA7219_DAC_R_GAIN_STATUS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_DAC_R_DIGITAL_GAIN_STATUS_MASK) \
+	X(DA7219_HP_L_GAIN_STATUS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_HP_L_AMP_GAIN_STATUS_MASK) \
+	X(DA7219_HP_R_GAIN_STATUS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_HP_R_AMP_GAIN_STATUS_MASK) \
+	X(DA7219_MIC_1_SELECT, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIC_1_AMP_IN_SEL_MASK) \
+	X(DA7219_CIF_TIMEOUT_CTRL, 0x01, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_I2C_TIMEOUT_EN_MASK) \
+	X(DA7219_CIF_CTRL, 0x00, DA7219_REG_RW | DA7219_REG_VOLATILE, \
+		DA7219_CIF_I2C_WRITE_MODE_MASK | DA7219_CIF_REG_SOFT_RESET_MASK) \
+	X(DA7219_SR_24_48, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_SR_24_48_MASK) \
+	X(DA7219_SR, 0x0A, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_SR_MASK) \
+	X(DA7219_CIF_I2C_ADDR_CFG, 0x02, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_CIF_I2C_ADDR_CFG_MASK) \
+	X(DA7219_PLL_CTRL, 0x10, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_PLL_INDIV_MASK | DA7219_PLL_MCLK_SQR_EN_MASK | DA7219_PLL_MODE_MASK) \
+	X(DA7219_PLL_FRAC_TOP, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_PLL_FBDIV_FRAC_TOP_MASK) \
+	X(DA7219_PLL_FRAC_BOT, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_PLL_FBDIV_FRAC_BOT_MASK) \
+	X(DA7219_PLL_INTEGER, 0x20, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_PLL_FBDIV_INTEGER_MASK) \
+	X(DA7219_PLL_SRM_STS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_PLL_SRM_STATE_MASK | DA7219_PLL_SRM_STATUS_MASK) \
+	X(DA7219_DIG_ROUTING_DAI, 0x10, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAI_L_SRC_MASK | DA7219_DAI_R_SRC_MASK) \
+	X(DA7219_DAI_CLK_MODE, 0x01, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAI_BCLKS_PER_WCLK_MASK | DA7219_DAI_CLK_POL_MASK | DA7219_DAI_WCLK_POL_MASK | \
+		DA7219_DAI_WCLK_TRI_STATE_MASK | DA7219_DAI_CLK_EN_MASK) \
+	X(DA7219_DAI_CTRL, 0x28, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAI_FORMAT_MASK | DA7219_DAI_WORD_LENGTH_MASK | DA7219_DAI_CH_NUM_MASK | \
+		DA7219_DAI_EN_MASK) \
+	X(DA7219_DAI_TDM_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAI_TDM_CH_EN_MASK | DA7219_DAI_OE_MASK | DA7219_DAI_TDM_MODE_EN_MASK) \
+	X(DA7219_DIG_ROUTING_DAC, 0x32, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_L_SRC_MASK | DA7219_DAC_L_MONO_MASK | DA7219_DAC_R_SRC_MASK | \
+		DA7219_DAC_R_MONO_MASK) \
+	X(DA7219_ALC_CTRL1, 0x00, DA7219_REG_RW | DA7219_REG_VOLATILE, \
+		DA7219_ALC_OFFSET_EN_MASK | DA7219_ALC_SYNC_MODE_MASK | DA7219_ALC_EN_MASK | \
+		DA7219_ALC_AUTO_CALIB_EN_MASK | DA7219_ALC_CALIB_OVERFLOW_MASK) \
+	X(DA7219_DAI_OFFSET_LOWER, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAI_OFFSET_LOWER_MASK) \
+	X(DA7219_DAI_OFFSET_UPPER, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAI_OFFSET_UPPER_MASK) \
+	X(DA7219_REFERENCES, 0x08, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_BIAS_EN_MASK | DA7219_VMID_FAST_CHARGE_MASK) \
+	X(DA7219_MIXIN_L_SELECT, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIXIN_L_MIX_SELECT_MASK) \
+	X(DA7219_MIXIN_L_GAIN, 0x03, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIXIN_L_AMP_GAIN_MASK) \
+	X(DA7219_ADC_L_GAIN, 0x6F, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ADC_L_DIGITAL_GAIN_MASK) \
+	X(DA7219_ADC_FILTERS1, 0x80, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ADC_VOICE_HPF_CORNER_MASK | DA7219_ADC_VOICE_EN_MASK | DA7219_ADC_AUDIO_HPF_CORNER_MASK | \
+		DA7219_ADC_HPF_EN_MASK | DA7219_HPF_MODE_MASK) \
+	X(DA7219_MIC_1_GAIN, 0x01, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIC_1_AMP_GAIN_MASK) \
+	X(DA7219_SIDETONE_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_SIDETONE_MUTE_EN_MASK | DA7219_SIDETONE_EN_MASK) \
+	X(DA7219_SIDETONE_GAIN, 0x0E, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_SIDETONE_GAIN_MASK) \
+	X(DA7219_DROUTING_ST_OUTFILT_1L, 0x01, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_OUTFILT_ST_1L_SRC_MASK) \
+	X(DA7219_DROUTING_ST_OUTFILT_1R, 0x02, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_OUTFILT_ST_1R_SRC_MASK) \
+	X(DA7219_DAC_FILTERS5, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_SOFTMUTE_RATE_MASK | DA7219_DAC_SOFTMUTE_EN_MASK) \
+	X(DA7219_DAC_FILTERS2, 0x88, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_EQ_BAND1_MASK | DA7219_DAC_EQ_BAND2_MASK) \
+	X(DA7219_DAC_FILTERS3, 0x88, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_EQ_BAND3_MASK | DA7219_DAC_EQ_BAND4_MASK) \
+	X(DA7219_DAC_FILTERS4, 0x08, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_EQ_BAND5_MASK | DA7219_DAC_EQ_EN_MASK) \
+	X(DA7219_DAC_FILTERS1, 0x80, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_VOICE_HPF_CORNER_MASK | DA7219_DAC_VOICE_EN_MASK | DA7219_DAC_AUDIO_HPF_CORNER_MASK | \
+		DA7219_DAC_HPF_EN_MASK) \
+	X(DA7219_DAC_L_GAIN, 0x6F, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_L_DIGITAL_GAIN_MASK) \
+	X(DA7219_DAC_R_GAIN, 0x6F, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_R_DIGITAL_GAIN_MASK) \
+	X(DA7219_CP_CTRL, 0x20, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_CP_MCHANGE_MASK | DA7219_CP_MCHANGE_REL_MASK | DA7219_CP_EN_MASK) \
+	X(DA7219_HP_L_GAIN, 0x39, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_HP_L_AMP_GAIN_MASK) \
+	X(DA7219_HP_R_GAIN, 0x39, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_HP_R_AMP_GAIN_MASK) \
+	X(DA7219_MIXOUT_L_SELECT, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIXOUT_L_MIX_SELECT_MASK) \
+	X(DA7219_MIXOUT_R_SELECT, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIXOUT_R_MIX_SELECT_MASK) \
+	X(DA7219_SYSTEM_MODES_INPUT, 0x00, DA7219_REG_RW | DA7219_REG_VOLATILE, \
+		DA7219_MODE_SUBMIT_MASK | DA7219_ADC_MODE_MASK) \
+	X(DA7219_SYSTEM_MODES_OUTPUT, 0x00, DA7219_REG_RW | DA7219_REG_VOLATILE, \
+		DA7219_MODE_SUBMIT_MASK | DA7219_DAC_MODE_MASK) \
+	X(DA7219_MICBIAS_CTRL, 0x0A, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MICBIAS1_LEVEL_MASK | DA7219_MICBIAS1_EN_MASK) \
+	X(DA7219_MIC_1_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIC_1_AMP_RAMP_EN_MASK | DA7219_MIC_1_AMP_MUTE_EN_MASK | DA7219_MIC_1_AMP_EN_MASK) \
+	X(DA7219_MIXIN_L_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIXIN_L_MIX_EN_MASK | DA7219_MIXIN_L_AMP_ZC_EN_MASK | DA7219_MIXIN_L_AMP_RAMP_EN_MASK | \
+		DA7219_MIXIN_L_AMP_MUTE_EN_MASK | DA7219_MIXIN_L_AMP_EN_MASK) \
+	X(DA7219_ADC_L_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ADC_L_BIAS_MASK | DA7219_ADC_L_RAMP_EN_MASK | DA7219_ADC_L_MUTE_EN_MASK | \
+		DA7219_ADC_L_EN_MASK) \
+	X(DA7219_DAC_L_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_L_RAMP_EN_MASK | DA7219_DAC_L_MUTE_EN_MASK | DA7219_DAC_L_EN_MASK) \
+	X(DA7219_DAC_R_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_R_RAMP_EN_MASK | DA7219_DAC_R_MUTE_EN_MASK | DA7219_DAC_R_EN_MASK) \
+	X(DA7219_HP_L_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_HP_L_AMP_MIN_GAIN_EN_MASK | DA7219_HP_L_AMP_OE_MASK | DA7219_HP_L_AMP_ZC_EN_MASK | \
+		DA7219_HP_L_AMP_RAMP_EN_MASK | DA7219_HP_L_AMP_MUTE_EN_MASK | DA7219_HP_L_AMP_EN_MASK) \
+	X(DA7219_HP_R_CTRL, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_HP_R_AMP_MIN_GAIN_EN_MASK | DA7219_HP_R_AMP_OE_MASK | DA7219_HP_R_AMP_ZC_EN_MASK | \
+		DA7219_HP_R_AMP_RAMP_EN_MASK | DA7219_HP_R_AMP_MUTE_EN_MASK | DA7219_HP_R_AMP_EN_MASK) \
+	X(DA7219_MIXOUT_L_CTRL, 0x10, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIXOUT_L_AMP_EN_MASK) \
+	X(DA7219_MIXOUT_R_CTRL, 0x10, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_MIXOUT_R_AMP_EN_MASK) \
+	X(DA7219_CHIP_ID1, 0x23, DA7219_REG_RO | DA7219_REG_DEFAULT, \
+		DA7219_CHIP_ID1_MASK) \
+	X(DA7219_CHIP_ID2, 0x93, DA7219_REG_RO | DA7219_REG_DEFAULT, \
+		DA7219_CHIP_ID2_MASK) \
+	X(DA7219_CHIP_REVISION, 0x00, DA7219_REG_RO, \
+		DA7219_CHIP_MINOR_MASK | DA7219_CHIP_MAJOR_MASK) \
+	X(DA7219_IO_CTRL, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_IO_VOLTAGE_LEVEL_MASK) \
+	X(DA7219_GAIN_RAMP_CTRL, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_GAIN_RAMP_RATE_MASK) \
+	X(DA7219_PC_COUNT, 0x02, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_PC_FREERUN_MASK | DA7219_PC_RESYNC_AUTO_MASK) \
+	X(DA7219_CP_VOL_THRESHOLD1, 0x0E, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_CP_THRESH_VDD2_MASK) \
+	X(DA7219_CP_DELAY, 0x00, DA7219_REG_RW, \
+		0) \
+	X(DA7219_DIG_CTRL, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_L_INV_MASK | DA7219_DAC_R_INV_MASK) \
+	X(DA7219_ALC_CTRL2, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_ATTACK_MASK | DA7219_ALC_RELEASE_MASK) \
+	X(DA7219_ALC_CTRL3, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_HOLD_MASK | DA7219_ALC_INTEG_ATTACK_MASK | DA7219_ALC_INTEG_RELEASE_MASK) \
+	X(DA7219_ALC_NOISE, 0x3F, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_NOISE_MASK) \
+	X(DA7219_ALC_TARGET_MIN, 0x3F, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_THRESHOLD_MIN_MASK) \
+	X(DA7219_ALC_TARGET_MAX, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_THRESHOLD_MAX_MASK) \
+	X(DA7219_ALC_GAIN_LIMITS, 0xFF, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_ATTEN_MAX_MASK | DA7219_ALC_GAIN_MAX_MASK) \
+	X(DA7219_ALC_ANA_GAIN_LIMITS, 0x71, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_ANA_GAIN_MIN_MASK | DA7219_ALC_ANA_GAIN_MAX_MASK) \
+	X(DA7219_ALC_ANTICLIP_CTRL, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_ANTICLIP_STEP_MASK | DA7219_ALC_ANTIPCLIP_EN_MASK) \
+	X(DA7219_ALC_ANTICLIP_LEVEL, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ALC_ANTICLIP_LEVEL_MASK) \
+	X(DA7219_ALC_OFFSET_AUTO_M_L, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_ALC_OFFSET_AUTO_M_L_MASK) \
+	X(DA7219_ALC_OFFSET_AUTO_U_L, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_ALC_OFFSET_AUTO_U_L_MASK) \
+	X(DA7219_DAC_NG_SETUP_TIME, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_NG_SETUP_TIME_MASK | DA7219_DAC_NG_RAMPUP_RATE_MASK | DA7219_DAC_NG_RAMPDN_RATE_MASK) \
+	X(DA7219_DAC_NG_OFF_THRESH, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_NG_OFF_THRESHOLD_MASK) \
+	X(DA7219_DAC_NG_ON_THRESH, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_NG_ON_THRESHOLD_MASK) \
+	X(DA7219_DAC_NG_CTRL, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_DAC_NG_EN_MASK) \
+	X(DA7219_TONE_GEN_CFG1, 0x00, DA7219_REG_RW | DA7219_REG_VOLATILE, \
+		DA7219_DTMF_REG_MASK | DA7219_DTMF_EN_MASK | DA7219_START_STOPN_MASK) \
+	X(DA7219_TONE_GEN_CFG2, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_SWG_SEL_MASK | DA7219_TONE_GEN_GAIN_MASK) \
+	X(DA7219_TONE_GEN_CYCLES, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_BEEP_CYCLES_MASK) \
+	X(DA7219_TONE_GEN_FREQ1_L, 0x55, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_FREQ1_L_MASK) \
+	X(DA7219_TONE_GEN_FREQ1_U, 0x15, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_FREQ1_U_MASK) \
+	X(DA7219_TONE_GEN_FREQ2_L, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_FREQ2_L_MASK) \
+	X(DA7219_TONE_GEN_FREQ2_U, 0x40, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_FREQ2_U_MASK) \
+	X(DA7219_TONE_GEN_ON_PER, 0x02, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_BEEP_ON_PER_MASK) \
+	X(DA7219_TONE_GEN_OFF_PER, 0x01, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_BEEP_OFF_PER_MASK) \
+	X(DA7219_ACCDET_STATUS_A, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_JACK_INSERTION_STS_MASK | DA7219_JACK_TYPE_STS_MASK | DA7219_JACK_PIN_ORDER_STS_MASK | \
+		DA7219_MICBIAS_UP_STS_MASK) \
+	X(DA7219_ACCDET_STATUS_B, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_BUTTON_TYPE_STS_MASK) \
+	X(DA7219_ACCDET_IRQ_EVENT_A, 0x00, DA7219_REG_RW | DA7219_REG_VOLATILE, \
+		DA7219_E_JACK_INSERTED_MASK | DA7219_E_JACK_REMOVED_MASK | DA7219_E_JACK_DETECT_COMPLETE_MASK) \
+	X(DA7219_ACCDET_IRQ_EVENT_B, 0x00, DA7219_REG_RW | DA7219_REG_VOLATILE, \
+		DA7219_E_BUTTON_A_PRESSED_MASK | DA7219_E_BUTTON_B_PRESSED_MASK | DA7219_E_BUTTON_C_PRESSED_MASK | \
+		DA7219_E_BUTTON_D_PRESSED_MASK | DA7219_E_BUTTON_D_RELEASED_MASK | DA7219_E_BUTTON_C_RELEASED_MASK | \
+		DA7219_E_BUTTON_B_RELEASED_MASK | DA7219_E_BUTTON_A_RELEASED_MASK) \
+	X(DA7219_ACCDET_IRQ_MASK_A, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_M_JACK_INSERTED_MASK | DA7219_M_JACK_REMOVED_MASK | DA7219_M_JACK_DETECT_COMPLETE_MASK) \
+	X(DA7219_ACCDET_IRQ_MASK_B, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_M_BUTTON_A_PRESSED_MASK | DA7219_M_BUTTON_B_PRESSED_MASK | DA7219_M_BUTTON_C_PRESSED_MASK | \
+		DA7219_M_BUTTON_D_PRESSED_MASK | DA7219_M_BUTTON_D_RELEASED_MASK | DA7219_M_BUTTON_C_RELEASED_MASK | \
+		DA7219_M_BUTTON_B_RELEASED_MASK | DA7219_M_BUTTON_A_RELEASED_MASK) \
+	X(DA7219_ACCDET_CONFIG_1, 0xD6, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ACCDET_EN_MASK | DA7219_BUTTON_CONFIG_MASK | DA7219_MIC_DET_THRESH_MASK | \
+		DA7219_JACK_TYPE_DET_EN_MASK | DA7219_PIN_ORDER_DET_EN_MASK) \
+	X(DA7219_ACCDET_CONFIG_2, 0x34, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_ACCDET_PAUSE_MASK | DA7219_JACKDET_DEBOUNCE_MASK | DA7219_JACK_DETECT_RATE_MASK | \
+		DA7219_JACKDET_REM_DEB_MASK) \
+	X(DA7219_ACCDET_CONFIG_3, 0x0A, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_A_D_BUTTON_THRESH_MASK) \
+	X(DA7219_ACCDET_CONFIG_4, 0x16, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_D_B_BUTTON_THRESH_MASK) \
+	X(DA7219_ACCDET_CONFIG_5, 0x21, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_B_C_BUTTON_THRESH_MASK) \
+	X(DA7219_ACCDET_CONFIG_6, 0x3E, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_C_MIC_BUTTON_THRESH_MASK) \
+	X(DA7219_ACCDET_CONFIG_7, 0x01, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_BUTTON_AVERAGE_MASK | DA7219_ADC_1_BIT_REPEAT_MASK | DA7219_PIN_ORDER_FORCE_MASK | \
+		DA7219_JACK_TYPE_FORCE_MASK) \
+	X(DA7219_ACCDET_CONFIG_8, 0x00, DA7219_REG_RW | DA7219_REG_VOLATILE, \
+		DA7219_HPTEST_EN_MASK | DA7219_HPTEST_RES_SEL_MASK | DA7219_HPTEST_COMP_MASK) \
+	X(DA7219_SYSTEM_STATUS, 0x00, DA7219_REG_RO | DA7219_REG_VOLATILE, \
+		DA7219_SC1_BUSY_MASK | DA7219_SC2_BUSY_MASK) \
+	X(DA7219_SYSTEM_ACTIVE, 0x00, DA7219_REG_RW | DA7219_REG_DEFAULT, \
+		DA7219_SYSTEM_ACTIVE_MASK)
+
+#endif
@@ -0,0 +1,142 @@
+#include "ring.h"
+
+#if defined(DA7219_HOST_BUILD)
+
+#define ReadNoFence(Source) __atomic_load_n((Source), __ATOMIC_RELAXED)
+#define ReadAcquire(Source) __atomic_load_n((Source), __ATOMIC_ACQUIRE)
+#define WriteRelease(Destination, Value) __atomic_store_n((Destination), (Value), __ATOMIC_RELEASE)
+#define InterlockedIncrement(Addend) __sync_add_and_fetch((Addend), 1)
+#define InterlockedCompareExchange(Destination, Exchange, Comparand) \
+	__sync_val_compare_and_swap((Destination), (Comparand), (Exchange))
+
+#endif
+
+VOID
+Da7219ReportRingInit(
+	IN PDA7219_REPORT_RING Ring
+)
+{
+	RtlZeroMemory(Ring, sizeof(*Ring));
+
+	for (LONG i = 0; i < DA7219_REPORT_RING_SIZE; i++)
+	{
+		Ring->Slots[i].Sequence = i;
+	}
+}
+
+BOOLEAN
+Da7219ReportRingPush(
+	IN PDA7219_REPORT_RING Ring,
+	IN PVOID Report,
+	IN ULONG Length,
+	IN UCHAR LatencyEvent,
+	IN uint64_t Timestamp
+)
+{
+	PDA7219_REPORT_SLOT slot;
+	LONG pos;
+	LONG diff;
+
+	if (Length > DA7219_REPORT_MAX_LENGTH)
+	{
+		return FALSE;
+	}
+
+	//
+	// Each slot's sequence says whose turn it is, a producer may only
+	// claim it once the consumer of the previous lap has released it
+	//
+
+	pos = ReadNoFence(&Ring->Head);
+	for (;;)
+	{
+		slot = &Ring->Slots[pos & (DA7219_REPORT_RING_SIZE - 1)];
+		diff = (LONG)((ULONG)ReadAcquire(&slot->Sequence) - (ULONG)pos);
+
+		if (diff == 0)
+		{
+			LONG prev = InterlockedCompareExchange(&Ring->Head, (LONG)((ULONG)pos + 1), pos);
+			if (prev == pos)
+			{
+				break;
+			}
+			pos = prev;
+		}
+		else if (diff < 0)
+		{
+			InterlockedIncrement(&Ring->Overflows);
+			return FALSE;
+		}
+		else
+		{
+			pos = ReadNoFence(&Ring->Head);
+		}
+	}
+
+	slot->Length = Length;
+	RtlCopyMemory(slot->Data, Report, Length);
+	slot->LatencyEvent = LatencyEvent;
+	slot->Timestamp = Timestamp;
+	WriteRelease(&slot->Sequence, (LONG)((ULONG)pos + 1));
+
+	InterlockedIncrement(&Ring->Queued);
+	return TRUE;
+}
+
+BOOLEAN
+Da7219ReportRingPop(
+	IN PDA7219_REPORT_RING Ring,
+	OUT PVOID Report,
+	OUT PULONG Length,
+	OUT PUCHAR LatencyEvent,
+	OUT uint64_t* Timestamp
+)
+{
+	PDA7219_REPORT_SLOT slot;
+	LONG pos;
+	LONG diff;
+
+	pos = ReadNoFence(&Ring->Tail);
+	for (;;)
+	{
+		slot = &Ring->Slots[pos & (DA7219_REPORT_RING_SIZE - 1)];
+		diff = (LONG)((ULONG)ReadAcquire(&slot->Sequence) - ((ULONG)pos + 1));
+
+		if (diff == 0)
+		{
+			LONG prev = InterlockedCompareExchange(&Ring->Tail, (LONG)((ULONG)pos + 1), pos);
+			if (prev == pos)
+			{
+				break;
+			}
+			pos = prev;
+		}
+		else if (diff < 0)
+		{
+			return FALSE;
+		}
+		else
+		{
+			pos = ReadNoFence(&Ring->Tail);
+		}
+	}
+
+	*Length = slot->Length;
+	RtlCopyMemory(Report, slot->Data, slot->Length);
+	*LatencyEvent = slot->LatencyEvent;
+	*Timestamp = slot->Timestamp;
+	WriteRelease(&slot->Sequence, (LONG)((ULONG)pos + DA7219_REPORT_RING_SIZE));
+
+	return TRUE;
+}
+
+BOOLEAN
+Da7219ReportRingReady(
+	IN PDA7219_REPORT_RING Ring
+)
+{
+	LONG pos = ReadNoFence(&Ring->Tail);
+	PDA7219_REPORT_SLOT slot = &Ring->Slots[pos & (DA7219_REPORT_RING_SIZE - 1)];
+
+	return ReadAcquire(&slot->Sequence) == (LONG)((ULONG)pos + 1);
+}
@@ -0,0 +1,75 @@
+#if !defined(_DA7219_RING_H_)
+#define _DA7219_RING_H_
+
+//
+// Pending HID input reports, filled by the interrupt handler and drained
+// as IOCTL_HID_READ_REPORT requests arrive. Bounded MPMC ring: producers
+// and consumers claim slots with a compare exchange on Head or Tail, and
+// each slot's Sequence hands it between them. No locks and no allocation,
+// so it also builds on the host for the stress test.
+//
+
+#include "codec.h"
+
+#define DA7219_REPORT_RING_SIZE     32
+#define DA7219_REPORT_MAX_LENGTH    8
+
+C_ASSERT((DA7219_REPORT_RING_SIZE & (DA7219_REPORT_RING_SIZE - 1)) == 0);
+
+typedef struct _DA7219_REPORT_SLOT
+{
+	volatile LONG Sequence;
+
+	ULONG Length;
+
+	UCHAR Data[DA7219_REPORT_MAX_LENGTH];
+
+	UCHAR LatencyEvent; // DA7219_LATENCY_EVENT the report was raised for
+
+	uint64_t Timestamp; // ISR entry in microseconds
+
+} DA7219_REPORT_SLOT, *PDA7219_REPORT_SLOT;
+
+typedef struct _DA7219_REPORT_RING
+{
+	volatile LONG Head;
+
+	volatile LONG Tail;
+
+	volatile LONG Queued;
+
+	volatile LONG Overflows; // reports dropped because the ring was full
+
+	DA7219_REPORT_SLOT Slots[DA7219_REPORT_RING_SIZE];
+
+} DA7219_REPORT_RING, *PDA7219_REPORT_RING;
+
+VOID
+Da7219ReportRingInit(
+	IN PDA7219_REPORT_RING Ring
+);
+
+BOOLEAN
+Da7219ReportRingPush(
+	IN PDA7219_REPORT_RING Ring,
+	IN PVOID Report,
+	IN ULONG Length,
+	IN UCHAR LatencyEvent,
+	IN uint64_t Timestamp
+);
+
+BOOLEAN
+Da7219ReportRingPop(
+	IN PDA7219_REPORT_RING Ring,
+	OUT PVOID Report,
+	OUT PULONG Length,
+	OUT PUCHAR LatencyEvent,
+	OUT uint64_t* Timestamp
+);
+
+BOOLEAN
+Da7219ReportRingReady(
+	IN PDA7219_REPORT_RING Ring
+);
+
+#endif
@@ -21,10 +21,189 @@ Revision History:
 #include "da7219.h"
 #include "spb.h"
 #include <reshub.h>
+#include <spb.h>
 
 static ULONG Da7219DebugLevel = 100;
 static ULONG Da7219DebugCatagories = DBG_INIT || DBG_PNP || DBG_IOCTL;
 
+//
+// Per-request state for the preallocated asynchronous request pool
+//
+
+typedef struct _SPB_REQUEST_CONTEXT
+{
+	SPB_CONTEXT* SpbContext;
+	ULONG Index;
+	WDFMEMORY Memory;
+	PFN_SPB_TRANSFER_COMPLETE Completion;
+	PVOID CompletionContext;
+	UCHAR Buffer[SPB_MAX_TRANSFER_SIZE];
+} SPB_REQUEST_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(SPB_REQUEST_CONTEXT, GetSpbRequestContext)
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE SpbEvtRequestCompletion;
+
+static VOID
+SpbUpdateMax(
+	IN LONG64* Max,
+	IN LONG64 Value
+)
+{
+	LONG64 current = ReadNoFence64(Max);
+
+	while (Value > current)
+	{
+		LONG64 prev = InterlockedCompareExchange64(Max, Value, current);
+		if (prev == current)
+		{
+			break;
+		}
+		current = prev;
+	}
+}
+
+static VOID
+SpbCountFailure(
+	IN SPB_CONTEXT* SpbContext,
+	IN NTSTATUS Status
+)
+{
+	SPB_STATISTICS* stats = &SpbContext->Stats;
+	ULONG i;
+
+	for (i = 0; i < SPB_STATUS_SLOTS - 1; i++)
+	{
+		NTSTATUS slot = (NTSTATUS)ReadNoFence((LONG*)&stats->FailureStatus[i]);
+
+		if (slot == 0)
+		{
+			slot = (NTSTATUS)InterlockedCompareExchange((LONG*)&stats->FailureStatus[i], Status, 0);
+			if (slot == 0)
+			{
+				break;
+			}
+		}
+
+		if (slot == Status)
+		{
+			break;
+		}
+	}
+
+	InterlockedIncrement(&stats->FailureCount[i]);
+}
+
+static VOID
+SpbCountTransfer(
+	IN SPB_CONTEXT* SpbContext,
+	IN ULONG Direction,
+	IN ULONG WriteLength,
+	IN ULONG ReadLength,
+	IN NTSTATUS Status
+)
+{
+	SPB_STATISTICS* stats = &SpbContext->Stats;
+
+	InterlockedIncrement(&stats->Transactions[Direction]);
+	InterlockedAdd64(&stats->Bytes[SPB_STATS_WRITE], WriteLength);
+	InterlockedAdd64(&stats->Bytes[SPB_STATS_READ], ReadLength);
+
+	if (!NT_SUCCESS(Status))
+	{
+		SpbCountFailure(SpbContext, Status);
+	}
+}
+
+static VOID
+SpbCapture(
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Direction,
+	IN PVOID Address OPTIONAL,
+	IN ULONG AddressLength,
+	IN PVOID Data,
+	IN ULONG Length,
+	IN NTSTATUS Status
+)
+{
+	SPB_CAPTURE* capture = &SpbContext->Capture;
+	SPB_CAPTURE_RECORD* record;
+	ULONG recordLength;
+	LONG offset;
+
+	if (!ReadNoFence(&capture->Enabled))
+	{
+		return;
+	}
+
+	recordLength = (sizeof(SPB_CAPTURE_RECORD) + Length + 7) & ~7;
+	offset = InterlockedAdd(&capture->Used, (LONG)recordLength) - (LONG)recordLength;
+
+	if ((ULONG)offset + recordLength > SPB_CAPTURE_SIZE)
+	{
+		InterlockedIncrement(&capture->Dropped);
+		return;
+	}
+
+	record = (SPB_CAPTURE_RECORD*)&capture->Buffer[offset];
+	record->Direction = Direction;
+	record->Register = (Address != NULL && AddressLength > 0) ? *(PUCHAR)Address : 0;
+	record->Status = Status;
+	record->Timestamp = KeQueryPerformanceCounter(NULL).QuadPart;
+	record->DataLength = (USHORT)Length;
+	RtlCopyMemory(record + 1, Data, Length);
+
+	WriteRelease16((SHORT*)&record->Length, (SHORT)recordLength);
+}
+
+//
+// SpbLock with contention accounting, returns the acquisition time for SpbReleaseLock
+//
+
+static LONG64
+SpbAcquireLock(
+	IN SPB_CONTEXT* SpbContext
+)
+{
+	SPB_STATISTICS* stats = &SpbContext->Stats;
+	LARGE_INTEGER timeout;
+	LONG64 start;
+	LONG64 acquired;
+
+	InterlockedIncrement(&stats->LockAcquisitions);
+
+	timeout.QuadPart = 0;
+	if (WdfWaitLockAcquire(SpbContext->SpbLock, &timeout) != STATUS_TIMEOUT)
+	{
+		return KeQueryPerformanceCounter(NULL).QuadPart;
+	}
+
+	start = KeQueryPerformanceCounter(NULL).QuadPart;
+	WdfWaitLockAcquire(SpbContext->SpbLock, NULL);
+	acquired = KeQueryPerformanceCounter(NULL).QuadPart;
+
+	InterlockedIncrement(&stats->LockContentions);
+	InterlockedAdd64(&stats->LockWaitTicks, acquired - start);
+	SpbUpdateMax(&stats->LockWaitMaxTicks, acquired - start);
+
+	return acquired;
+}
+
+static VOID
+SpbReleaseLock(
+	IN SPB_CONTEXT* SpbContext,
+	IN LONG64 Acquired
+)
+{
+	SPB_STATISTICS* stats = &SpbContext->Stats;
+	LONG64 held = KeQueryPerformanceCounter(NULL).QuadPart - Acquired;
+
+	WdfWaitLockRelease(SpbContext->SpbLock);
+
+	InterlockedAdd64(&stats->LockHeldTicks, held);
+	SpbUpdateMax(&stats->LockHeldMaxTicks, held);
+}
+
 NTSTATUS
 SpbDoWriteDataSynchronously(
 	IN SPB_CONTEXT* SpbContext,
@@ -36,73 +215,551 @@ SpbDoWriteDataSynchronously(
 Routine Description:
 
 This helper routine abstracts creating and sending an I/O
-request (I2C Write) to the Spb I/O target.
+request (I2C Write) to the Spb I/O target. The caller's buffer
+is described to the target directly, so it must be nonpaged.
 
 Arguments:
 
 SpbContext - Pointer to the current device context
-Address    - The I2C register address to write to
+Data       - The data to write
+Length     - The amount of data to write
+
+Return Value:
+
+NTSTATUS Status indicating success or failure
+
+--*/
+{
+	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	NTSTATUS status;
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&memoryDescriptor,
+		Data,
+		Length);
+
+	status = WdfIoTargetSendWriteSynchronously(
+		SpbContext->SpbIoTarget,
+		NULL,
+		&memoryDescriptor,
+		NULL,
+		NULL,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		Da7219Print(
+			DEBUG_LEVEL_ERROR,
+			DBG_IOCTL,
+			"Error writing to Spb - %!STATUS!",
+			status);
+	}
+
+	return status;
+}
+
+NTSTATUS
+SpbWriteDataSynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+Routine Description:
+
+This routine abstracts creating and sending an I/O
+request (I2C Write) to the Spb I/O target and utilizes
+a helper routine to do work inside of locked code.
+
+Arguments:
+
+SpbContext - Pointer to the current device context
+Data       - The nonpaged data to write
+Length     - The amount of data to write
+
+Return Value:
+
+NTSTATUS Status indicating success or failure
+
+--*/
+{
+	NTSTATUS status;
+	LONG64 acquired;
+
+	acquired = SpbAcquireLock(SpbContext);
+
+	status = SpbDoWriteDataSynchronously(
+		SpbContext,
+		Data,
+		Length);
+
+	SpbCapture(SpbContext, SPB_CAPTURE_WRITE, NULL, 0, Data, Length, status);
+
+	SpbReleaseLock(SpbContext, acquired);
+
+	SpbCountTransfer(SpbContext, SPB_STATS_WRITE, Length, 0, status);
+
+	return status;
+}
+
+NTSTATUS
+SpbWriteRegisterSynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN PVOID Address,
+	IN ULONG AddressLength,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+Routine Description:
+
+This routine writes a register address followed by data as a
+single I2C Write. The two caller buffers are gathered by the
+controller from a buffer list, so neither is copied or needs to
+be contiguous with the other.
+
+Arguments:
+
+SpbContext    - Pointer to the current device context
+Address       - The nonpaged register address to write first
+AddressLength - The length of the register address
+Data          - The nonpaged data to write after the address
+Length        - The amount of data to write
+
+Return Value:
+
+NTSTATUS Status indicating success or failure
+
+--*/
+{
+	SPB_TRANSFER_BUFFER_LIST_ENTRY buffers[2];
+	SPB_TRANSFER_LIST_AND_ENTRIES(1) sequence;
+	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	ULONG_PTR bytesTransferred;
+	NTSTATUS status;
+	LONG64 acquired;
+
+	buffers[0].Buffer = Address;
+	buffers[0].BufferCb = AddressLength;
+	buffers[1].Buffer = Data;
+	buffers[1].BufferCb = Length;
+
+	SPB_TRANSFER_LIST_INIT(&(sequence.List), 1);
+
+	sequence.List.Transfers[0] = SPB_TRANSFER_LIST_ENTRY_INIT_BUFFER_LIST(
+		SpbTransferDirectionToDevice,
+		0,
+		buffers,
+		ARRAYSIZE(buffers));
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&memoryDescriptor,
+		(PVOID)&sequence,
+		sizeof(sequence));
+
+	bytesTransferred = 0;
+
+	acquired = SpbAcquireLock(SpbContext);
+
+	status = WdfIoTargetSendIoctlSynchronously(
+		SpbContext->SpbIoTarget,
+		NULL,
+		IOCTL_SPB_EXECUTE_SEQUENCE,
+		&memoryDescriptor,
+		NULL,
+		NULL,
+		&bytesTransferred);
+
+	SpbCapture(SpbContext, SPB_CAPTURE_WRITE, Address, AddressLength, Data, Length, status);
+
+	SpbReleaseLock(SpbContext, acquired);
+
+	if (NT_SUCCESS(status) &&
+		bytesTransferred != AddressLength + Length)
+	{
+		status = STATUS_DEVICE_PROTOCOL_ERROR;
+	}
+
+	SpbCountTransfer(SpbContext, SPB_STATS_WRITE, AddressLength + Length, 0, status);
+
+	if (!NT_SUCCESS(status))
+	{
+		Da7219Print(
+			DEBUG_LEVEL_ERROR,
+			DBG_IOCTL,
+			"Error writing register to Spb - %!STATUS!",
+			status);
+	}
+
+	return status;
+}
+
+NTSTATUS
+SpbXferDataSynchronously(
+	_In_ SPB_CONTEXT* SpbContext,
+	_In_ PVOID SendData,
+	_In_ ULONG SendLength,
+	_In_reads_bytes_(Length) PVOID Data,
+	_In_ ULONG Length
+)
+/*++
+Routine Description:
+This helper routine abstracts creating and sending an I/O
+request (I2C Write followed by an I2C Read) to the Spb I/O target.
+Both halves are issued as a single IOCTL_SPB_EXECUTE_SEQUENCE so the
+controller joins them with a repeated start instead of two separate
+bus transactions. The caller's buffers are described directly and
+must be nonpaged.
+Arguments:
+SpbContext - Pointer to the current device context
+SendData   - The register address pointer to write before reading
+SendLength - The length of the address pointer
 Data       - A buffer to receive the data at at the above address
 Length     - The amount of data to be read from the above address
+Return Value:
+NTSTATUS Status indicating success or failure
+--*/
+{
+	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	SPB_TRANSFER_LIST_AND_ENTRIES(2) sequence;
+	NTSTATUS status;
+	ULONG_PTR bytesTransferred;
+	LONG64 acquired;
+
+	bytesTransferred = 0;
+
+	//
+	// Xfer transactions write an address pointer and then read back
+	// from it, both inside one sequence
+	//
+	SPB_TRANSFER_LIST_INIT(&(sequence.List), 2);
+
+	sequence.List.Transfers[0] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+		SpbTransferDirectionToDevice,
+		0,
+		SendData,
+		SendLength);
+
+	sequence.List.Transfers[1] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+		SpbTransferDirectionFromDevice,
+		0,
+		Data,
+		Length);
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&memoryDescriptor,
+		(PVOID)&sequence,
+		sizeof(sequence));
+
+	acquired = SpbAcquireLock(SpbContext);
+
+	status = WdfIoTargetSendIoctlSynchronously(
+		SpbContext->SpbIoTarget,
+		NULL,
+		IOCTL_SPB_EXECUTE_SEQUENCE,
+		&memoryDescriptor,
+		NULL,
+		NULL,
+		&bytesTransferred);
+
+	SpbCapture(SpbContext, SPB_CAPTURE_READ, SendData, SendLength, Data, Length, status);
+
+	SpbReleaseLock(SpbContext, acquired);
+
+	if (NT_SUCCESS(status) &&
+		bytesTransferred != SendLength + Length)
+	{
+		status = STATUS_DEVICE_PROTOCOL_ERROR;
+	}
+
+	SpbCountTransfer(SpbContext, SPB_STATS_READ, SendLength, Length, status);
+
+	if (!NT_SUCCESS(status))
+	{
+		Da7219Print(
+			DEBUG_LEVEL_ERROR,
+			DBG_IOCTL,
+			"Error executing Spb write-read sequence - %!STATUS!",
+			status);
+	}
+
+	return status;
+}
+
+NTSTATUS
+SpbReadRegistersSynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Addresses,
+	IN PVOID* Buffers,
+	IN PULONG Lengths,
+	IN ULONG Count
+)
+/*++
+
+Routine Description:
+
+This routine reads several unrelated register ranges in one
+IOCTL_SPB_EXECUTE_SEQUENCE. Each range is a one byte address write
+followed by a read, joined to the next by a repeated start, so the
+whole set costs a single bus transaction.
+
+Arguments:
+
+SpbContext - Pointer to the current device context
+Addresses  - Nonpaged array of Count register addresses
+Buffers    - Nonpaged buffers receiving each range
+Lengths    - Number of bytes to read for each range
+Count      - Number of ranges, at most SPB_MAX_READ_RANGES
+
+Return Value:
+
+NTSTATUS Status indicating success or failure
+
+--*/
+{
+	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	SPB_TRANSFER_LIST_AND_ENTRIES(2 * SPB_MAX_READ_RANGES) sequence;
+	ULONG_PTR bytesTransferred;
+	ULONG expected;
+	NTSTATUS status;
+	LONG64 acquired;
+
+	if (Count == 0 || Count > SPB_MAX_READ_RANGES)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	SPB_TRANSFER_LIST_INIT(&(sequence.List), 2 * Count);
+
+	expected = 0;
+	for (ULONG i = 0; i < Count; i++)
+	{
+		sequence.List.Transfers[2 * i] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+			SpbTransferDirectionToDevice,
+			0,
+			&Addresses[i],
+			sizeof(UCHAR));
+
+		sequence.List.Transfers[2 * i + 1] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+			SpbTransferDirectionFromDevice,
+			0,
+			Buffers[i],
+			Lengths[i]);
+
+		expected += sizeof(UCHAR) + Lengths[i];
+	}
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&memoryDescriptor,
+		(PVOID)&sequence,
+		FIELD_OFFSET(SPB_TRANSFER_LIST, Transfers[2 * Count]));
+
+	bytesTransferred = 0;
+
+	acquired = SpbAcquireLock(SpbContext);
+
+	status = WdfIoTargetSendIoctlSynchronously(
+		SpbContext->SpbIoTarget,
+		NULL,
+		IOCTL_SPB_EXECUTE_SEQUENCE,
+		&memoryDescriptor,
+		NULL,
+		NULL,
+		&bytesTransferred);
+
+	for (ULONG i = 0; i < Count; i++)
+	{
+		SpbCapture(SpbContext, SPB_CAPTURE_READ, &Addresses[i], sizeof(UCHAR), Buffers[i], Lengths[i], status);
+	}
+
+	SpbReleaseLock(SpbContext, acquired);
+
+	if (NT_SUCCESS(status) &&
+		bytesTransferred != expected)
+	{
+		status = STATUS_DEVICE_PROTOCOL_ERROR;
+	}
+
+	SpbCountTransfer(SpbContext, SPB_STATS_READ, Count, expected - Count, status);
+
+	if (!NT_SUCCESS(status))
+	{
+		Da7219Print(
+			DEBUG_LEVEL_ERROR,
+			DBG_IOCTL,
+			"Error executing Spb multi-range read sequence - %!STATUS!",
+			status);
+	}
+
+	return status;
+}
+
+static LONG
+SpbAcquireRequest(
+	IN SPB_CONTEXT* SpbContext
+)
+{
+	LONG freeRequests;
+	ULONG index;
+
+	do
+	{
+		freeRequests = SpbContext->FreeRequests;
+
+		if (!_BitScanForward(&index, (ULONG)freeRequests))
+		{
+			return -1;
+		}
+	} while (InterlockedCompareExchange(
+		&SpbContext->FreeRequests,
+		freeRequests & ~(1 << index),
+		freeRequests) != freeRequests);
+
+	return (LONG)index;
+}
+
+static VOID
+SpbFinishRequest(
+	IN WDFREQUEST Request,
+	IN NTSTATUS Status
+)
+{
+	SPB_REQUEST_CONTEXT* requestContext = GetSpbRequestContext(Request);
+	SPB_CONTEXT* spbContext = requestContext->SpbContext;
+	PFN_SPB_TRANSFER_COMPLETE completion = requestContext->Completion;
+	PVOID completionContext = requestContext->CompletionContext;
+	WDF_REQUEST_REUSE_PARAMS reuseParams;
+
+	if (!NT_SUCCESS(Status))
+	{
+		InterlockedCompareExchange(
+			(LONG*)&spbContext->AsyncStatus,
+			Status,
+			STATUS_SUCCESS);
+
+		SpbCountFailure(spbContext, Status);
+	}
+
+	WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+	WdfRequestReuse(Request, &reuseParams);
+
+	InterlockedOr(&spbContext->FreeRequests, 1 << requestContext->Index);
+
+	if (completion != NULL)
+	{
+		completion(completionContext, Status);
+	}
+
+	InterlockedDecrement(&spbContext->OutstandingRequests);
+	KeSetEvent(&spbContext->RequestCompleted, IO_NO_INCREMENT, FALSE);
+}
+
+VOID
+SpbEvtRequestCompletion(
+	IN WDFREQUEST Request,
+	IN WDFIOTARGET Target,
+	IN PWDF_REQUEST_COMPLETION_PARAMS Params,
+	IN WDFCONTEXT Context
+)
+{
+	UNREFERENCED_PARAMETER(Target);
+	UNREFERENCED_PARAMETER(Context);
+
+	SpbFinishRequest(Request, Params->IoStatus.Status);
+}
+
+NTSTATUS
+SpbWriteRegisterAsynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN PVOID Address,
+	IN ULONG AddressLength,
+	IN PVOID Data,
+	IN ULONG Length,
+	IN PFN_SPB_TRANSFER_COMPLETE Completion OPTIONAL,
+	IN PVOID CompletionContext OPTIONAL
+)
+/*++
+
+Routine Description:
+
+This routine queues a register address followed by data as one I2C
+Write to the Spb I/O target, using a request from the preallocated
+pool, and returns without waiting for it. Requests
+are processed by the target in submission order, so writes queued here
+are always on the bus before any later transfer.
+
+Arguments:
+
+SpbContext        - Pointer to the current device context
+Address           - The register address, copied before returning
+AddressLength     - The length of the register address
+Data              - The data to write, copied before returning
+Length            - The amount of data to write
+Completion        - Optional routine called once the write finishes
+CompletionContext - Context passed to Completion
 
 Return Value:
 
-NTSTATUS Status indicating success or failure
+STATUS_PENDING if the write was queued, otherwise the status of a
+synchronous fallback write when the pool is exhausted or the
+transfer is larger than SPB_MAX_TRANSFER_SIZE
 
 --*/
 {
-	PUCHAR buffer;
-	ULONG length;
-	WDFMEMORY memory;
-	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	WDFREQUEST request;
+	SPB_REQUEST_CONTEXT* requestContext;
+	WDFMEMORY_OFFSET memoryOffset;
+	LONG index;
 	NTSTATUS status;
 
-	length = Length;
-	memory = NULL;
+	index = -1;
 
-	if (length > DEFAULT_SPB_BUFFER_SIZE)
+	if (AddressLength + Length <= SPB_MAX_TRANSFER_SIZE)
 	{
-		status = WdfMemoryCreate(
-			WDF_NO_OBJECT_ATTRIBUTES,
-			NonPagedPool,
-			DA7219_POOL_TAG,
-			length,
-			&memory,
-			(PVOID*)&buffer);
+		index = SpbAcquireRequest(SpbContext);
+	}
 
-		if (!NT_SUCCESS(status))
+	if (index < 0)
+	{
+		status = SpbWriteRegisterSynchronously(
+			SpbContext,
+			Address,
+			AddressLength,
+			Data,
+			Length);
+
+		if (Completion != NULL)
 		{
-			Da7219Print(
-				DEBUG_LEVEL_ERROR,
-				DBG_IOCTL,
-				"Error allocating memory for Spb write - %!STATUS!",
-				status);
-			goto exit;
+			Completion(CompletionContext, status);
 		}
 
-		WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(
-			&memoryDescriptor,
-			memory,
-			NULL);
+		return status;
 	}
-	else
-	{
-		buffer = (PUCHAR)WdfMemoryGetBuffer(SpbContext->WriteMemory, NULL);
 
-		WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
-			&memoryDescriptor,
-			(PVOID)buffer,
-			length);
-	}
+	request = SpbContext->Requests[index];
+	requestContext = GetSpbRequestContext(request);
+	requestContext->Completion = Completion;
+	requestContext->CompletionContext = CompletionContext;
 
-	RtlCopyMemory(buffer, Data, length);
+	RtlCopyMemory(requestContext->Buffer, Address, AddressLength);
+	RtlCopyMemory(&requestContext->Buffer[AddressLength], Data, Length);
 
-	status = WdfIoTargetSendWriteSynchronously(
+	memoryOffset.BufferOffset = 0;
+	memoryOffset.BufferLength = AddressLength + Length;
+
+	InterlockedIncrement(&SpbContext->OutstandingRequests);
+
+	InterlockedIncrement(&SpbContext->Stats.AsyncTransactions);
+	SpbCountTransfer(SpbContext, SPB_STATS_WRITE, AddressLength + Length, 0, STATUS_SUCCESS);
+	SpbCapture(SpbContext, SPB_CAPTURE_WRITE | SPB_CAPTURE_ASYNC, Address, AddressLength, Data, Length, STATUS_PENDING);
+
+	status = WdfIoTargetFormatRequestForWrite(
 		SpbContext->SpbIoTarget,
-		NULL,
-		&memoryDescriptor,
-		NULL,
-		NULL,
+		request,
+		requestContext->Memory,
+		&memoryOffset,
 		NULL);
 
 	if (!NT_SUCCESS(status))
@@ -110,182 +767,244 @@ NTSTATUS Status indicating success or failure
 		Da7219Print(
 			DEBUG_LEVEL_ERROR,
 			DBG_IOCTL,
-			"Error writing to Spb - %!STATUS!",
+			"Error formatting asynchronous Spb write - %!STATUS!",
 			status);
-		goto exit;
+
+		SpbFinishRequest(request, status);
+		return status;
 	}
 
-exit:
+	WdfRequestSetCompletionRoutine(
+		request,
+		SpbEvtRequestCompletion,
+		requestContext);
 
-	if (NULL != memory)
+	if (!WdfRequestSend(request, SpbContext->SpbIoTarget, WDF_NO_SEND_OPTIONS))
 	{
-		WdfObjectDelete(memory);
+		status = WdfRequestGetStatus(request);
+
+		Da7219Print(
+			DEBUG_LEVEL_ERROR,
+			DBG_IOCTL,
+			"Error sending asynchronous Spb write - %!STATUS!",
+			status);
+
+		SpbFinishRequest(request, status);
+		return status;
 	}
 
-	return status;
+	return STATUS_PENDING;
 }
 
 NTSTATUS
-SpbWriteDataSynchronously(
-	IN SPB_CONTEXT* SpbContext,
-	IN PVOID Data,
-	IN ULONG Length
+SpbWaitForIdle(
+	IN SPB_CONTEXT* SpbContext
 )
 /*++
 
 Routine Description:
 
-This routine abstracts creating and sending an I/O
-request (I2C Write) to the Spb I/O target and utilizes
-a helper routine to do work inside of locked code.
+This routine waits for every asynchronous transfer queued so far to
+complete.
 
 Arguments:
 
 SpbContext - Pointer to the current device context
-Address    - The I2C register address to write to
-Data       - A buffer to receive the data at at the above address
-Length     - The amount of data to be read from the above address
 
 Return Value:
 
-NTSTATUS Status indicating success or failure
+The first failure reported by an asynchronous transfer since the last
+call, or STATUS_SUCCESS
 
 --*/
 {
-	NTSTATUS status;
-
-	WdfWaitLockAcquire(SpbContext->SpbLock, NULL);
-
-	status = SpbDoWriteDataSynchronously(
-		SpbContext,
-		Data,
-		Length);
-
-	WdfWaitLockRelease(SpbContext->SpbLock);
+	while (InterlockedCompareExchange(&SpbContext->OutstandingRequests, 0, 0) != 0)
+	{
+		KeWaitForSingleObject(
+			&SpbContext->RequestCompleted,
+			Executive,
+			KernelMode,
+			FALSE,
+			NULL);
+	}
 
-	return status;
+	return (NTSTATUS)InterlockedExchange((LONG*)&SpbContext->AsyncStatus, STATUS_SUCCESS);
 }
 
-NTSTATUS
-SpbXferDataSynchronously(
-	_In_ SPB_CONTEXT* SpbContext,
-	_In_ PVOID SendData,
-	_In_ ULONG SendLength,
-	_In_reads_bytes_(Length) PVOID Data,
-	_In_ ULONG Length
+VOID
+SpbGetStatistics(
+	IN SPB_CONTEXT* SpbContext,
+	OUT SPB_STATISTICS* Snapshot,
+	IN BOOLEAN Reset
 )
 /*++
+
 Routine Description:
-This helper routine abstracts creating and sending an I/O
-request (I2C Read) to the Spb I/O target.
+
+This routine copies the lock and bus counters without taking SpbLock.
+Each counter is read atomically, but not all of them at the same instant.
+
 Arguments:
+
 SpbContext - Pointer to the current device context
-Address    - The I2C register address to read from
-Data       - A buffer to receive the data at at the above address
-Length     - The amount of data to be read from the above address
+Snapshot   - Receives the counters
+Reset      - Zero each counter as it is read
+
 Return Value:
-NTSTATUS Status indicating success or failure
---*/
-{
-	PUCHAR buffer;
-	WDFMEMORY memory;
-	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
-	NTSTATUS status;
-	ULONG_PTR bytesRead;
 
-	WdfWaitLockAcquire(SpbContext->SpbLock, NULL);
+None
 
-	memory = NULL;
-	status = STATUS_INVALID_PARAMETER;
-	bytesRead = 0;
+--*/
+{
+	SPB_STATISTICS* stats = &SpbContext->Stats;
+	LARGE_INTEGER frequency;
+
+#define SPB_READ_STAT(Field) \
+	(Reset ? InterlockedExchange(&stats->Field, 0) : ReadNoFence(&stats->Field))
+#define SPB_READ_STAT64(Field) \
+	(Reset ? InterlockedExchange64(&stats->Field, 0) : ReadNoFence64(&stats->Field))
+
+	KeQueryPerformanceCounter(&frequency);
+	Snapshot->Frequency = frequency.QuadPart;
+
+	Snapshot->LockAcquisitions = SPB_READ_STAT(LockAcquisitions);
+	Snapshot->LockContentions = SPB_READ_STAT(LockContentions);
+	Snapshot->LockWaitTicks = SPB_READ_STAT64(LockWaitTicks);
+	Snapshot->LockWaitMaxTicks = SPB_READ_STAT64(LockWaitMaxTicks);
+	Snapshot->LockHeldTicks = SPB_READ_STAT64(LockHeldTicks);
+	Snapshot->LockHeldMaxTicks = SPB_READ_STAT64(LockHeldMaxTicks);
+	Snapshot->AsyncTransactions = SPB_READ_STAT(AsyncTransactions);
+
+	for (ULONG i = 0; i < 2; i++)
+	{
+		Snapshot->Transactions[i] = SPB_READ_STAT(Transactions[i]);
+		Snapshot->Bytes[i] = SPB_READ_STAT64(Bytes[i]);
+	}
 
 	//
-	// Xfer transactions start by writing an address pointer
+	// Status slots stay assigned across resets, only their counts are cleared
 	//
-	status = SpbDoWriteDataSynchronously(
-		SpbContext,
-		SendData,
-		SendLength);
 
-	if (!NT_SUCCESS(status))
+	for (ULONG i = 0; i < SPB_STATUS_SLOTS; i++)
 	{
-		Da7219Print(
-			DEBUG_LEVEL_ERROR,
-			DBG_IOCTL,
-			"Error setting address pointer for Spb read - %!STATUS!",
-			status);
-		goto exit;
+		Snapshot->FailureStatus[i] = (NTSTATUS)ReadNoFence((LONG*)&stats->FailureStatus[i]);
+		Snapshot->FailureCount[i] = SPB_READ_STAT(FailureCount[i]);
 	}
 
-	if (Length > DEFAULT_SPB_BUFFER_SIZE)
-	{
-		status = WdfMemoryCreate(
-			WDF_NO_OBJECT_ATTRIBUTES,
-			NonPagedPool,
-			DA7219_POOL_TAG,
-			Length,
-			&memory,
-			(PVOID*)&buffer);
+#undef SPB_READ_STAT
+#undef SPB_READ_STAT64
+}
 
-		if (!NT_SUCCESS(status))
-		{
-			Da7219Print(
-				DEBUG_LEVEL_ERROR,
-				DBG_IOCTL,
-				"Error allocating memory for Spb read - %!STATUS!",
-				status);
-			goto exit;
-		}
+VOID
+SpbCaptureStart(
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
 
-		WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(
-			&memoryDescriptor,
-			memory,
-			NULL);
-	}
-	else
-	{
-		buffer = (PUCHAR)WdfMemoryGetBuffer(SpbContext->ReadMemory, NULL);
+Routine Description:
 
-		WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
-			&memoryDescriptor,
-			(PVOID)buffer,
-			Length);
-	}
+This routine discards any previous capture and starts recording
+transfers from the beginning of the capture buffer.
 
+Arguments:
 
-	status = WdfIoTargetSendReadSynchronously(
-		SpbContext->SpbIoTarget,
-		NULL,
-		&memoryDescriptor,
-		NULL,
-		NULL,
-		&bytesRead);
+SpbContext - Pointer to the current device context
 
-	if (!NT_SUCCESS(status) ||
-		bytesRead != Length)
+Return Value:
+
+None
+
+--*/
+{
+	SPB_CAPTURE* capture = &SpbContext->Capture;
+
+	if (capture->Buffer == NULL)
 	{
-		Da7219Print(
-			DEBUG_LEVEL_ERROR,
-			DBG_IOCTL,
-			"Error reading from Spb - %!STATUS!",
-			status);
-		goto exit;
+		return;
 	}
 
 	//
-	// Copy back to the caller's buffer
+	// A transfer that saw the old Enabled value may still land in the
+	// cleared buffer, the capture is for diagnostics so that is tolerated
 	//
-	RtlCopyMemory(Data, buffer, Length);
 
-exit:
-	if (NULL != memory)
+	InterlockedExchange(&capture->Enabled, 0);
+
+	RtlZeroMemory(capture->Buffer, SPB_CAPTURE_SIZE);
+	capture->ReadOffset = 0;
+	InterlockedExchange(&capture->Dropped, 0);
+	InterlockedExchange(&capture->Used, 0);
+
+	InterlockedExchange(&capture->Enabled, 1);
+}
+
+VOID
+SpbCaptureStop(
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+Routine Description:
+
+This routine stops recording, the captured records stay readable.
+
+Arguments:
+
+SpbContext - Pointer to the current device context
+
+Return Value:
+
+None
+
+--*/
+{
+	InterlockedExchange(&SpbContext->Capture.Enabled, 0);
+}
+
+ULONG
+SpbCaptureRead(
+	IN SPB_CONTEXT* SpbContext,
+	IN ULONG Offset,
+	OUT PVOID Buffer,
+	IN ULONG Length
+)
+/*++
+
+Routine Description:
+
+This routine copies captured bytes starting at Offset.
+
+Arguments:
+
+SpbContext - Pointer to the current device context
+Offset     - Byte offset into the capture
+Buffer     - Receives the capture bytes
+Length     - Size of Buffer
+
+Return Value:
+
+The number of bytes copied, 0 past the end of the capture
+
+--*/
+{
+	SPB_CAPTURE* capture = &SpbContext->Capture;
+	ULONG used;
+
+	if (capture->Buffer == NULL)
 	{
-		WdfObjectDelete(memory);
+		return 0;
 	}
 
-	WdfWaitLockRelease(SpbContext->SpbLock);
+	used = min((ULONG)ReadNoFence(&capture->Used), SPB_CAPTURE_SIZE);
+	if (Offset >= used)
+	{
+		return 0;
+	}
 
-	return status;
+	Length = min(Length, used - Offset);
+	RtlCopyMemory(Buffer, &capture->Buffer[Offset], Length);
+
+	return Length;
 }
 
 VOID
@@ -318,19 +1037,29 @@ NTSTATUS Status indicating success or failure
 	//
 	// Free any SPB_CONTEXT allocations here
 	//
-	if (SpbContext->SpbLock != NULL)
+	SpbWaitForIdle(SpbContext);
+
+	for (ULONG i = 0; i < SPB_REQUEST_POOL_SIZE; i++)
 	{
-		WdfObjectDelete(SpbContext->SpbLock);
+		if (SpbContext->Requests[i] != NULL)
+		{
+			WdfObjectDelete(SpbContext->Requests[i]);
+			SpbContext->Requests[i] = NULL;
+		}
 	}
+	SpbContext->FreeRequests = 0;
 
-	if (SpbContext->ReadMemory != NULL)
+	SpbCaptureStop(SpbContext);
+	if (SpbContext->Capture.Memory != NULL)
 	{
-		WdfObjectDelete(SpbContext->ReadMemory);
+		WdfObjectDelete(SpbContext->Capture.Memory);
+		SpbContext->Capture.Memory = NULL;
+		SpbContext->Capture.Buffer = NULL;
 	}
 
-	if (SpbContext->WriteMemory != NULL)
+	if (SpbContext->SpbLock != NULL)
 	{
-		WdfObjectDelete(SpbContext->WriteMemory);
+		WdfObjectDelete(SpbContext->SpbLock);
 	}
 }
 
@@ -426,60 +1155,109 @@ NTSTATUS Status indicating success or failure
 	}
 
 	//
-	// Allocate some fixed-size buffers from NonPagedPool for typical
-	// Spb transaction sizes to avoid pool fragmentation in most cases
+	// Allocate a waitlock to serialize synchronous transfers
 	//
-	status = WdfMemoryCreate(
+	status = WdfWaitLockCreate(
 		WDF_NO_OBJECT_ATTRIBUTES,
-		NonPagedPool,
-		DA7219_POOL_TAG,
-		DEFAULT_SPB_BUFFER_SIZE,
-		&SpbContext->WriteMemory,
-		NULL);
+		&SpbContext->SpbLock);
 
 	if (!NT_SUCCESS(status))
 	{
 		Da7219Print(
 			DEBUG_LEVEL_ERROR,
 			DBG_IOCTL,
-			"Error allocating default memory for Spb write - %!STATUS!",
+			"Error creating Spb Waitlock - %!STATUS!",
 			status);
 		goto exit;
 	}
 
-	status = WdfMemoryCreate(
-		WDF_NO_OBJECT_ATTRIBUTES,
-		NonPagedPool,
-		DA7219_POOL_TAG,
-		DEFAULT_SPB_BUFFER_SIZE,
-		&SpbContext->ReadMemory,
-		NULL);
+	//
+	// Preallocate the requests used for asynchronous transfers so
+	// submitting one never has to create framework objects
+	//
+	KeInitializeEvent(&SpbContext->RequestCompleted, SynchronizationEvent, FALSE);
+	SpbContext->OutstandingRequests = 0;
+	SpbContext->AsyncStatus = STATUS_SUCCESS;
+	SpbContext->FreeRequests = 0;
 
-	if (!NT_SUCCESS(status))
+	for (ULONG i = 0; i < SPB_REQUEST_POOL_SIZE; i++)
 	{
-		Da7219Print(
-			DEBUG_LEVEL_ERROR,
-			DBG_IOCTL,
-			"Error allocating default memory for Spb read - %!STATUS!",
-			status);
-		goto exit;
+		WDF_OBJECT_ATTRIBUTES requestAttributes;
+		WDF_OBJECT_ATTRIBUTES memoryAttributes;
+		SPB_REQUEST_CONTEXT* requestContext;
+
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&requestAttributes, SPB_REQUEST_CONTEXT);
+		requestAttributes.ParentObject = FxDevice;
+
+		status = WdfRequestCreate(
+			&requestAttributes,
+			SpbContext->SpbIoTarget,
+			&SpbContext->Requests[i]);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(
+				DEBUG_LEVEL_ERROR,
+				DBG_IOCTL,
+				"Error creating Spb request - %!STATUS!",
+				status);
+			goto exit;
+		}
+
+		requestContext = GetSpbRequestContext(SpbContext->Requests[i]);
+		requestContext->SpbContext = SpbContext;
+		requestContext->Index = i;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&memoryAttributes);
+		memoryAttributes.ParentObject = SpbContext->Requests[i];
+
+		status = WdfMemoryCreatePreallocated(
+			&memoryAttributes,
+			requestContext->Buffer,
+			sizeof(requestContext->Buffer),
+			&requestContext->Memory);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(
+				DEBUG_LEVEL_ERROR,
+				DBG_IOCTL,
+				"Error creating Spb request memory - %!STATUS!",
+				status);
+			goto exit;
+		}
+
+		SpbContext->FreeRequests |= (1 << i);
 	}
 
 	//
-	// Allocate a waitlock to guard access to the default buffers
+	// Capture buffer, allocated up front so recording never allocates
 	//
-	status = WdfWaitLockCreate(
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&SpbContext->SpbLock);
-
-	if (!NT_SUCCESS(status))
 	{
-		Da7219Print(
-			DEBUG_LEVEL_ERROR,
-			DBG_IOCTL,
-			"Error creating Spb Waitlock - %!STATUS!",
-			status);
-		goto exit;
+		WDF_OBJECT_ATTRIBUTES captureAttributes;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&captureAttributes);
+		captureAttributes.ParentObject = FxDevice;
+
+		status = WdfMemoryCreate(
+			&captureAttributes,
+			NonPagedPoolNx,
+			DA7219_POOL_TAG,
+			SPB_CAPTURE_SIZE,
+			&SpbContext->Capture.Memory,
+			(PVOID*)&SpbContext->Capture.Buffer);
+
+		if (!NT_SUCCESS(status))
+		{
+			Da7219Print(
+				DEBUG_LEVEL_ERROR,
+				DBG_IOCTL,
+				"Error creating Spb capture buffer - %!STATUS!",
+				status);
+			goto exit;
+		}
+
+		SpbContext->Capture.Enabled = 0;
 	}
 
 exit:
@@ -23,9 +23,61 @@ Revision History:
 #include <wdm.h>
 #include <wdf.h>
 
-#define DEFAULT_SPB_BUFFER_SIZE 64
+#define SPB_MAX_TRANSFER_SIZE (1 + 256)	//Register address plus a full 8-bit register map
+#define SPB_REQUEST_POOL_SIZE 4
+#define SPB_MAX_READ_RANGES 8	//Address/read pairs in one SpbReadRegistersSynchronously sequence
 #define RESHUB_USE_HELPER_ROUTINES
 
+//
+// Completion callback for asynchronous transfers, may run at DISPATCH_LEVEL
+//
+
+typedef
+VOID
+EVT_SPB_TRANSFER_COMPLETE(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status
+);
+
+typedef EVT_SPB_TRANSFER_COMPLETE *PFN_SPB_TRANSFER_COMPLETE;
+
+//
+// Lock contention and bus utilization counters, updated with interlocked
+// operations. Times are in performance counter ticks.
+//
+
+#define SPB_STATS_READ   0
+#define SPB_STATS_WRITE  1
+#define SPB_STATUS_SLOTS 8
+
+typedef struct _SPB_STATISTICS
+{
+	LONG64 Frequency; // performance counter ticks per second, filled in by snapshots
+	LONG LockAcquisitions;
+	LONG LockContentions; // acquisitions that found the lock held
+	LONG64 LockWaitTicks;
+	LONG64 LockWaitMaxTicks;
+	LONG64 LockHeldTicks;
+	LONG64 LockHeldMaxTicks;
+	LONG Transactions[2]; // indexed by SPB_STATS_READ / SPB_STATS_WRITE
+	LONG64 Bytes[2];
+	LONG AsyncTransactions; // writes queued from the request pool, also counted above
+	NTSTATUS FailureStatus[SPB_STATUS_SLOTS]; // 0 marks a free slot
+	LONG FailureCount[SPB_STATUS_SLOTS]; // the last slot also takes statuses without a slot of their own
+} SPB_STATISTICS;
+
+#include "capture.h"
+
+typedef struct _SPB_CAPTURE
+{
+	WDFMEMORY Memory;
+	PUCHAR Buffer;
+	LONG Enabled;
+	LONG Used; // may run past SPB_CAPTURE_SIZE once full
+	LONG Dropped; // records that did not fit
+	ULONG ReadOffset;
+} SPB_CAPTURE;
+
 //
 // SPB (I2C) context
 //
@@ -34,9 +86,14 @@ typedef struct _SPB_CONTEXT
 {
 	WDFIOTARGET SpbIoTarget;
 	LARGE_INTEGER I2cResHubId;
-	WDFMEMORY WriteMemory;
-	WDFMEMORY ReadMemory;
 	WDFWAITLOCK SpbLock;
+	WDFREQUEST Requests[SPB_REQUEST_POOL_SIZE];
+	LONG FreeRequests;
+	LONG OutstandingRequests;
+	NTSTATUS AsyncStatus;
+	KEVENT RequestCompleted;
+	SPB_STATISTICS Stats;
+	SPB_CAPTURE Capture;
 } SPB_CONTEXT;
 
 NTSTATUS
@@ -65,4 +122,63 @@ SpbWriteDataSynchronously(
 	IN SPB_CONTEXT* SpbContext,
 	IN PVOID Data,
 	IN ULONG Length
-);
\ No newline at end of file
+);
+
+NTSTATUS
+SpbWriteRegisterSynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN PVOID Address,
+	IN ULONG AddressLength,
+	IN PVOID Data,
+	IN ULONG Length
+);
+
+NTSTATUS
+SpbWriteRegisterAsynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN PVOID Address,
+	IN ULONG AddressLength,
+	IN PVOID Data,
+	IN ULONG Length,
+	IN PFN_SPB_TRANSFER_COMPLETE Completion OPTIONAL,
+	IN PVOID CompletionContext OPTIONAL
+);
+
+NTSTATUS
+SpbReadRegistersSynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Addresses,
+	IN PVOID* Buffers,
+	IN PULONG Lengths,
+	IN ULONG Count
+);
+
+NTSTATUS
+SpbWaitForIdle(
+	IN SPB_CONTEXT* SpbContext
+);
+
+VOID
+SpbGetStatistics(
+	IN SPB_CONTEXT* SpbContext,
+	OUT SPB_STATISTICS* Snapshot,
+	IN BOOLEAN Reset
+);
+
+VOID
+SpbCaptureStart(
+	IN SPB_CONTEXT* SpbContext
+);
+
+VOID
+SpbCaptureStop(
+	IN SPB_CONTEXT* SpbContext
+);
+
+ULONG
+SpbCaptureRead(
+	IN SPB_CONTEXT* SpbContext,
+	IN ULONG Offset,
+	OUT PVOID Buffer,
+	IN ULONG Length
+);
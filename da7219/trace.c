@@ -0,0 +1,113 @@
+#include "codec.h"
+
+#if defined(DA7219_HOST_BUILD)
+
+#include <time.h>
+
+#define InterlockedIncrement(Addend) __sync_add_and_fetch((Addend), 1)
+#define InterlockedExchange(Target, Value) __sync_lock_test_and_set((Target), (Value))
+#define ReadAcquire(Source) __atomic_load_n((Source), __ATOMIC_ACQUIRE)
+#define KeMemoryBarrier() __sync_synchronize()
+
+static uint64_t da7219_trace_timestamp(uint64_t* frequency) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (frequency) {
+		*frequency = 1000000000ULL;
+	}
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+#else
+
+static uint64_t da7219_trace_timestamp(uint64_t* frequency) {
+	LARGE_INTEGER performanceFrequency;
+	LARGE_INTEGER counter = KeQueryPerformanceCounter(&performanceFrequency);
+
+	if (frequency) {
+		*frequency = performanceFrequency.QuadPart;
+	}
+	return counter.QuadPart;
+}
+
+#endif
+
+VOID da7219_trace_init(
+	_In_ PDA7219_TRACE trace
+) {
+	RtlZeroMemory(trace, sizeof(*trace));
+
+	//Boot, interrupt, report and power events on by default, per-register traffic on request
+	trace->Level = DA7219_TRACE_LEVEL_INFO;
+	trace->Categories = DA7219_TRACE_BOOT | DA7219_TRACE_IRQ | DA7219_TRACE_HID | DA7219_TRACE_POWER;
+	da7219_trace_timestamp(&trace->Frequency);
+
+	for (ULONG i = 0; i < DA7219_TRACE_RECORDS; i++) {
+		trace->Records[i].Sequence = (ULONG)-1;
+	}
+}
+
+//Hot path: one interlocked increment and a record store, callers check the level first
+VOID da7219_trace_write(
+	_In_ PDA7219_TRACE trace,
+	ULONG level,
+	USHORT event,
+	uint8_t reg,
+	ULONG value,
+	NTSTATUS status
+) {
+	LONG sequence = InterlockedIncrement(&trace->Next) - 1;
+	PDA7219_TRACE_RECORD record = &trace->Records[(ULONG)sequence % DA7219_TRACE_RECORDS];
+
+	//Invalidate first so a reader never takes a half written record for a whole one
+	InterlockedExchange((LONG*)&record->Sequence, -1);
+
+	record->Event = event;
+	record->Reg = reg;
+	record->Level = (UCHAR)level;
+	record->Timestamp = da7219_trace_timestamp(NULL);
+	record->Value = value;
+	record->Status = status;
+
+	InterlockedExchange((LONG*)&record->Sequence, sequence);
+}
+
+//Copies out up to count records from the read cursor, skipping anything already overwritten.
+//Returns the number copied, *first is the sequence number of records[0].
+ULONG da7219_trace_read(
+	_In_ PDA7219_TRACE trace,
+	_Out_ PULONG first,
+	_Out_ PDA7219_TRACE_RECORD records,
+	ULONG count
+) {
+	LONG next = trace->Next;
+	LONG cursor = trace->ReadCursor;
+	ULONG copied = 0;
+
+	if (next - cursor > DA7219_TRACE_RECORDS) {
+		cursor = next - DA7219_TRACE_RECORDS;
+	}
+
+	while (copied < count && cursor + (LONG)copied != next) {
+		ULONG sequence = (ULONG)(cursor + (LONG)copied);
+		PDA7219_TRACE_RECORD record = &trace->Records[sequence % DA7219_TRACE_RECORDS];
+
+		//Check the sequence before and after the copy, a writer lapping the reader part way
+		//through invalidates it first and leaves a different sequence behind
+		if ((ULONG)ReadAcquire((LONG*)&record->Sequence) != sequence) {
+			//Still being written, or already lapped by the writers
+			break;
+		}
+		records[copied] = *record;
+		KeMemoryBarrier();
+		if ((ULONG)ReadAcquire((LONG*)&record->Sequence) != sequence) {
+			break;
+		}
+		copied++;
+	}
+
+	trace->ReadCursor = cursor + (LONG)copied;
+	*first = (ULONG)cursor;
+	return copied;
+}
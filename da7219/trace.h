@@ -1,38 +1,25 @@
-#include <evntrace.h>
-
 #ifndef _TRACE_H_
 #define _TRACE_H_
 
-extern "C"
-{
-	//
-	// Tracing Definitions:
-	//
-	// Control GUID: 
-	// {73e3b785-f5fb-423e-94a9-56627fea9053}
-	//
+//
+// Tracing Definitions:
+//
+// Control GUID:
+// {5d0b6a3e-2c4f-4b8e-9d71-3a7219c0de19}
+//
 
 #define WPP_CONTROL_GUIDS                           \
     WPP_DEFINE_CONTROL_GUID(                        \
-        SpbTestToolTraceGuid,                       \
-        (73e3b785,f5fb,423e,94a9,56627fea9053),     \
+        Da7219TraceGuid,                            \
+        (5d0b6a3e,2c4f,4b8e,9d71,3a7219c0de19),     \
         WPP_DEFINE_BIT(TRACE_FLAG_WDFLOADING)       \
         WPP_DEFINE_BIT(TRACE_FLAG_SPBAPI)           \
         WPP_DEFINE_BIT(TRACE_FLAG_OTHER)            \
         )
-}
 
 #define WPP_LEVEL_FLAGS_LOGGER(level,flags) WPP_LEVEL_LOGGER(flags)
 #define WPP_LEVEL_FLAGS_ENABLED(level, flags) (WPP_LEVEL_ENABLED(flags) && WPP_CONTROL(WPP_BIT_ ## flags).Level >= level)
 
-#define Trace CyapaPrint
-#define FuncEntry 
-#define FuncExit 
-#define WPP_INIT_TRACING
-#define WPP_CLEANUP 
-#define TRACE_FLAG_SPBAPI 0
-#define TRACE_FLAG_WDFLOADING 0
-
 // begin_wpp config
 // FUNC FuncEntry{LEVEL=TRACE_LEVEL_VERBOSE}(FLAGS);
 // FUNC FuncExit{LEVEL=TRACE_LEVEL_VERBOSE}(FLAGS);
@@ -40,4 +27,89 @@ extern "C"
 // USEPREFIX(FuncExit, "%!STDPREFIX! [%!FUNC!] <--");
 // end_wpp
 
-#endif _TRACE_H_
+//
+// Binary trace ring. Each device keeps the last DA7219_TRACE_RECORDS
+// fixed-size records; nothing is formatted when a record is written, the
+// ring is read out through the trace feature reports and decoded offline.
+//
+
+#define DA7219_TRACE_RECORDS        256
+
+#define DA7219_TRACE_LEVEL_ERROR    1
+#define DA7219_TRACE_LEVEL_INFO     2
+#define DA7219_TRACE_LEVEL_VERBOSE  3
+
+#define DA7219_TRACE_BUS            0x01
+#define DA7219_TRACE_BOOT           0x02
+#define DA7219_TRACE_IRQ            0x04
+#define DA7219_TRACE_HID            0x08
+#define DA7219_TRACE_POWER          0x10
+
+typedef enum _DA7219_TRACE_EVENT
+{
+	Da7219TraceRegRead = 1,     // Reg, Value = count << 8 | first byte
+	Da7219TraceRegWrite,        // Reg, Value = count << 8 | first byte
+	Da7219TraceBusFlush,
+	Da7219TraceBootState,       // Value = DA7219_BOOT_STATE entered
+	Da7219TraceBootWait,        // Value = milliseconds
+	Da7219TraceOverBudget,      // Reg = DA7219_SCENARIO, Value = transactions << 16 | bytes
+	Da7219TraceInterrupt,       // Value = STATUS_A | EVENT_A << 8 | EVENT_B << 16
+	Da7219TraceReportQueued,    // Reg = report id
+	Da7219TraceReportDropped,   // Reg = report id
+	Da7219TraceD0Entry,         // Value = previous WDF_POWER_DEVICE_STATE
+	Da7219TraceD0Exit,          // Value = target WDF_POWER_DEVICE_STATE
+	Da7219TracePaths,           // Value = widgets powered before << 16 | after
+	Da7219TraceIrqMerged,       // queue full, Value = STATUS_A | EVENT_A << 8 | EVENT_B << 16
+	Da7219TraceChipRevision     // Reg = DA7219_CHIP_REVISION, Value = register
+} DA7219_TRACE_EVENT;
+
+typedef struct _DA7219_TRACE_RECORD
+{
+	ULONG Sequence;
+
+	USHORT Event;
+
+	UCHAR Reg;
+
+	UCHAR Level;
+
+	uint64_t Timestamp; // performance counter ticks
+
+	ULONG Value;
+
+	NTSTATUS Status;
+
+} DA7219_TRACE_RECORD, *PDA7219_TRACE_RECORD;
+
+typedef struct _DA7219_TRACE
+{
+	volatile ULONG Level;
+
+	volatile ULONG Categories;
+
+	volatile LONG Next; // sequence number of the next record written
+
+	LONG ReadCursor;
+
+	uint64_t Frequency; // performance counter ticks per second
+
+	DA7219_TRACE_RECORD Records[DA7219_TRACE_RECORDS];
+
+} DA7219_TRACE, *PDA7219_TRACE;
+
+#define DA7219_TRACE_ENABLED(trace, level, category) \
+	((trace) != NULL && (trace)->Level >= (level) && ((trace)->Categories & (category)))
+
+#define Da7219Trace(trace, level, category, event, reg, value, status) \
+	do { \
+		if (DA7219_TRACE_ENABLED(trace, level, category)) \
+			da7219_trace_write((trace), (level), (event), (reg), (value), (status)); \
+	} while (0)
+
+VOID da7219_trace_init(_In_ PDA7219_TRACE trace);
+
+VOID da7219_trace_write(_In_ PDA7219_TRACE trace, ULONG level, USHORT event, uint8_t reg, ULONG value, NTSTATUS status);
+
+ULONG da7219_trace_read(_In_ PDA7219_TRACE trace, _Out_ PULONG first, _Out_ PDA7219_TRACE_RECORD records, ULONG count);
+
+#endif
@@ -0,0 +1,148 @@
+#include "sim.h"
+#include "registers.h"
+#include "registers-aad.h"
+
+//
+// Drives the driver's main scenarios against the simulator and checks each
+// run against da7219_scenario_budget. Exits nonzero when a scenario fails or
+// goes over budget, so any change that adds bus traffic past a budget fails
+// the build's test run.
+//
+
+static const char* const bench_scenario_names[Da7219ScenarioCount] = {
+	"boot", "resume-warm", "resume-cold", "suspend", "insert", "remove", "button"
+};
+
+static const ULONG bench_rates[] = { DA7219_I2C_STANDARD_HZ, DA7219_I2C_FAST_HZ, DA7219_I2C_FAST_PLUS_HZ };
+
+static const char* const bench_platform_names[] = { "none", "intel", "stoney", "ryzen" };
+
+typedef struct _BENCH
+{
+	DA7219_SIM Sim;
+
+	DA7219_BUS Bus;
+
+	DA7219_CODEC Codec;
+
+	Platform Platform;
+
+} BENCH;
+
+static int bench_failures;
+
+static VOID bench_init(BENCH* bench, Platform platform, ULONG busHz) {
+	RtlZeroMemory(bench, sizeof(*bench));
+	da7219_sim_init(&bench->Sim);
+	da7219_sim_set_cost(&bench->Sim, busHz, 0);
+	da7219_sim_bus(&bench->Sim, &bench->Bus);
+	da7219_codec_init(&bench->Codec, &bench->Bus);
+	da7219_bus_set_cost(&bench->Codec, busHz, 0);
+	bench->Platform = platform;
+}
+
+//Checks the run just charged to scenario against its budget
+static VOID bench_report(BENCH* bench, const char* name, DA7219_SCENARIO scenario, NTSTATUS status) {
+	const DA7219_SCENARIO_STATS* stats = &bench->Codec.Scenarios[scenario];
+	const DA7219_SCENARIO_BUDGET* budget = &da7219_scenario_budget[scenario];
+	ULONG transactions = stats->Last.Reads + stats->Last.Writes;
+	ULONG bytes = stats->Last.BytesRead + stats->Last.BytesWritten;
+	const char* verdict = "ok";
+
+	if (!NT_SUCCESS(status)) {
+		verdict = "FAILED";
+		bench_failures++;
+	}
+	else if (transactions > budget->Transactions || bytes > budget->Bytes) {
+		verdict = "OVER BUDGET";
+		bench_failures++;
+	}
+
+	printf("%-7s %-30s %-11s %5u/%-3u %7u/%-4u %10.1f us  %s\n",
+		bench_platform_names[bench->Platform], name, bench_scenario_names[scenario],
+		transactions, budget->Transactions, bytes, budget->Bytes,
+		stats->Last.BusTimeNs / 1000.0, verdict);
+}
+
+static NTSTATUS bench_irq(BENCH* bench) {
+	DA7219_IRQ_EVENTS events;
+
+	return da7219_codec_irq(&bench->Codec, &events);
+}
+
+//Every scenario once, the worst case of each where the simulator can force it
+static VOID bench_run(Platform platform, ULONG busHz) {
+	static BENCH bench;
+	NTSTATUS status;
+
+	bench_init(&bench, platform, busHz);
+	status = da7219_boot_blocking(&bench.Codec, platform);
+	bench_report(&bench, "cold boot", Da7219ScenarioBoot, status);
+
+	status = da7219_suspend_blocking(&bench.Codec);
+	bench_report(&bench, "suspend", Da7219ScenarioSuspend, status);
+
+	status = da7219_boot_blocking(&bench.Codec, platform);
+	bench_report(&bench, "resume, state kept", Da7219ScenarioResumeWarm, status);
+
+	da7219_sim_jack_insert(&bench.Sim);
+	status = bench_irq(&bench);
+	bench_report(&bench, "jack insert", Da7219ScenarioInsert, status);
+
+	da7219_sim_jack_detect(&bench.Sim, TRUE);
+	status = bench_irq(&bench);
+	bench_report(&bench, "headset detect", Da7219ScenarioInsert, status);
+
+	da7219_sim_button(&bench.Sim, 0, TRUE);
+	status = bench_irq(&bench);
+	bench_report(&bench, "button press", Da7219ScenarioButton, status);
+
+	da7219_sim_button(&bench.Sim, 0, FALSE);
+	status = bench_irq(&bench);
+	bench_report(&bench, "button release", Da7219ScenarioButton, status);
+
+	da7219_sim_jack_remove(&bench.Sim);
+	status = bench_irq(&bench);
+	bench_report(&bench, "jack remove", Da7219ScenarioRemove, status);
+
+	//Codec lost its state while suspended and the system controller never settles
+	da7219_suspend_blocking(&bench.Codec);
+	bench.Sim.Regs[DA7219_PLL_CTRL] ^= DA7219_PLL_MODE_MASK;
+	bench.Sim.SettleUs = DA7219_SIM_NEVER_SETTLES;
+	status = da7219_boot_blocking(&bench.Codec, platform);
+	bench_report(&bench, "resume, state lost, no settle", Da7219ScenarioResumeCold, status);
+
+	//Warm reboot with no saved image, same stuck system controller
+	bench_init(&bench, platform, busHz);
+	bench.Sim.Regs[DA7219_SYSTEM_ACTIVE] = DA7219_SYSTEM_ACTIVE_MASK;
+	bench.Sim.SettleUs = DA7219_SIM_NEVER_SETTLES;
+	status = da7219_boot_blocking(&bench.Codec, platform);
+	bench_report(&bench, "warm boot, no settle", Da7219ScenarioBoot, status);
+
+	//The core's accounting has to agree with what the bus saw
+	DA7219_BUS_STATS core;
+	da7219_bus_stats(&bench.Codec, &core, FALSE);
+	if (core.Reads != bench.Sim.Stats.Reads ||
+		core.Writes != bench.Sim.Stats.Writes ||
+		core.BusTimeNs != bench.Sim.Stats.BusTimeNs) {
+		printf("%-7s accounting mismatch: core %u/%u, bus %u/%u\n", bench_platform_names[platform],
+			core.Reads, core.Writes, bench.Sim.Stats.Reads, bench.Sim.Stats.Writes);
+		bench_failures++;
+	}
+}
+
+int main(void) {
+	for (ULONG rate = 0; rate < ARRAYSIZE(bench_rates); rate++) {
+		printf("\n%u Hz I2C\n%-7s %-30s %-11s %9s %11s %13s\n", bench_rates[rate],
+			"", "run", "scenario", "tx/budget", "bytes/budget", "bus time");
+		for (int platform = PlatformIntel; platform <= PlatformRyzen; platform++) {
+			bench_run((Platform)platform, bench_rates[rate]);
+		}
+	}
+
+	if (bench_failures) {
+		printf("\n%d scenario(s) failed or over budget\n", bench_failures);
+		return 1;
+	}
+	return 0;
+}
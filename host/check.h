@@ -0,0 +1,33 @@
+#if !defined(_DA7219_CHECK_H_)
+#define _DA7219_CHECK_H_
+
+//
+// Minimal checks for the host tests. A failed CHECK reports and carries on,
+// CHECK_EXIT turns the tally into the process exit code for ctest.
+//
+
+#include <stdio.h>
+
+static int da7219_check_failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			da7219_check_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQ(a, b) \
+	do { \
+		unsigned long long _a = (unsigned long long)(a), _b = (unsigned long long)(b); \
+		if (_a != _b) { \
+			fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %llu != %llu\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+			da7219_check_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_EXIT() \
+	(da7219_check_failures ? (fprintf(stderr, "%d check(s) failed\n", da7219_check_failures), 1) : 0)
+
+#endif
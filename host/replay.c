@@ -0,0 +1,413 @@
+#include "replay.h"
+
+VOID da7219_capture_open(
+	_Out_ PDA7219_CAPTURE_CURSOR cursor,
+	const UCHAR* buffer,
+	ULONG length
+) {
+	cursor->Buffer = buffer;
+	cursor->Length = length;
+	cursor->Offset = 0;
+	cursor->Malformed = FALSE;
+}
+
+//FALSE at the zero Length that ends the committed records, at the end of
+//the buffer, or at a record that does not fit it
+BOOLEAN da7219_capture_next(
+	_In_ PDA7219_CAPTURE_CURSOR cursor,
+	_Out_ PDA7219_CAPTURE_XFER xfer
+) {
+	SPB_CAPTURE_RECORD record;
+	const UCHAR* data;
+
+	if (cursor->Malformed || cursor->Length - cursor->Offset < sizeof(record)) {
+		return FALSE;
+	}
+
+	RtlCopyMemory(&record, cursor->Buffer + cursor->Offset, sizeof(record));
+	if (record.Length == 0) {
+		return FALSE;
+	}
+
+	if ((record.Length & 7) != 0 ||
+		record.Length < sizeof(record) + record.DataLength ||
+		record.Length > cursor->Length - cursor->Offset ||
+		((record.Direction & ~SPB_CAPTURE_ASYNC) == SPB_CAPTURE_WRITE && record.Register == 0 && record.DataLength == 0)) {
+		cursor->Malformed = TRUE;
+		return FALSE;
+	}
+
+	data = cursor->Buffer + cursor->Offset + sizeof(record);
+
+	xfer->Offset = cursor->Offset;
+	xfer->Direction = record.Direction & ~SPB_CAPTURE_ASYNC;
+	xfer->Async = (record.Direction & SPB_CAPTURE_ASYNC) != 0;
+	xfer->Reg = record.Register;
+	xfer->Status = record.Status;
+	xfer->Timestamp = record.Timestamp;
+	xfer->Count = record.DataLength;
+	xfer->Data = data;
+
+	//Raw writes record the address inside the payload, register 0 is unmapped
+	//so a register write never looks like one
+	if (xfer->Direction == SPB_CAPTURE_WRITE && record.Register == 0) {
+		xfer->Reg = data[0];
+		xfer->Count--;
+		xfer->Data++;
+	}
+
+	cursor->Offset += record.Length;
+	return TRUE;
+}
+
+static uint64_t da7219_capture_us(
+	LONG64 timestamp,
+	LONG64 frequency
+) {
+	return (uint64_t)(timestamp / frequency) * 1000000 +
+		(uint64_t)(timestamp % frequency) * 1000000 / (uint64_t)frequency;
+}
+
+//
+// Replay bus
+//
+
+static VOID da7219_replay_diverged(
+	_In_ PDA7219_REPLAY replay,
+	ULONG offset
+) {
+	if (replay->Divergences == 0) {
+		replay->FirstDivergence = offset;
+	}
+	replay->Divergences++;
+}
+
+//Takes the next record if it is the transfer the core is making
+static BOOLEAN da7219_replay_take(
+	_In_ PDA7219_REPLAY replay,
+	UCHAR direction,
+	uint8_t reg,
+	ULONG count,
+	_Out_ PDA7219_CAPTURE_XFER xfer
+) {
+	DA7219_CAPTURE_CURSOR next = replay->Cursor;
+	uint64_t recordedUs;
+
+	if (!da7219_capture_next(&next, xfer)) {
+		da7219_replay_diverged(replay, replay->Cursor.Offset);
+		return FALSE;
+	}
+
+	if (xfer->Direction != direction || xfer->Reg != reg || xfer->Count != count) {
+		da7219_replay_diverged(replay, xfer->Offset);
+		return FALSE;
+	}
+
+	replay->Cursor = next;
+	replay->Consumed++;
+
+	recordedUs = da7219_capture_us(xfer->Timestamp, replay->Frequency);
+	if (recordedUs > replay->NowUs) {
+		replay->NowUs = recordedUs;
+	}
+	return TRUE;
+}
+
+static NTSTATUS da7219_replay_read(
+	PVOID Context,
+	uint8_t reg,
+	uint8_t* data,
+	ULONG count
+) {
+	PDA7219_REPLAY replay = (PDA7219_REPLAY)Context;
+	DA7219_CAPTURE_XFER xfer;
+
+	if (!da7219_replay_take(replay, SPB_CAPTURE_READ, reg, count, &xfer)) {
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	RtlCopyMemory(data, xfer.Data, count);
+	return xfer.Status;
+}
+
+//SpbReadRegistersSynchronously records each range on its own
+static NTSTATUS da7219_replay_read_ranges(
+	PVOID Context,
+	const DA7219_BUS_RANGE* ranges,
+	ULONG count
+) {
+	NTSTATUS status = STATUS_SUCCESS;
+	ULONG i;
+
+	for (i = 0; i < count && NT_SUCCESS(status); i++) {
+		status = da7219_replay_read(Context, ranges[i].Reg, ranges[i].Data, ranges[i].Count);
+	}
+	return status;
+}
+
+static NTSTATUS da7219_replay_write(
+	PVOID Context,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count
+) {
+	PDA7219_REPLAY replay = (PDA7219_REPLAY)Context;
+	DA7219_CAPTURE_XFER xfer;
+
+	if (!da7219_replay_take(replay, SPB_CAPTURE_WRITE, reg, count, &xfer)) {
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	if (memcmp(xfer.Data, data, count) != 0) {
+		da7219_replay_diverged(replay, xfer.Offset);
+	}
+
+	//Queued writes only record that they were queued
+	return xfer.Async ? STATUS_SUCCESS : xfer.Status;
+}
+
+static NTSTATUS da7219_replay_flush(
+	PVOID Context
+) {
+	UNREFERENCED_PARAMETER(Context);
+	return STATUS_SUCCESS;
+}
+
+static VOID da7219_replay_delay(
+	PVOID Context,
+	ULONG ms
+) {
+	PDA7219_REPLAY replay = (PDA7219_REPLAY)Context;
+
+	replay->NowUs += (uint64_t)ms * 1000;
+}
+
+static uint64_t da7219_replay_now(
+	PVOID Context
+) {
+	return ((PDA7219_REPLAY)Context)->NowUs;
+}
+
+VOID da7219_replay_init(
+	_Out_ PDA7219_REPLAY replay,
+	const UCHAR* buffer,
+	ULONG length,
+	LONG64 frequency
+) {
+	RtlZeroMemory(replay, sizeof(*replay));
+	da7219_capture_open(&replay->Cursor, buffer, length);
+	replay->Frequency = frequency;
+}
+
+VOID da7219_replay_bus(
+	_In_ PDA7219_REPLAY replay,
+	_Out_ DA7219_BUS* bus
+) {
+	RtlZeroMemory(bus, sizeof(*bus));
+	bus->Context = replay;
+	bus->Read = da7219_replay_read;
+	bus->Write = da7219_replay_write;
+	bus->ReadRanges = da7219_replay_read_ranges;
+	bus->WriteAsync = da7219_replay_write;
+	bus->Flush = da7219_replay_flush;
+	bus->Delay = da7219_replay_delay;
+	bus->Now = da7219_replay_now;
+}
+
+//Every record played back and none left over
+BOOLEAN da7219_replay_done(
+	_In_ PDA7219_REPLAY replay
+) {
+	DA7219_CAPTURE_CURSOR next = replay->Cursor;
+	DA7219_CAPTURE_XFER xfer;
+
+	return replay->Divergences == 0 && !replay->Cursor.Malformed && !da7219_capture_next(&next, &xfer);
+}
+
+ULONG da7219_replay_apply(
+	_In_ PDA7219_SIM sim,
+	const UCHAR* buffer,
+	ULONG length,
+	LONG64 frequency
+) {
+	DA7219_CAPTURE_CURSOR cursor;
+	DA7219_CAPTURE_XFER xfer;
+	DA7219_BUS bus;
+	UCHAR data[SPB_CAPTURE_SIZE];
+	uint64_t baseNs = 0;
+	uint64_t firstUs = 0;
+	BOOLEAN first = TRUE;
+	ULONG mismatches = 0;
+
+	da7219_sim_bus(sim, &bus);
+	da7219_capture_open(&cursor, buffer, length);
+
+	while (da7219_capture_next(&cursor, &xfer)) {
+		uint64_t us = da7219_capture_us(xfer.Timestamp, frequency);
+		uint64_t costNs = da7219_sim_cost_ns(sim, xfer.Direction == SPB_CAPTURE_READ, xfer.Count);
+		uint64_t atNs;
+
+		//Timestamps are taken once the transfer is done, start it early
+		//enough to finish on time so reads see the codec as it was then.
+		//The first transfer starts now.
+		if (first) {
+			baseNs = sim->NowNs + costNs;
+			firstUs = us;
+			first = FALSE;
+		}
+		atNs = baseNs + (us - firstUs) * 1000;
+		if (atNs > sim->NowNs + costNs) {
+			sim->NowNs = atNs - costNs;
+		}
+
+		if (xfer.Direction == SPB_CAPTURE_WRITE) {
+			bus.Write(bus.Context, xfer.Reg, xfer.Data, xfer.Count);
+			continue;
+		}
+
+		bus.Read(bus.Context, xfer.Reg, data, xfer.Count);
+		if (NT_SUCCESS(xfer.Status) && memcmp(data, xfer.Data, xfer.Count) != 0) {
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+//
+// Capture writer
+//
+
+static VOID da7219_capture_record(
+	_In_ PDA7219_CAPTURE_WRITER writer,
+	UCHAR direction,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count,
+	NTSTATUS status
+) {
+	SPB_CAPTURE_RECORD record;
+	ULONG recordLength = (sizeof(record) + count + 7) & ~7;
+
+	if (writer->Used + recordLength > SPB_CAPTURE_SIZE) {
+		writer->Dropped++;
+		return;
+	}
+
+	RtlZeroMemory(&record, sizeof(record));
+	record.Length = (USHORT)recordLength;
+	record.Direction = direction;
+	record.Register = reg;
+	record.Status = status;
+	record.Timestamp = (LONG64)writer->Inner.Now(writer->Inner.Context);
+	record.DataLength = (USHORT)count;
+
+	RtlZeroMemory(writer->Buffer + writer->Used, recordLength);
+	RtlCopyMemory(writer->Buffer + writer->Used, &record, sizeof(record));
+	RtlCopyMemory(writer->Buffer + writer->Used + sizeof(record), data, count);
+	writer->Used += recordLength;
+}
+
+static NTSTATUS da7219_capture_writer_read(
+	PVOID Context,
+	uint8_t reg,
+	uint8_t* data,
+	ULONG count
+) {
+	PDA7219_CAPTURE_WRITER writer = (PDA7219_CAPTURE_WRITER)Context;
+	NTSTATUS status = writer->Inner.Read(writer->Inner.Context, reg, data, count);
+
+	da7219_capture_record(writer, SPB_CAPTURE_READ, reg, data, count, status);
+	return status;
+}
+
+static NTSTATUS da7219_capture_writer_read_ranges(
+	PVOID Context,
+	const DA7219_BUS_RANGE* ranges,
+	ULONG count
+) {
+	PDA7219_CAPTURE_WRITER writer = (PDA7219_CAPTURE_WRITER)Context;
+	NTSTATUS status = writer->Inner.ReadRanges(writer->Inner.Context, ranges, count);
+	ULONG i;
+
+	for (i = 0; i < count; i++) {
+		da7219_capture_record(writer, SPB_CAPTURE_READ, ranges[i].Reg, ranges[i].Data, ranges[i].Count, status);
+	}
+	return status;
+}
+
+static NTSTATUS da7219_capture_writer_write(
+	PVOID Context,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count
+) {
+	PDA7219_CAPTURE_WRITER writer = (PDA7219_CAPTURE_WRITER)Context;
+	NTSTATUS status = writer->Inner.Write(writer->Inner.Context, reg, data, count);
+
+	da7219_capture_record(writer, SPB_CAPTURE_WRITE, reg, data, count, status);
+	return status;
+}
+
+static NTSTATUS da7219_capture_writer_write_async(
+	PVOID Context,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count
+) {
+	PDA7219_CAPTURE_WRITER writer = (PDA7219_CAPTURE_WRITER)Context;
+	NTSTATUS status = writer->Inner.WriteAsync(writer->Inner.Context, reg, data, count);
+
+	da7219_capture_record(writer, SPB_CAPTURE_WRITE | SPB_CAPTURE_ASYNC, reg, data, count, STATUS_PENDING);
+	return status;
+}
+
+static NTSTATUS da7219_capture_writer_flush(
+	PVOID Context
+) {
+	PDA7219_CAPTURE_WRITER writer = (PDA7219_CAPTURE_WRITER)Context;
+
+	return writer->Inner.Flush(writer->Inner.Context);
+}
+
+static VOID da7219_capture_writer_delay(
+	PVOID Context,
+	ULONG ms
+) {
+	PDA7219_CAPTURE_WRITER writer = (PDA7219_CAPTURE_WRITER)Context;
+
+	writer->Inner.Delay(writer->Inner.Context, ms);
+}
+
+static uint64_t da7219_capture_writer_now(
+	PVOID Context
+) {
+	PDA7219_CAPTURE_WRITER writer = (PDA7219_CAPTURE_WRITER)Context;
+
+	return writer->Inner.Now(writer->Inner.Context);
+}
+
+VOID da7219_capture_writer_init(
+	_Out_ PDA7219_CAPTURE_WRITER writer,
+	const DA7219_BUS* inner
+) {
+	writer->Inner = *inner;
+	writer->Used = 0;
+	writer->Dropped = 0;
+}
+
+//Leaves out the optional hooks Inner does not have
+VOID da7219_capture_writer_bus(
+	_In_ PDA7219_CAPTURE_WRITER writer,
+	_Out_ DA7219_BUS* bus
+) {
+	RtlZeroMemory(bus, sizeof(*bus));
+	bus->Context = writer;
+	bus->Read = da7219_capture_writer_read;
+	bus->Write = da7219_capture_writer_write;
+	bus->ReadRanges = writer->Inner.ReadRanges != NULL ? da7219_capture_writer_read_ranges : NULL;
+	bus->WriteAsync = writer->Inner.WriteAsync != NULL ? da7219_capture_writer_write_async : NULL;
+	bus->Flush = writer->Inner.Flush != NULL ? da7219_capture_writer_flush : NULL;
+	bus->Delay = da7219_capture_writer_delay;
+	bus->Now = da7219_capture_writer_now;
+}
@@ -0,0 +1,121 @@
+#if !defined(_DA7219_REPLAY_H_)
+#define _DA7219_REPLAY_H_
+
+//
+// Host side of the SPB transaction capture. A capture pulled from the
+// driver through the capture feature reports is the raw buffer from offset
+// 0 to Used, a run of SPB_CAPTURE_RECORDs each followed by its payload.
+//
+// The cursor walks the records. The replay bus plays a capture back to the
+// codec core: each read is served the recorded bytes and each write is
+// compared with the recorded one, so running the same core operation that
+// produced the capture shows where the core now behaves differently. The
+// writer is the other direction, a DA7219_BUS that records what passes
+// through it the way SpbCapture does, so host runs produce captures too.
+//
+
+#include "codec.h"
+#include "capture.h"
+#include "sim.h"
+
+//
+// One transfer. Raw writes carry the address as their first payload byte,
+// the cursor moves it to Reg so every transfer reads the same way.
+//
+
+typedef struct _DA7219_CAPTURE_XFER
+{
+	ULONG Offset; // of the record in the capture
+
+	UCHAR Direction; // SPB_CAPTURE_READ or SPB_CAPTURE_WRITE, SPB_CAPTURE_ASYNC stripped
+
+	BOOLEAN Async;
+
+	UCHAR Reg;
+
+	NTSTATUS Status;
+
+	LONG64 Timestamp;
+
+	ULONG Count;
+
+	const UCHAR* Data;
+
+} DA7219_CAPTURE_XFER, *PDA7219_CAPTURE_XFER;
+
+typedef struct _DA7219_CAPTURE_CURSOR
+{
+	const UCHAR* Buffer;
+
+	ULONG Length;
+
+	ULONG Offset;
+
+	BOOLEAN Malformed; // stopped at a record that does not fit the buffer
+
+} DA7219_CAPTURE_CURSOR, *PDA7219_CAPTURE_CURSOR;
+
+VOID da7219_capture_open(_Out_ PDA7219_CAPTURE_CURSOR cursor, const UCHAR* buffer, ULONG length);
+
+BOOLEAN da7219_capture_next(_In_ PDA7219_CAPTURE_CURSOR cursor, _Out_ PDA7219_CAPTURE_XFER xfer);
+
+//
+// Replay bus. Now runs on the recorded timestamps, Frequency ticks per
+// second, plus whatever Delay added since the last record.
+//
+
+typedef struct _DA7219_REPLAY
+{
+	DA7219_CAPTURE_CURSOR Cursor;
+
+	LONG64 Frequency;
+
+	uint64_t NowUs;
+
+	ULONG Consumed; // records played back
+
+	ULONG Divergences; // transfers the core made differently from the capture
+
+	ULONG FirstDivergence; // record offset, valid when Divergences != 0
+
+} DA7219_REPLAY, *PDA7219_REPLAY;
+
+VOID da7219_replay_init(_Out_ PDA7219_REPLAY replay, const UCHAR* buffer, ULONG length, LONG64 frequency);
+
+VOID da7219_replay_bus(_In_ PDA7219_REPLAY replay, _Out_ DA7219_BUS* bus);
+
+BOOLEAN da7219_replay_done(_In_ PDA7219_REPLAY replay);
+
+//
+// Plays every transfer of a capture onto a simulator at the recorded pace,
+// charging the simulator's cost model. The ranges of one ReadRanges are
+// recorded apart and charged as a read each. Returns the reads whose
+// recorded bytes differ from what the simulator returned.
+//
+
+ULONG da7219_replay_apply(_In_ PDA7219_SIM sim, const UCHAR* buffer, ULONG length, LONG64 frequency);
+
+//
+// Capture writer, records every transfer through Inner. Timestamps are
+// Inner's Now in microseconds, replay with a frequency of 1000000.
+//
+
+#define DA7219_CAPTURE_FREQUENCY   1000000
+
+typedef struct _DA7219_CAPTURE_WRITER
+{
+	DA7219_BUS Inner;
+
+	UCHAR Buffer[SPB_CAPTURE_SIZE];
+
+	ULONG Used;
+
+	ULONG Dropped;
+
+} DA7219_CAPTURE_WRITER, *PDA7219_CAPTURE_WRITER;
+
+VOID da7219_capture_writer_init(_Out_ PDA7219_CAPTURE_WRITER writer, const DA7219_BUS* inner);
+
+VOID da7219_capture_writer_bus(_In_ PDA7219_CAPTURE_WRITER writer, _Out_ DA7219_BUS* bus);
+
+#endif
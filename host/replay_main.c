@@ -0,0 +1,132 @@
+#include "replay.h"
+
+#include <stdlib.h>
+
+//
+// da7219_replay <capture> [frequency [intel|stoney|ryzen]]
+//
+// Lists the transfers of a capture saved from the capture feature reports,
+// then plays it onto the simulator at each I2C rate for its transaction
+// count and bus time. With a platform, also replays it as a boot of the
+// codec core and reports the first transfer where the core now differs.
+// frequency is the Frequency from the capture control report, performance
+// counter ticks per second.
+//
+
+static const ULONG replay_rates[] = { DA7219_I2C_STANDARD_HZ, DA7219_I2C_FAST_HZ, DA7219_I2C_FAST_PLUS_HZ };
+
+static const char* const replay_platform_names[] = { "none", "intel", "stoney", "ryzen" };
+
+static UCHAR replay_buffer[SPB_CAPTURE_SIZE];
+
+static VOID replay_list(const UCHAR* buffer, ULONG length, LONG64 frequency) {
+	DA7219_CAPTURE_CURSOR cursor;
+	DA7219_CAPTURE_XFER xfer;
+	LONG64 first = 0;
+	ULONG records = 0, failed = 0;
+
+	da7219_capture_open(&cursor, buffer, length);
+	while (da7219_capture_next(&cursor, &xfer)) {
+		const char* name = da7219_reg_name(xfer.Reg);
+
+		if (records++ == 0) {
+			first = xfer.Timestamp;
+		}
+		if (!NT_SUCCESS(xfer.Status)) {
+			failed++;
+		}
+
+		printf("%6u %12.1f us  %-5s %-28s %3u  %08x ", xfer.Offset,
+			(double)(xfer.Timestamp - first) * 1000000.0 / (double)frequency,
+			xfer.Direction == SPB_CAPTURE_READ ? "read" : xfer.Async ? "async" : "write",
+			name != NULL ? name : "?", xfer.Count, (unsigned int)xfer.Status);
+		for (ULONG i = 0; i < xfer.Count && i < 16; i++) {
+			printf(" %02x", xfer.Data[i]);
+		}
+		printf("%s\n", xfer.Count > 16 ? " ..." : "");
+	}
+
+	printf("\n%u records, %u failed%s\n", records, failed,
+		cursor.Malformed ? ", stopped at a malformed record" : "");
+}
+
+static VOID replay_profile(const UCHAR* buffer, ULONG length, LONG64 frequency) {
+	static DA7219_SIM sim;
+	DA7219_BUS_STATS stats;
+
+	printf("\n%-10s %9s %11s %13s %14s\n", "I2C", "reads", "writes", "bus time", "read mismatches");
+	for (ULONG rate = 0; rate < ARRAYSIZE(replay_rates); rate++) {
+		ULONG mismatches;
+
+		da7219_sim_init(&sim);
+		da7219_sim_set_cost(&sim, replay_rates[rate], 0);
+		mismatches = da7219_replay_apply(&sim, buffer, length, frequency);
+		da7219_sim_stats(&sim, &stats, TRUE);
+
+		printf("%7u Hz %6u/%-4u %6u/%-4u %10.1f us %14u\n", replay_rates[rate],
+			stats.Reads, stats.BytesRead, stats.Writes, stats.BytesWritten,
+			stats.BusTimeNs / 1000.0, mismatches);
+	}
+}
+
+static int replay_boot(const UCHAR* buffer, ULONG length, LONG64 frequency, Platform platform) {
+	static DA7219_CODEC codec;
+	DA7219_REPLAY replay;
+	DA7219_BUS bus;
+	NTSTATUS status;
+
+	da7219_replay_init(&replay, buffer, length, frequency);
+	da7219_replay_bus(&replay, &bus);
+	da7219_codec_init(&codec, &bus);
+	status = da7219_boot_blocking(&codec, platform);
+
+	printf("\n%s boot: status %08x, %u records replayed", replay_platform_names[platform],
+		(unsigned int)status, replay.Consumed);
+	if (replay.Divergences) {
+		printf(", %u divergence(s), first at record offset %u\n", replay.Divergences, replay.FirstDivergence);
+		return 1;
+	}
+	printf(", no divergence\n");
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	LONG64 frequency = 10000000;
+	FILE* file;
+	ULONG length;
+
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr, "usage: %s <capture> [frequency [intel|stoney|ryzen]]\n", argv[0]);
+		return 2;
+	}
+
+	file = fopen(argv[1], "rb");
+	if (file == NULL) {
+		perror(argv[1]);
+		return 2;
+	}
+	length = (ULONG)fread(replay_buffer, 1, sizeof(replay_buffer), file);
+	fclose(file);
+
+	if (argc > 2) {
+		frequency = strtoll(argv[2], NULL, 0);
+		if (frequency <= 0) {
+			fprintf(stderr, "bad frequency %s\n", argv[2]);
+			return 2;
+		}
+	}
+
+	replay_list(replay_buffer, length, frequency);
+	replay_profile(replay_buffer, length, frequency);
+
+	if (argc > 3) {
+		for (int platform = PlatformIntel; platform <= PlatformRyzen; platform++) {
+			if (strcmp(argv[3], replay_platform_names[platform]) == 0) {
+				return replay_boot(replay_buffer, length, frequency, (Platform)platform);
+			}
+		}
+		fprintf(stderr, "unknown platform %s\n", argv[3]);
+		return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,336 @@
+#include "sim.h"
+#include "registers.h"
+#include "registers-aad.h"
+
+//Gain status registers and the gain each one reports once its ramp is done
+static const UCHAR da7219_sim_gain_status[][2] = {
+	{ DA7219_MIC_1_GAIN_STATUS, DA7219_MIC_1_GAIN },
+	{ DA7219_MIXIN_L_GAIN_STATUS, DA7219_MIXIN_L_GAIN },
+	{ DA7219_ADC_L_GAIN_STATUS, DA7219_ADC_L_GAIN },
+	{ DA7219_DAC_L_GAIN_STATUS, DA7219_DAC_L_GAIN },
+	{ DA7219_DAC_R_GAIN_STATUS, DA7219_DAC_R_GAIN },
+	{ DA7219_HP_L_GAIN_STATUS, DA7219_HP_L_GAIN },
+	{ DA7219_HP_R_GAIN_STATUS, DA7219_HP_R_GAIN },
+};
+
+//Bit times of one transfer: START, device and register address, data, STOP,
+//plus the repeated start and device address of each read phase
+static uint64_t da7219_sim_bits(
+	BOOLEAN read,
+	ULONG count
+) {
+	uint64_t bits = 9ULL * (2 + count) + 2;
+	if (read) {
+		bits += 9 + 1;
+	}
+	return bits;
+}
+
+static VOID da7219_sim_charge(
+	_In_ PDA7219_SIM sim,
+	uint64_t bits
+) {
+	uint64_t ns = bits * 1000000000ULL / sim->BusHz + sim->TransactionOverheadNs;
+
+	sim->Stats.BusTimeNs += ns;
+	sim->NowNs += ns;
+}
+
+static VOID da7219_sim_log(
+	_In_ PDA7219_SIM sim,
+	BOOLEAN write,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count
+) {
+	if (sim->LogCount < DA7219_SIM_LOG_MAX) {
+		PDA7219_SIM_XFER xfer = &sim->Log[sim->LogCount];
+
+		xfer->Write = write;
+		xfer->Reg = reg;
+		xfer->Count = (USHORT)count;
+		RtlCopyMemory(xfer->Data, data, count < DA7219_SIM_LOG_DATA ? count : DA7219_SIM_LOG_DATA);
+	}
+	sim->LogCount++;
+}
+
+static UCHAR da7219_sim_get(
+	_In_ PDA7219_SIM sim,
+	uint8_t reg
+) {
+	switch (reg) {
+	case DA7219_SYSTEM_STATUS:
+		return sim->NowNs < sim->BusyUntilNs ? DA7219_SC1_BUSY_MASK : 0;
+	default:
+		return sim->Regs[reg];
+	}
+}
+
+static VOID da7219_sim_set(
+	_In_ PDA7219_SIM sim,
+	uint8_t reg,
+	uint8_t val
+) {
+	if (!(da7219_reg_info[reg].Flags & DA7219_REG_WRITABLE)) {
+		sim->DroppedWrites++;
+		return;
+	}
+
+	switch (reg) {
+	case DA7219_CIF_CTRL:
+		if (val & DA7219_CIF_REG_SOFT_RESET_MASK) {
+			UCHAR status_a = sim->Regs[DA7219_ACCDET_STATUS_A];
+			UCHAR status_b = sim->Regs[DA7219_ACCDET_STATUS_B];
+
+			//Registers go back to their defaults, the jack stays where it is
+			da7219_sim_reset(sim);
+			sim->Regs[DA7219_ACCDET_STATUS_A] = status_a;
+			sim->Regs[DA7219_ACCDET_STATUS_B] = status_b;
+			return;
+		}
+		break;
+
+	case DA7219_SYSTEM_MODES_INPUT:
+	case DA7219_SYSTEM_MODES_OUTPUT:
+		if (sim->SettleUs == DA7219_SIM_NEVER_SETTLES) {
+			sim->BusyUntilNs = (uint64_t)-1;
+		}
+		else {
+			sim->BusyUntilNs = sim->NowNs + (uint64_t)sim->SettleUs * 1000;
+		}
+		break;
+
+	case DA7219_ACCDET_IRQ_EVENT_A:
+	case DA7219_ACCDET_IRQ_EVENT_B:
+		//Write 1 to clear
+		sim->Regs[reg] &= ~val;
+		return;
+	}
+
+	sim->Regs[reg] = val;
+
+	for (ULONG i = 0; i < ARRAYSIZE(da7219_sim_gain_status); i++) {
+		if (da7219_sim_gain_status[i][1] == reg) {
+			sim->Regs[da7219_sim_gain_status[i][0]] = val;
+		}
+	}
+}
+
+static NTSTATUS da7219_sim_read(
+	PVOID Context,
+	uint8_t reg,
+	uint8_t* data,
+	ULONG count
+) {
+	PDA7219_SIM sim = (PDA7219_SIM)Context;
+
+	if (sim->SplitReads) {
+		//START, device and register address, STOP, then START, device address, data, STOP
+		da7219_sim_charge(sim, da7219_sim_bits(FALSE, 0));
+		da7219_sim_charge(sim, 9ULL * (1 + count) + 2);
+		sim->Stats.Writes++;
+	}
+	else {
+		da7219_sim_charge(sim, da7219_sim_bits(TRUE, count));
+	}
+
+	//Reads always auto-increment
+	for (ULONG i = 0; i < count; i++) {
+		data[i] = da7219_sim_get(sim, (uint8_t)(reg + i));
+	}
+
+	sim->Stats.Reads++;
+	sim->Stats.BytesRead += count;
+	da7219_sim_log(sim, FALSE, reg, data, count);
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS da7219_sim_read_ranges(
+	PVOID Context,
+	const DA7219_BUS_RANGE* ranges,
+	ULONG count
+) {
+	PDA7219_SIM sim = (PDA7219_SIM)Context;
+	uint64_t bits = 0;
+
+	//One transaction, each range its own address write and repeated start read
+	for (ULONG i = 0; i < count; i++) {
+		bits += da7219_sim_bits(TRUE, ranges[i].Count);
+	}
+	da7219_sim_charge(sim, bits);
+
+	sim->Stats.Reads++;
+	for (ULONG i = 0; i < count; i++) {
+		for (ULONG j = 0; j < ranges[i].Count; j++) {
+			ranges[i].Data[j] = da7219_sim_get(sim, (uint8_t)(ranges[i].Reg + j));
+		}
+		sim->Stats.BytesRead += ranges[i].Count;
+		da7219_sim_log(sim, FALSE, ranges[i].Reg, ranges[i].Data, ranges[i].Count);
+	}
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS da7219_sim_write(
+	PVOID Context,
+	uint8_t reg,
+	const uint8_t* data,
+	ULONG count
+) {
+	PDA7219_SIM sim = (PDA7219_SIM)Context;
+
+	da7219_sim_charge(sim, da7219_sim_bits(FALSE, count));
+
+	if (sim->Regs[DA7219_CIF_CTRL] & DA7219_CIF_I2C_WRITE_MODE_MASK) {
+		//Repeat mode: the first byte goes to reg, the rest are address/data pairs
+		if (count) {
+			da7219_sim_set(sim, reg, data[0]);
+		}
+		for (ULONG i = 1; i + 1 < count; i += 2) {
+			da7219_sim_set(sim, data[i], data[i + 1]);
+		}
+	}
+	else {
+		//Page mode: auto-increment
+		for (ULONG i = 0; i < count; i++) {
+			da7219_sim_set(sim, (uint8_t)(reg + i), data[i]);
+		}
+	}
+
+	sim->Stats.Writes++;
+	sim->Stats.BytesWritten += count;
+	da7219_sim_log(sim, TRUE, reg, data, count);
+	return STATUS_SUCCESS;
+}
+
+static VOID da7219_sim_delay(
+	PVOID Context,
+	ULONG ms
+) {
+	PDA7219_SIM sim = (PDA7219_SIM)Context;
+
+	sim->NowNs += (uint64_t)ms * 1000000;
+}
+
+static uint64_t da7219_sim_now(
+	PVOID Context
+) {
+	PDA7219_SIM sim = (PDA7219_SIM)Context;
+
+	return sim->NowNs / 1000;
+}
+
+//What da7219_sim_read or da7219_sim_write will charge for one transfer
+uint64_t da7219_sim_cost_ns(
+	_In_ PDA7219_SIM sim,
+	BOOLEAN read,
+	ULONG count
+) {
+	if (read && sim->SplitReads) {
+		return da7219_sim_bits(FALSE, 0) * 1000000000ULL / sim->BusHz +
+			(9ULL * (1 + count) + 2) * 1000000000ULL / sim->BusHz +
+			2ULL * sim->TransactionOverheadNs;
+	}
+	return da7219_sim_bits(read, count) * 1000000000ULL / sim->BusHz + sim->TransactionOverheadNs;
+}
+
+//Power-on reset: every register at its default, no jack, nothing latched
+VOID da7219_sim_reset(
+	_In_ PDA7219_SIM sim
+) {
+	for (ULONG reg = 0; reg < DA7219_REG_COUNT; reg++) {
+		sim->Regs[reg] = da7219_reg_info[reg].Default;
+	}
+	sim->BusyUntilNs = 0;
+}
+
+VOID da7219_sim_init(
+	_Out_ PDA7219_SIM sim
+) {
+	RtlZeroMemory(sim, sizeof(*sim));
+	sim->SettleUs = DA7219_SIM_SETTLE_US;
+	da7219_sim_set_cost(sim, DA7219_I2C_FAST_HZ, 0);
+	da7219_sim_reset(sim);
+}
+
+VOID da7219_sim_set_cost(
+	_In_ PDA7219_SIM sim,
+	ULONG busHz,
+	ULONG transactionOverheadNs
+) {
+	sim->BusHz = busHz ? busHz : DA7219_I2C_FAST_HZ;
+	sim->TransactionOverheadNs = transactionOverheadNs;
+}
+
+VOID da7219_sim_bus(
+	_In_ PDA7219_SIM sim,
+	_Out_ DA7219_BUS* bus
+) {
+	RtlZeroMemory(bus, sizeof(*bus));
+	bus->Context = sim;
+	bus->Read = da7219_sim_read;
+	bus->Write = da7219_sim_write;
+	bus->ReadRanges = da7219_sim_read_ranges;
+	bus->Delay = da7219_sim_delay;
+	bus->Now = da7219_sim_now;
+}
+
+VOID da7219_sim_stats(
+	_In_ PDA7219_SIM sim,
+	_Out_ PDA7219_BUS_STATS stats,
+	BOOLEAN reset
+) {
+	*stats = sim->Stats;
+	if (reset) {
+		RtlZeroMemory(&sim->Stats, sizeof(sim->Stats));
+		sim->LogCount = 0;
+	}
+}
+
+VOID da7219_sim_jack_insert(
+	_In_ PDA7219_SIM sim
+) {
+	sim->Regs[DA7219_ACCDET_STATUS_A] |= DA7219_JACK_INSERTION_STS_MASK;
+	sim->Regs[DA7219_ACCDET_IRQ_EVENT_A] |= DA7219_E_JACK_INSERTED_MASK;
+}
+
+//Type detection finished on an inserted jack, headsets also bring MICBIAS up
+VOID da7219_sim_jack_detect(
+	_In_ PDA7219_SIM sim,
+	BOOLEAN headset
+) {
+	if (headset) {
+		sim->Regs[DA7219_ACCDET_STATUS_A] |= DA7219_JACK_TYPE_STS_MASK | DA7219_MICBIAS_UP_STS_MASK;
+	}
+	sim->Regs[DA7219_ACCDET_IRQ_EVENT_A] |= DA7219_E_JACK_DETECT_COMPLETE_MASK;
+}
+
+VOID da7219_sim_jack_remove(
+	_In_ PDA7219_SIM sim
+) {
+	sim->Regs[DA7219_ACCDET_STATUS_A] = 0;
+	sim->Regs[DA7219_ACCDET_STATUS_B] = 0;
+	sim->Regs[DA7219_ACCDET_IRQ_EVENT_A] |= DA7219_E_JACK_REMOVED_MASK;
+}
+
+//Buttons A to D are 0 to 3, press events count up from bit 0 and release events down from bit 7
+VOID da7219_sim_button(
+	_In_ PDA7219_SIM sim,
+	ULONG button,
+	BOOLEAN pressed
+) {
+	if (pressed) {
+		sim->Regs[DA7219_ACCDET_STATUS_B] = (UCHAR)(1 << button);
+		sim->Regs[DA7219_ACCDET_IRQ_EVENT_B] |= DA7219_E_BUTTON_A_PRESSED_MASK << button;
+	}
+	else {
+		sim->Regs[DA7219_ACCDET_STATUS_B] = 0;
+		sim->Regs[DA7219_ACCDET_IRQ_EVENT_B] |= DA7219_E_BUTTON_A_RELEASED_MASK >> button;
+	}
+}
+
+BOOLEAN da7219_sim_irq_asserted(
+	_In_ PDA7219_SIM sim
+) {
+	return (sim->Regs[DA7219_ACCDET_IRQ_EVENT_A] & ~sim->Regs[DA7219_ACCDET_IRQ_MASK_A]) != 0 ||
+		(sim->Regs[DA7219_ACCDET_IRQ_EVENT_B] & ~sim->Regs[DA7219_ACCDET_IRQ_MASK_B]) != 0;
+}
@@ -0,0 +1,94 @@
+#if !defined(_DA7219_SIM_H_)
+#define _DA7219_SIM_H_
+
+//
+// Behavioral DA7219 for host builds of the codec core, behind a DA7219_BUS.
+//
+// The register file starts from the reset defaults in da7219_reg_info.
+// Writes to read-only or unmapped addresses are dropped, and the registers
+// the codec owns are driven by the model:
+//   - SYSTEM_STATUS reads busy for SettleUs after a SYSTEM_MODES_INPUT or
+//     SYSTEM_MODES_OUTPUT write, the wait the boot polls through
+//   - CIF_CTRL soft reset restores the defaults and clears itself
+//   - ACCDET_STATUS_A/B follow the jack, the da7219_sim_jack_* and
+//     da7219_sim_button calls latch ACCDET_IRQ_EVENT_A/B bits, writing 1 to
+//     an event bit clears it, and the level triggered interrupt line is up
+//     while any unmasked event is latched
+//   - the *_GAIN_STATUS registers follow their gain registers
+// Every transfer is charged its bit times at BusHz plus a per-transaction
+// overhead, and simulated time advances by that and by Delay only.
+//
+
+#include "codec.h"
+
+#define DA7219_SIM_SETTLE_US       4000 // default SYSTEM_STATUS settle after a mode change
+#define DA7219_SIM_NEVER_SETTLES   ((ULONG)-1)
+
+#define DA7219_SIM_LOG_MAX         1024
+#define DA7219_SIM_LOG_DATA        32
+
+typedef struct _DA7219_SIM_XFER
+{
+	BOOLEAN Write;
+
+	UCHAR Reg;
+
+	USHORT Count;
+
+	UCHAR Data[DA7219_SIM_LOG_DATA]; // first DA7219_SIM_LOG_DATA bytes moved
+
+} DA7219_SIM_XFER, *PDA7219_SIM_XFER;
+
+typedef struct _DA7219_SIM
+{
+	UCHAR Regs[DA7219_REG_COUNT];
+
+	uint64_t NowNs; // simulated time, the bus Now hook returns it in microseconds
+
+	ULONG SettleUs;
+
+	uint64_t BusyUntilNs; // SYSTEM_STATUS reads busy until then
+
+	ULONG BusHz;
+
+	ULONG TransactionOverheadNs;
+
+	BOOLEAN SplitReads; // charge each read as an address write and a separate read, as SPB did before write-read sequences
+
+	DA7219_BUS_STATS Stats; // counted by the bus, a ReadRanges transfer is one read
+
+	ULONG DroppedWrites; // bytes written to read-only or unmapped addresses
+
+	ULONG LogCount; // every transfer since the last da7219_sim_stats reset, may exceed the log
+
+	DA7219_SIM_XFER Log[DA7219_SIM_LOG_MAX];
+
+} DA7219_SIM, *PDA7219_SIM;
+
+VOID da7219_sim_init(_Out_ PDA7219_SIM sim);
+
+VOID da7219_sim_reset(_In_ PDA7219_SIM sim);
+
+VOID da7219_sim_set_cost(_In_ PDA7219_SIM sim, ULONG busHz, ULONG transactionOverheadNs);
+
+VOID da7219_sim_bus(_In_ PDA7219_SIM sim, _Out_ DA7219_BUS* bus);
+
+VOID da7219_sim_stats(_In_ PDA7219_SIM sim, _Out_ PDA7219_BUS_STATS stats, BOOLEAN reset);
+
+uint64_t da7219_sim_cost_ns(_In_ PDA7219_SIM sim, BOOLEAN read, ULONG count);
+
+//
+// Accessory events
+//
+
+VOID da7219_sim_jack_insert(_In_ PDA7219_SIM sim);
+
+VOID da7219_sim_jack_detect(_In_ PDA7219_SIM sim, BOOLEAN headset);
+
+VOID da7219_sim_jack_remove(_In_ PDA7219_SIM sim);
+
+VOID da7219_sim_button(_In_ PDA7219_SIM sim, ULONG button, BOOLEAN pressed);
+
+BOOLEAN da7219_sim_irq_asserted(_In_ PDA7219_SIM sim);
+
+#endif
@@ -0,0 +1,48 @@
+#include "sim.h"
+#include "registers.h"
+#include "check.h"
+
+//Cold boot, suspend and resume against the simulated bus, with the core's
+//own bus accounting checked against what the bus actually saw
+int main(void) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	DA7219_CODEC codec;
+	DA7219_BUS_STATS seen, counted;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+	da7219_codec_init(&codec, &bus);
+
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	CHECK_EQ(codec.BootState, BootStateIdle);
+	CHECK(codec.RegImageSaved);
+	CHECK(!codec.BootResume);
+	CHECK_EQ(sim.Regs[DA7219_SYSTEM_ACTIVE], DA7219_SYSTEM_ACTIVE_MASK);
+
+	da7219_sim_stats(&sim, &seen, TRUE);
+	da7219_bus_stats(&codec, &counted, TRUE);
+	CHECK(seen.Reads + seen.Writes > 0);
+	CHECK_EQ(counted.Reads, seen.Reads);
+	CHECK_EQ(counted.Writes, seen.Writes);
+	CHECK_EQ(counted.BytesRead, seen.BytesRead);
+	CHECK_EQ(counted.BytesWritten, seen.BytesWritten);
+	ULONG cold = seen.Reads + seen.Writes;
+
+	CHECK_EQ(da7219_suspend_blocking(&codec), STATUS_SUCCESS);
+	CHECK_EQ(sim.Regs[DA7219_REFERENCES] & DA7219_BIAS_EN_MASK, 0);
+	da7219_sim_stats(&sim, &seen, TRUE);
+	da7219_bus_stats(&codec, &counted, TRUE);
+
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	CHECK(codec.BootResume);
+	CHECK_EQ(sim.Regs[DA7219_REFERENCES] & DA7219_BIAS_EN_MASK, DA7219_BIAS_EN_MASK);
+
+	da7219_sim_stats(&sim, &seen, TRUE);
+	da7219_bus_stats(&codec, &counted, TRUE);
+	CHECK_EQ(counted.Reads, seen.Reads);
+	CHECK_EQ(counted.Writes, seen.Writes);
+	CHECK(seen.Reads + seen.Writes < cold);
+
+	return CHECK_EXIT();
+}
@@ -0,0 +1,152 @@
+#include "sim.h"
+#include "registers.h"
+#include "registers-aad.h"
+#include "check.h"
+
+//Contiguous ranges the boot and interrupt paths move together
+static const struct {
+	uint8_t Reg;
+	ULONG Count;
+} ranges[] = {
+	{ DA7219_PLL_FRAC_TOP, 3 },
+	{ DA7219_HP_L_GAIN, 2 },
+	{ DA7219_ACCDET_STATUS_A, 4 },
+	{ DA7219_ACCDET_CONFIG_3, 4 },
+};
+
+static ULONG transactions(PDA7219_SIM sim) {
+	return sim->Stats.Reads + sim->Stats.Writes;
+}
+
+//Register by register costs one transaction per register, a burst costs one per range
+static VOID test_ranges(VOID) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	DA7219_CODEC codec;
+	uint8_t single[4], burst[4];
+	ULONG registers = 0;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+
+	for (ULONG i = 0; i < ARRAYSIZE(ranges); i++) {
+		uint8_t reg = ranges[i].Reg;
+		ULONG count = ranges[i].Count;
+
+		da7219_codec_init(&codec, &bus);
+		for (ULONG j = 0; j < count; j++) {
+			unsigned int value;
+			da7219_reg_read(&codec, (uint8_t)(reg + j), &value);
+			single[j] = (uint8_t)value;
+		}
+		CHECK_EQ(transactions(&sim), registers + count);
+
+		da7219_codec_init(&codec, &bus);
+		CHECK_EQ(da7219_reg_bulk_read(&codec, reg, burst, count), STATUS_SUCCESS);
+		CHECK_EQ(transactions(&sim), registers + count + 1);
+		CHECK(memcmp(single, burst, count) == 0);
+
+		registers += count + 1;
+	}
+
+	//Writes, on the writable ranges
+	uint8_t gains[2] = { 0x30, 0x31 };
+	da7219_sim_stats(&sim, &(DA7219_BUS_STATS){ 0 }, TRUE);
+	da7219_reg_write(&codec, DA7219_HP_L_GAIN, gains[0]);
+	da7219_reg_write(&codec, DA7219_HP_R_GAIN, gains[1]);
+	CHECK_EQ(transactions(&sim), 2);
+	da7219_reg_bulk_write(&codec, DA7219_HP_L_GAIN, gains, sizeof(gains));
+	CHECK_EQ(transactions(&sim), 3);
+	CHECK_EQ(sim.Regs[DA7219_HP_R_GAIN], 0x31);
+
+	uint8_t thresholds[4] = { 0x0A, 0x16, 0x21, 0x3E };
+	da7219_reg_bulk_write(&codec, DA7219_ACCDET_CONFIG_3, thresholds, sizeof(thresholds));
+	CHECK_EQ(transactions(&sim), 4);
+	CHECK(memcmp(&sim.Regs[DA7219_ACCDET_CONFIG_3], thresholds, sizeof(thresholds)) == 0);
+}
+
+static NTSTATUS failing_write(PVOID Context, uint8_t reg, const uint8_t* data, ULONG count) {
+	UNREFERENCED_PARAMETER(Context);
+	UNREFERENCED_PARAMETER(reg);
+	UNREFERENCED_PARAMETER(data);
+	UNREFERENCED_PARAMETER(count);
+	return STATUS_INVALID_DEVICE_STATE;
+}
+
+//Acknowledging a jack event is one burst read and one burst write, the line drops after it
+static VOID test_irq(VOID) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	DA7219_CODEC codec;
+	DA7219_IRQ_RECORD record;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+	da7219_codec_init(&codec, &bus);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	da7219_sim_stats(&sim, &(DA7219_BUS_STATS){ 0 }, TRUE);
+	DA7219_BUS_STATS booted = codec.BusStats;
+
+	da7219_sim_jack_insert(&sim);
+	da7219_sim_jack_detect(&sim, FALSE);
+	CHECK(da7219_sim_irq_asserted(&sim));
+	CHECK_EQ(da7219_codec_irq_ack(&codec, &record), STATUS_SUCCESS);
+	CHECK_EQ(record.EventA, DA7219_E_JACK_INSERTED_MASK | DA7219_E_JACK_DETECT_COMPLETE_MASK);
+	CHECK(!da7219_sim_irq_asserted(&sim));
+	CHECK_EQ(sim.Stats.Reads, 1);
+	CHECK_EQ(sim.Stats.Writes, 1);
+	CHECK_EQ(sim.Stats.BytesRead + sim.Stats.BytesWritten, 6);
+
+	//The acknowledge is charged apart from the rest of the core
+	CHECK(memcmp(&codec.BusStats, &booted, sizeof(booted)) == 0);
+	CHECK_EQ(codec.IrqBusStats.Reads, 1);
+	CHECK_EQ(codec.IrqBusStats.Writes, 1);
+	CHECK_EQ(codec.Scenarios[Da7219ScenarioInsert].Runs, 1);
+
+	//A reset leaves the acknowledge's own counters alone and counts from there
+	DA7219_BUS_STATS total;
+	da7219_bus_stats(&codec, &total, TRUE);
+	CHECK_EQ(codec.IrqBusStats.Reads, 1);
+	da7219_sim_jack_remove(&sim);
+	CHECK_EQ(da7219_codec_irq_ack(&codec, &record), STATUS_SUCCESS);
+	da7219_bus_stats(&codec, &total, FALSE);
+	CHECK_EQ(total.Reads, 1);
+	CHECK_EQ(total.Writes, 1);
+	da7219_sim_jack_insert(&sim);
+	da7219_sim_jack_detect(&sim, FALSE);
+	CHECK_EQ(da7219_codec_irq_ack(&codec, &record), STATUS_SUCCESS);
+
+	//A clear that fails is reported and leaves the events for the next interrupt
+	da7219_sim_jack_remove(&sim);
+	codec.Bus.Write = failing_write;
+	CHECK_EQ(da7219_codec_irq_ack(&codec, &record), STATUS_INVALID_DEVICE_STATE);
+	CHECK(da7219_sim_irq_asserted(&sim));
+	codec.Bus.Write = bus.Write;
+	CHECK_EQ(da7219_codec_irq_ack(&codec, &record), STATUS_SUCCESS);
+	CHECK_EQ(record.EventA, DA7219_E_JACK_REMOVED_MASK);
+	CHECK(!da7219_sim_irq_asserted(&sim));
+}
+
+//Sequence tables merge neighbouring writes, so a cold boot writes more registers than it has write transactions
+static VOID test_boot(VOID) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	DA7219_CODEC codec;
+	DA7219_BUS_STATS stats;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+	da7219_codec_init(&codec, &bus);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	da7219_sim_stats(&sim, &stats, TRUE);
+	CHECK(stats.Writes < stats.BytesWritten);
+
+	printf("cold boot: %u registers written in %u transactions\n", stats.BytesWritten, stats.Writes);
+}
+
+int main(void) {
+	test_ranges();
+	test_irq();
+	test_boot();
+	return CHECK_EXIT();
+}
@@ -0,0 +1,315 @@
+#include "sim.h"
+#include "registers.h"
+#include "registers-aad.h"
+#include "check.h"
+
+static DA7219_SIM sim;
+static DA7219_BUS bus;
+static DA7219_CODEC codec;
+
+//Checks logged transfer i is a write of count registers from reg
+static VOID check_write(ULONG i, uint8_t reg, ULONG count) {
+	CHECK(i < sim.LogCount);
+	CHECK(sim.Log[i].Write);
+	CHECK_EQ(sim.Log[i].Reg, reg);
+	CHECK_EQ(sim.Log[i].Count, count);
+}
+
+static VOID reset_log(VOID) {
+	da7219_sim_stats(&sim, &(DA7219_BUS_STATS){ 0 }, TRUE);
+}
+
+static NTSTATUS failing_read(PVOID Context, uint8_t reg, uint8_t* data, ULONG count) {
+	UNREFERENCED_PARAMETER(Context);
+	UNREFERENCED_PARAMETER(reg);
+	UNREFERENCED_PARAMETER(data);
+	UNREFERENCED_PARAMETER(count);
+	return STATUS_INVALID_DEVICE_STATE;
+}
+
+//Boots for an audio stack that reports its streams, with none running yet
+static VOID boot(VOID) {
+	ULONG delay;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+	da7219_codec_init(&codec, &bus);
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_STREAMS, FALSE, &delay), STATUS_SUCCESS);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	reset_log();
+}
+
+//Playback comes up supplies first, one burst per stage, the HP amps at minimum gain until
+//they settle. It goes down outputs first, dropping to minimum gain before the amps switch off.
+static VOID test_playback_order(VOID) {
+	const UCHAR hpOn = DA7219_HP_L_AMP_EN_MASK | DA7219_HP_L_AMP_OE_MASK;
+	ULONG delay;
+
+	boot();
+
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, TRUE, &delay), STATUS_PENDING);
+	CHECK_EQ(delay, DA7219_SETTLING_DELAY);
+	CHECK_EQ(sim.LogCount, 4);
+	check_write(0, DA7219_CP_CTRL, 1);
+	CHECK(sim.Log[0].Data[0] & DA7219_CP_EN_MASK);
+	check_write(1, DA7219_DAC_L_CTRL, 2);
+	CHECK(sim.Log[1].Data[0] & DA7219_DAC_L_EN_MASK);
+	CHECK(sim.Log[1].Data[1] & DA7219_DAC_R_EN_MASK);
+	check_write(2, DA7219_MIXOUT_L_CTRL, 2);
+	CHECK(sim.Log[2].Data[0] & DA7219_MIXOUT_L_AMP_EN_MASK);
+	CHECK(sim.Log[2].Data[1] & DA7219_MIXOUT_R_AMP_EN_MASK);
+	check_write(3, DA7219_HP_L_CTRL, 2);
+	CHECK_EQ(sim.Log[3].Data[0] & (hpOn | DA7219_HP_L_AMP_MIN_GAIN_EN_MASK), hpOn | DA7219_HP_L_AMP_MIN_GAIN_EN_MASK);
+	CHECK_EQ(sim.Log[3].Data[1] & (hpOn | DA7219_HP_R_AMP_MIN_GAIN_EN_MASK), hpOn | DA7219_HP_R_AMP_MIN_GAIN_EN_MASK);
+
+	//Nothing more goes out until the amps have settled
+	bus.Delay(bus.Context, DA7219_SETTLING_DELAY - 1);
+	CHECK_EQ(da7219_dapm_advance(&codec, &delay), STATUS_PENDING);
+	CHECK_EQ(delay, 1);
+	CHECK_EQ(sim.LogCount, 4);
+	bus.Delay(bus.Context, delay);
+	CHECK_EQ(da7219_dapm_advance(&codec, &delay), STATUS_SUCCESS);
+	CHECK_EQ(sim.LogCount, 5);
+	check_write(4, DA7219_HP_L_CTRL, 2);
+	CHECK_EQ(sim.Log[4].Data[0] & (hpOn | DA7219_HP_L_AMP_MIN_GAIN_EN_MASK), hpOn);
+	CHECK_EQ(sim.Log[4].Data[1] & (hpOn | DA7219_HP_R_AMP_MIN_GAIN_EN_MASK), hpOn);
+	CHECK_EQ(sim.Stats.Reads, 0);
+
+	//Already running, no traffic
+	reset_log();
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, TRUE, &delay), STATUS_SUCCESS);
+	CHECK_EQ(sim.LogCount, 0);
+
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, FALSE, &delay), STATUS_PENDING);
+	CHECK_EQ(delay, DA7219_MIN_GAIN_DELAY);
+	CHECK_EQ(sim.LogCount, 1);
+	check_write(0, DA7219_HP_L_CTRL, 2);
+	CHECK_EQ(sim.Log[0].Data[0] & (hpOn | DA7219_HP_L_AMP_MIN_GAIN_EN_MASK), hpOn | DA7219_HP_L_AMP_MIN_GAIN_EN_MASK);
+	CHECK_EQ(sim.Log[0].Data[1] & (hpOn | DA7219_HP_R_AMP_MIN_GAIN_EN_MASK), hpOn | DA7219_HP_R_AMP_MIN_GAIN_EN_MASK);
+
+	bus.Delay(bus.Context, delay);
+	CHECK_EQ(da7219_dapm_advance(&codec, &delay), STATUS_SUCCESS);
+	CHECK_EQ(sim.LogCount, 5);
+	check_write(1, DA7219_HP_L_CTRL, 2);
+	CHECK_EQ(sim.Log[1].Data[0] & hpOn, 0);
+	CHECK_EQ(sim.Log[1].Data[1] & hpOn, 0);
+	check_write(2, DA7219_MIXOUT_L_CTRL, 2);
+	check_write(3, DA7219_DAC_L_CTRL, 2);
+	check_write(4, DA7219_CP_CTRL, 1);
+	CHECK_EQ(sim.Log[4].Data[0] & DA7219_CP_EN_MASK, 0);
+	CHECK_EQ(codec.WidgetsOn, 0);
+}
+
+//Capture has no amp to settle and goes through in one call. MICBIAS and the mic PGA sit in
+//neighbouring registers and share a burst, supply byte first.
+static VOID test_capture_order(VOID) {
+	ULONG delay;
+
+	boot();
+
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_CAPTURE, TRUE, &delay), STATUS_SUCCESS);
+	CHECK_EQ(sim.LogCount, 3);
+	check_write(0, DA7219_MICBIAS_CTRL, 2);
+	CHECK_EQ(DA7219_MICBIAS_CTRL + 1, DA7219_MIC_1_CTRL);
+	CHECK(sim.Log[0].Data[0] & DA7219_MICBIAS1_EN_MASK);
+	CHECK(sim.Log[0].Data[1] & DA7219_MIC_1_AMP_EN_MASK);
+	check_write(1, DA7219_MIXIN_L_CTRL, 1);
+	check_write(2, DA7219_ADC_L_CTRL, 1);
+	CHECK(sim.Log[2].Data[0] & DA7219_ADC_L_EN_MASK);
+
+	reset_log();
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_CAPTURE, FALSE, &delay), STATUS_SUCCESS);
+	CHECK_EQ(sim.LogCount, 4);
+	check_write(0, DA7219_ADC_L_CTRL, 1);
+	check_write(1, DA7219_MIXIN_L_CTRL, 1);
+	check_write(2, DA7219_MIC_1_CTRL, 1);
+	check_write(3, DA7219_MICBIAS_CTRL, 1);
+	CHECK_EQ(sim.Log[3].Data[0] & DA7219_MICBIAS1_EN_MASK, 0);
+}
+
+//A headset holds MICBIAS for its buttons, capture stopping leaves it up
+static VOID test_headset_micbias(VOID) {
+	DA7219_IRQ_EVENTS events;
+	ULONG delay;
+
+	boot();
+
+	da7219_sim_jack_insert(&sim);
+	da7219_sim_jack_detect(&sim, TRUE);
+	CHECK_EQ(da7219_codec_irq(&codec, &events), STATUS_SUCCESS);
+	CHECK_EQ(sim.LogCount, 3);
+	check_write(2, DA7219_MICBIAS_CTRL, 1);
+	CHECK(sim.Log[2].Data[0] & DA7219_MICBIAS1_EN_MASK);
+
+	reset_log();
+	da7219_codec_stream(&codec, DA7219_PATH_CAPTURE, TRUE, &delay);
+	CHECK_EQ(sim.LogCount, 3);
+	check_write(0, DA7219_MIC_1_CTRL, 1);
+
+	reset_log();
+	da7219_codec_stream(&codec, DA7219_PATH_CAPTURE, FALSE, &delay);
+	CHECK_EQ(sim.LogCount, 3);
+	check_write(2, DA7219_MIC_1_CTRL, 1);
+	CHECK(sim.Regs[DA7219_MICBIAS_CTRL] & DA7219_MICBIAS1_EN_MASK);
+
+	reset_log();
+	da7219_sim_jack_remove(&sim);
+	CHECK_EQ(da7219_codec_irq(&codec, &events), STATUS_SUCCESS);
+	CHECK_EQ(sim.LogCount, 3);
+	check_write(2, DA7219_MICBIAS_CTRL, 1);
+	CHECK_EQ(sim.Regs[DA7219_MICBIAS_CTRL] & DA7219_MICBIAS1_EN_MASK, 0);
+}
+
+//A stream change starts the plan and hands its waits back instead of sleeping through them
+static VOID test_pending(VOID) {
+	uint64_t start;
+	ULONG delay;
+
+	boot();
+	start = sim.NowNs;
+
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, TRUE, &delay), STATUS_PENDING);
+	CHECK_EQ(delay, DA7219_SETTLING_DELAY);
+	CHECK(codec.DapmRunning);
+	CHECK(sim.NowNs - start < 1000000);
+
+	//Calling back early only gets what is left of the wait
+	CHECK_EQ(da7219_dapm_advance(&codec, &delay), STATUS_PENDING);
+	CHECK(delay > 0 && delay <= DA7219_SETTLING_DELAY);
+
+	//A change while the plan waits is picked up once it is through
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_CAPTURE, TRUE, &delay), STATUS_SUCCESS);
+	CHECK_EQ(delay, 0);
+
+	bus.Delay(bus.Context, DA7219_SETTLING_DELAY);
+	CHECK_EQ(da7219_dapm_advance(&codec, &delay), STATUS_SUCCESS);
+	CHECK(!codec.DapmRunning);
+	CHECK_EQ(codec.WidgetsOn, da7219_dapm_wanted(&codec));
+	CHECK(codec.WidgetsOn & DA7219_WIDGET_BIT(Da7219WidgetHpL));
+	CHECK(codec.WidgetsOn & DA7219_WIDGET_BIT(Da7219WidgetAdcL));
+}
+
+//Suspend waits out the power down through its caller and charges only the standby writes
+static VOID test_suspend(VOID) {
+	DA7219_BUS_STATS idle;
+	ULONG delay;
+
+	boot();
+	CHECK_EQ(da7219_suspend_blocking(&codec), STATUS_SUCCESS);
+	idle = codec.Scenarios[Da7219ScenarioSuspend].Last;
+
+	boot();
+	da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, TRUE, &delay);
+	CHECK_EQ(da7219_dapm_blocking(&codec), STATUS_SUCCESS);
+
+	CHECK_EQ(da7219_codec_suspend(&codec, &delay), STATUS_PENDING);
+	CHECK_EQ(delay, DA7219_MIN_GAIN_DELAY);
+	CHECK_EQ(da7219_codec_suspend(&codec, &delay), STATUS_PENDING);
+	bus.Delay(bus.Context, delay);
+	CHECK_EQ(da7219_codec_suspend(&codec, &delay), STATUS_SUCCESS);
+
+	CHECK_EQ(codec.WidgetsOn, 0);
+	CHECK_EQ(codec.Scenarios[Da7219ScenarioSuspend].Last.Writes, idle.Writes);
+	CHECK_EQ(codec.Scenarios[Da7219ScenarioSuspend].Last.BytesWritten, idle.BytesWritten);
+}
+
+//Resume completes with every path off, the running streams come back after it
+static VOID test_resume(VOID) {
+	DA7219_BUS_STATS idle;
+	ULONG delay;
+
+	boot();
+	CHECK_EQ(da7219_suspend_blocking(&codec), STATUS_SUCCESS);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	idle = codec.Scenarios[Da7219ScenarioResumeWarm].Last;
+
+	da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, TRUE, &delay);
+	CHECK_EQ(da7219_dapm_blocking(&codec), STATUS_SUCCESS);
+	CHECK_EQ(da7219_suspend_blocking(&codec), STATUS_SUCCESS);
+
+	da7219_boot_start(&codec, PlatformIntel);
+	while (da7219_boot_advance(&codec, &delay) == STATUS_PENDING) {
+		bus.Delay(bus.Context, delay);
+	}
+	CHECK_EQ(codec.WidgetsOn, 0);
+	CHECK_EQ(codec.Scenarios[Da7219ScenarioResumeWarm].Last.Reads, idle.Reads);
+	CHECK_EQ(codec.Scenarios[Da7219ScenarioResumeWarm].Last.Writes, idle.Writes);
+
+	CHECK_EQ(da7219_dapm_advance(&codec, &delay), STATUS_PENDING);
+	CHECK_EQ(da7219_dapm_blocking(&codec), STATUS_SUCCESS);
+	CHECK_EQ(codec.WidgetsOn, da7219_dapm_wanted(&codec));
+
+	//A boot drops a plan left waiting, the codec is reset under it
+	da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, FALSE, &delay);
+	CHECK(codec.DapmRunning);
+	da7219_boot_start(&codec, PlatformIntel);
+	CHECK(!codec.DapmRunning);
+	CHECK_EQ(codec.WidgetsOn, 0);
+}
+
+//An audio stack that never reports streams still gets headphones and the mic in D0,
+//until its first report hands path power over to it
+static VOID test_default_streams(VOID) {
+	const USHORT playback = DA7219_WIDGET_BIT(Da7219WidgetHpL) | DA7219_WIDGET_BIT(Da7219WidgetHpR) |
+		DA7219_WIDGET_BIT(Da7219WidgetDacL) | DA7219_WIDGET_BIT(Da7219WidgetCp);
+	const USHORT capture = DA7219_WIDGET_BIT(Da7219WidgetAdcL) | DA7219_WIDGET_BIT(Da7219WidgetMic1) |
+		DA7219_WIDGET_BIT(Da7219WidgetMicBias);
+	ULONG delay;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+	da7219_codec_init(&codec, &bus);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	CHECK_EQ(codec.WidgetsOn & (playback | capture), playback | capture);
+	CHECK(sim.Regs[DA7219_HP_L_CTRL] & DA7219_HP_L_AMP_EN_MASK);
+	CHECK(sim.Regs[DA7219_ADC_L_CTRL] & DA7219_ADC_L_EN_MASK);
+	CHECK(sim.Regs[DA7219_MICBIAS_CTRL] & DA7219_MICBIAS1_EN_MASK);
+
+	//Back up the same way after a resume
+	CHECK_EQ(da7219_suspend_blocking(&codec), STATUS_SUCCESS);
+	CHECK_EQ(codec.WidgetsOn, 0);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	CHECK_EQ(codec.WidgetsOn & (playback | capture), playback | capture);
+
+	//The first report leaves only what it names running
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, TRUE, &delay), STATUS_SUCCESS);
+	CHECK_EQ(codec.WidgetsOn & playback, playback);
+	CHECK_EQ(codec.WidgetsOn & capture, 0);
+	CHECK(!(sim.Regs[DA7219_ADC_L_CTRL] & DA7219_ADC_L_EN_MASK));
+}
+
+//A widget register that cannot be read leaves the codec alone, ramp and gain bits included,
+//and the next request plans again from the top
+static VOID test_plan_read_failure(VOID) {
+	const UCHAR switched = DA7219_HP_L_AMP_EN_MASK | DA7219_HP_L_AMP_OE_MASK | DA7219_HP_L_AMP_MIN_GAIN_EN_MASK;
+	UCHAR hpCtrl;
+	ULONG delay;
+
+	boot();
+	hpCtrl = sim.Regs[DA7219_HP_L_CTRL];
+
+	codec.RegCacheValid[DA7219_HP_L_CTRL] = FALSE;
+	codec.Bus.Read = failing_read;
+	CHECK_EQ(da7219_codec_stream(&codec, DA7219_PATH_PLAYBACK, TRUE, &delay), STATUS_INVALID_DEVICE_STATE);
+	CHECK_EQ(sim.Stats.Writes, 0);
+	CHECK(!codec.DapmRunning);
+	CHECK_EQ(codec.WidgetsOn, 0);
+
+	codec.Bus.Read = bus.Read;
+	CHECK_EQ(da7219_dapm_blocking(&codec), STATUS_SUCCESS);
+	CHECK_EQ(codec.WidgetsOn, da7219_dapm_wanted(&codec));
+	CHECK_EQ(sim.Regs[DA7219_HP_L_CTRL] & ~switched, hpCtrl & ~switched);
+	CHECK(sim.Regs[DA7219_HP_L_CTRL] & DA7219_HP_L_AMP_RAMP_EN_MASK);
+}
+
+int main(void) {
+	test_default_streams();
+	test_playback_order();
+	test_capture_order();
+	test_headset_micbias();
+	test_plan_read_failure();
+	test_pending();
+	test_suspend();
+	test_resume();
+	return CHECK_EXIT();
+}
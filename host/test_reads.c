@@ -0,0 +1,74 @@
+#include "sim.h"
+#include "registers.h"
+#include "registers-aad.h"
+#include "check.h"
+
+static ULONG transactions(PDA7219_SIM sim) {
+	return sim->Stats.Reads + sim->Stats.Writes;
+}
+
+//Every register read is one write-read transaction on the bus, whatever its length
+static VOID test_single(VOID) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	DA7219_CODEC codec;
+	unsigned int value;
+	uint8_t accdet[4];
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+	da7219_codec_init(&codec, &bus);
+
+	CHECK_EQ(da7219_reg_read(&codec, DA7219_SR, &value), STATUS_SUCCESS);
+	CHECK_EQ(value, 0x0A);
+	CHECK_EQ(transactions(&sim), 1);
+
+	//Cached now
+	da7219_reg_read(&codec, DA7219_SR, &value);
+	CHECK_EQ(transactions(&sim), 1);
+
+	//Volatile, never cached
+	da7219_reg_read(&codec, DA7219_SYSTEM_STATUS, &value);
+	da7219_reg_read(&codec, DA7219_SYSTEM_STATUS, &value);
+	CHECK_EQ(transactions(&sim), 3);
+
+	da7219_reg_bulk_read(&codec, DA7219_ACCDET_STATUS_A, accdet, sizeof(accdet));
+	CHECK_EQ(transactions(&sim), 4);
+	CHECK_EQ(sim.Stats.Writes, 0);
+}
+
+//A cold boot moves the same reads in half the transactions a split address write and read would need
+static VOID test_boot(VOID) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	DA7219_CODEC codec;
+	DA7219_BUS_STATS combined, split, counted;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+	da7219_codec_init(&codec, &bus);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	da7219_sim_stats(&sim, &combined, TRUE);
+	da7219_bus_stats(&codec, &counted, TRUE);
+	CHECK(combined.Reads > 0);
+	CHECK_EQ(combined.Reads, counted.Reads);
+	CHECK_EQ(combined.Writes, counted.Writes);
+
+	da7219_sim_init(&sim);
+	sim.SplitReads = TRUE;
+	da7219_codec_init(&codec, &bus);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	da7219_sim_stats(&sim, &split, TRUE);
+	CHECK_EQ(split.Reads, combined.Reads);
+	CHECK_EQ(split.Writes, combined.Writes + combined.Reads);
+	CHECK(split.BusTimeNs > combined.BusTimeNs);
+
+	printf("cold boot: %u transactions with write-read sequences, %u with split reads\n",
+		combined.Reads + combined.Writes, split.Reads + split.Writes);
+}
+
+int main(void) {
+	test_single();
+	test_boot();
+	return CHECK_EXIT();
+}
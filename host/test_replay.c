@@ -0,0 +1,162 @@
+#include "replay.h"
+#include "registers.h"
+#include "registers-aad.h"
+#include "check.h"
+
+static DA7219_SIM sim;
+static DA7219_CAPTURE_WRITER writer;
+static DA7219_CODEC codec;
+
+//Records a session on the simulator: cold boot, suspend and resume, then
+//optionally a headset going in and out
+static VOID record(BOOLEAN jack) {
+	DA7219_BUS simBus, bus;
+	DA7219_IRQ_EVENTS events;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &simBus);
+	da7219_capture_writer_init(&writer, &simBus);
+	da7219_capture_writer_bus(&writer, &bus);
+	da7219_codec_init(&codec, &bus);
+
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	CHECK_EQ(da7219_suspend_blocking(&codec), STATUS_SUCCESS);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+
+	if (jack) {
+		da7219_sim_jack_insert(&sim);
+		CHECK_EQ(da7219_codec_irq(&codec, &events), STATUS_SUCCESS);
+		da7219_sim_jack_detect(&sim, TRUE);
+		CHECK_EQ(da7219_codec_irq(&codec, &events), STATUS_SUCCESS);
+		da7219_sim_jack_remove(&sim);
+		CHECK_EQ(da7219_codec_irq(&codec, &events), STATUS_SUCCESS);
+	}
+
+	CHECK_EQ(writer.Dropped, 0);
+}
+
+//The cursor sees every transfer the bus made, in order
+static VOID test_parse(VOID) {
+	DA7219_CAPTURE_CURSOR cursor;
+	DA7219_CAPTURE_XFER xfer;
+	ULONG records = 0;
+
+	record(TRUE);
+
+	da7219_capture_open(&cursor, writer.Buffer, writer.Used);
+	while (da7219_capture_next(&cursor, &xfer)) {
+		if (records < DA7219_SIM_LOG_MAX) {
+			PDA7219_SIM_XFER logged = &sim.Log[records];
+
+			CHECK_EQ(xfer.Direction == SPB_CAPTURE_WRITE, logged->Write);
+			CHECK_EQ(xfer.Reg, logged->Reg);
+			CHECK_EQ(xfer.Count, logged->Count);
+		}
+		CHECK_EQ(xfer.Offset % 8, 0);
+		records++;
+	}
+	CHECK(!cursor.Malformed);
+	CHECK_EQ(cursor.Offset, writer.Used);
+	CHECK_EQ(records, sim.LogCount);
+
+	//The unwritten rest of a capture buffer ends the records
+	da7219_capture_open(&cursor, writer.Buffer, sizeof(writer.Buffer));
+	for (records = 0; da7219_capture_next(&cursor, &xfer); records++);
+	CHECK(!cursor.Malformed);
+	CHECK_EQ(records, sim.LogCount);
+
+	//A record cut short is malformed, not the end
+	da7219_capture_open(&cursor, writer.Buffer, writer.Used - 8);
+	for (records = 0; da7219_capture_next(&cursor, &xfer); records++);
+	CHECK(cursor.Malformed);
+	CHECK_EQ(records, sim.LogCount - 1);
+}
+
+//A raw write carries its address in the payload
+static VOID test_raw_write(VOID) {
+	UCHAR buffer[32];
+	SPB_CAPTURE_RECORD raw;
+	DA7219_CAPTURE_CURSOR cursor;
+	DA7219_CAPTURE_XFER xfer;
+
+	RtlZeroMemory(buffer, sizeof(buffer));
+	RtlZeroMemory(&raw, sizeof(raw));
+	raw.Length = 32;
+	raw.Direction = SPB_CAPTURE_WRITE;
+	raw.DataLength = 2;
+	RtlCopyMemory(buffer, &raw, sizeof(raw));
+	buffer[sizeof(raw)] = DA7219_CIF_CTRL;
+	buffer[sizeof(raw) + 1] = DA7219_CIF_REG_SOFT_RESET_MASK;
+
+	da7219_capture_open(&cursor, buffer, sizeof(buffer));
+	CHECK(da7219_capture_next(&cursor, &xfer));
+	CHECK_EQ(xfer.Reg, DA7219_CIF_CTRL);
+	CHECK_EQ(xfer.Count, 1);
+	CHECK_EQ(xfer.Data[0], DA7219_CIF_REG_SOFT_RESET_MASK);
+	CHECK(!da7219_capture_next(&cursor, &xfer));
+}
+
+//Replaying a session through the core makes every recorded transfer again
+static VOID test_replay_core(VOID) {
+	DA7219_REPLAY replay;
+	DA7219_BUS bus;
+	DA7219_IRQ_EVENTS events;
+
+	record(TRUE);
+
+	da7219_replay_init(&replay, writer.Buffer, writer.Used, DA7219_CAPTURE_FREQUENCY);
+	da7219_replay_bus(&replay, &bus);
+	da7219_codec_init(&codec, &bus);
+
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	CHECK_EQ(da7219_suspend_blocking(&codec), STATUS_SUCCESS);
+	CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+	CHECK_EQ(da7219_codec_irq(&codec, &events), STATUS_SUCCESS);
+	CHECK_EQ(da7219_codec_irq(&codec, &events), STATUS_SUCCESS);
+	CHECK_EQ(da7219_codec_irq(&codec, &events), STATUS_SUCCESS);
+
+	CHECK_EQ(replay.Divergences, 0);
+	CHECK_EQ(replay.Consumed, sim.LogCount);
+	CHECK(da7219_replay_done(&replay));
+
+	//Another platform boots differently and the replay says where
+	da7219_replay_init(&replay, writer.Buffer, writer.Used, DA7219_CAPTURE_FREQUENCY);
+	da7219_codec_init(&codec, &bus);
+	da7219_boot_blocking(&codec, PlatformStoney);
+	CHECK(replay.Divergences > 0);
+	CHECK(replay.FirstDivergence < writer.Used);
+	CHECK(!da7219_replay_done(&replay));
+}
+
+//Applying a capture to a fresh simulator leaves it as the recording did,
+//over the same transfers
+static VOID test_apply(VOID) {
+	static DA7219_SIM applied;
+	DA7219_BUS_STATS recorded, replayed;
+
+	record(FALSE);
+	da7219_sim_stats(&sim, &recorded, FALSE);
+
+	da7219_sim_init(&applied);
+	CHECK_EQ(da7219_replay_apply(&applied, writer.Buffer, writer.Used, DA7219_CAPTURE_FREQUENCY), 0);
+	da7219_sim_stats(&applied, &replayed, FALSE);
+
+	for (ULONG reg = 0; reg < DA7219_REG_COUNT; reg++) {
+		if ((da7219_reg_info[reg].Flags & DA7219_REG_WRITABLE) && !(da7219_reg_info[reg].Flags & DA7219_REG_VOLATILE)) {
+			CHECK_EQ(applied.Regs[reg], sim.Regs[reg]);
+		}
+	}
+
+	CHECK_EQ(replayed.Writes, recorded.Writes);
+	CHECK_EQ(replayed.BytesWritten, recorded.BytesWritten);
+	CHECK_EQ(replayed.BytesRead, recorded.BytesRead);
+	CHECK(replayed.Reads >= recorded.Reads);
+}
+
+int main(void) {
+	test_parse();
+	test_raw_write();
+	test_replay_core();
+	test_apply();
+	return CHECK_EXIT();
+}
@@ -0,0 +1,235 @@
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "ring.h"
+#include "check.h"
+
+#define PRODUCERS       4
+#define CONSUMERS       4
+#define PER_PRODUCER    200000
+
+//Report payload: producer, 32-bit sequence, then a checksum, 5 to 8 bytes long
+static ULONG make_report(UCHAR* data, ULONG producer, ULONG seq) {
+	ULONG length = 5 + seq % 4;
+
+	data[0] = (UCHAR)producer;
+	RtlCopyMemory(&data[1], &seq, sizeof(seq));
+	for (ULONG i = 5; i < length; i++) {
+		data[i] = (UCHAR)(data[0] ^ data[1] ^ data[2] ^ data[3] ^ data[4] ^ i);
+	}
+	return length;
+}
+
+static VOID test_bounds(VOID) {
+	static DA7219_REPORT_RING ring;
+	UCHAR report[DA7219_REPORT_MAX_LENGTH + 1] = { 0 };
+	ULONG length;
+	UCHAR event;
+	uint64_t timestamp;
+
+	Da7219ReportRingInit(&ring);
+	CHECK(!Da7219ReportRingReady(&ring));
+	CHECK(!Da7219ReportRingPop(&ring, report, &length, &event, &timestamp));
+
+	//Oversized reports are refused without counting as an overflow
+	CHECK(!Da7219ReportRingPush(&ring, report, sizeof(report), 0, 0));
+	CHECK_EQ(ring.Overflows, 0);
+
+	for (ULONG i = 0; i < DA7219_REPORT_RING_SIZE; i++) {
+		length = make_report(report, 1, i);
+		CHECK(Da7219ReportRingPush(&ring, report, length, (UCHAR)i, i));
+	}
+	CHECK(!Da7219ReportRingPush(&ring, report, 5, 0, 0));
+	CHECK(!Da7219ReportRingPush(&ring, report, 5, 0, 0));
+	CHECK_EQ(ring.Overflows, 2);
+	CHECK_EQ(ring.Queued, DA7219_REPORT_RING_SIZE);
+
+	//FIFO, with every field intact
+	for (ULONG i = 0; i < DA7219_REPORT_RING_SIZE; i++) {
+		UCHAR expected[DA7219_REPORT_MAX_LENGTH];
+		ULONG expectedLength = make_report(expected, 1, i);
+
+		CHECK(Da7219ReportRingReady(&ring));
+		CHECK(Da7219ReportRingPop(&ring, report, &length, &event, &timestamp));
+		CHECK_EQ(length, expectedLength);
+		CHECK(memcmp(report, expected, length) == 0);
+		CHECK_EQ(event, i);
+		CHECK_EQ(timestamp, i);
+	}
+	CHECK(!Da7219ReportRingReady(&ring));
+
+	//Positions wrap past LONG_MAX
+	Da7219ReportRingInit(&ring);
+	LONG base = (LONG)0x7FFFFFF0;
+	for (LONG i = 0; i < DA7219_REPORT_RING_SIZE; i++) {
+		LONG pos = (LONG)((ULONG)base + i);
+		ring.Slots[pos & (DA7219_REPORT_RING_SIZE - 1)].Sequence = pos;
+	}
+	ring.Head = ring.Tail = base;
+	for (ULONG i = 0; i < 4 * DA7219_REPORT_RING_SIZE; i++) {
+		length = make_report(report, 2, i);
+		CHECK(Da7219ReportRingPush(&ring, report, length, 0, i));
+		CHECK(Da7219ReportRingPop(&ring, report, &length, &event, &timestamp));
+		CHECK_EQ(timestamp, i);
+	}
+	CHECK(ring.Head < 0);
+	CHECK_EQ(ring.Overflows, 0);
+}
+
+typedef struct _STRESS
+{
+	DA7219_REPORT_RING Ring;
+
+	volatile LONG ProducersDone;
+
+	ULONG Consumers;
+
+	LONG Failed[PRODUCERS]; // pushes refused because the ring was full, then retried
+
+	UCHAR Pushed[PRODUCERS][PER_PRODUCER];
+
+	volatile UCHAR Popped[PRODUCERS][PER_PRODUCER];
+
+	volatile LONG OutOfOrder; // a producer's reports seen out of order, only meaningful with one consumer
+
+	volatile LONG Corrupt;
+
+} STRESS;
+
+static STRESS stress;
+
+typedef struct _THREAD_ARG
+{
+	ULONG Index;
+
+	LONG LastSeq[PRODUCERS];
+
+} THREAD_ARG;
+
+static void* producer(void* context) {
+	THREAD_ARG* arg = context;
+	UCHAR report[DA7219_REPORT_MAX_LENGTH];
+
+	for (ULONG seq = 0; seq < PER_PRODUCER; seq++) {
+		ULONG length = make_report(report, arg->Index, seq);
+
+		//A full ring refuses the report and counts an overflow, keep offering it until it fits
+		while (!Da7219ReportRingPush(&stress.Ring, report, length, (UCHAR)arg->Index, (uint64_t)arg->Index << 32 | seq)) {
+			stress.Failed[arg->Index]++;
+			sched_yield();
+		}
+		stress.Pushed[arg->Index][seq] = 1;
+	}
+	return NULL;
+}
+
+static BOOLEAN consume_one(THREAD_ARG* arg) {
+	UCHAR report[DA7219_REPORT_MAX_LENGTH];
+	UCHAR expected[DA7219_REPORT_MAX_LENGTH];
+	ULONG length;
+	UCHAR event;
+	uint64_t timestamp;
+	ULONG seq;
+
+	if (!Da7219ReportRingPop(&stress.Ring, report, &length, &event, &timestamp)) {
+		return FALSE;
+	}
+
+	RtlCopyMemory(&seq, &report[1], sizeof(seq));
+	if (report[0] >= PRODUCERS || seq >= PER_PRODUCER ||
+		length != make_report(expected, report[0], seq) ||
+		memcmp(report, expected, length) != 0 ||
+		event != report[0] || timestamp != ((uint64_t)report[0] << 32 | seq)) {
+		__sync_add_and_fetch(&stress.Corrupt, 1);
+		return TRUE;
+	}
+
+	__sync_add_and_fetch(&stress.Popped[report[0]][seq], 1);
+	if ((LONG)seq <= arg->LastSeq[report[0]]) {
+		__sync_add_and_fetch(&stress.OutOfOrder, 1);
+	}
+	arg->LastSeq[report[0]] = (LONG)seq;
+	return TRUE;
+}
+
+static void* consumer(void* context) {
+	THREAD_ARG* arg = context;
+
+	for (;;) {
+		if (consume_one(arg)) {
+			continue;
+		}
+		//Producers are joined before ProducersDone is set, so an empty ring then stays empty
+		if (__atomic_load_n(&stress.ProducersDone, __ATOMIC_ACQUIRE)) {
+			while (consume_one(arg))
+				;
+			return NULL;
+		}
+		sched_yield();
+	}
+}
+
+static VOID run_stress(ULONG consumers) {
+	pthread_t producers[PRODUCERS], readers[CONSUMERS];
+	THREAD_ARG producerArgs[PRODUCERS], consumerArgs[CONSUMERS];
+	struct timespec start, end;
+	LONG failed = 0, pushed = 0, popped = 0;
+
+	RtlZeroMemory(&stress, sizeof(stress));
+	Da7219ReportRingInit(&stress.Ring);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (ULONG i = 0; i < consumers; i++) {
+		consumerArgs[i].Index = i;
+		for (ULONG p = 0; p < PRODUCERS; p++) {
+			consumerArgs[i].LastSeq[p] = -1;
+		}
+		pthread_create(&readers[i], NULL, consumer, &consumerArgs[i]);
+	}
+	for (ULONG i = 0; i < PRODUCERS; i++) {
+		producerArgs[i].Index = i;
+		pthread_create(&producers[i], NULL, producer, &producerArgs[i]);
+	}
+	for (ULONG i = 0; i < PRODUCERS; i++) {
+		pthread_join(producers[i], NULL);
+	}
+	__atomic_store_n(&stress.ProducersDone, 1, __ATOMIC_RELEASE);
+	for (ULONG i = 0; i < consumers; i++) {
+		pthread_join(readers[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	//Every report comes out exactly once, every refusal is counted as an overflow
+	for (ULONG p = 0; p < PRODUCERS; p++) {
+		failed += stress.Failed[p];
+		for (ULONG seq = 0; seq < PER_PRODUCER; seq++) {
+			pushed += stress.Pushed[p][seq];
+			popped += stress.Popped[p][seq];
+			if (stress.Popped[p][seq] != stress.Pushed[p][seq]) {
+				CHECK_EQ(stress.Popped[p][seq], stress.Pushed[p][seq]);
+				break;
+			}
+		}
+	}
+	CHECK_EQ(stress.Corrupt, 0);
+	CHECK_EQ(pushed, PRODUCERS * PER_PRODUCER);
+	CHECK_EQ(popped, pushed);
+	CHECK_EQ(stress.Ring.Queued, pushed);
+	CHECK_EQ(stress.Ring.Overflows, failed);
+	CHECK(!Da7219ReportRingReady(&stress.Ring));
+	if (consumers == 1) {
+		CHECK_EQ(stress.OutOfOrder, 0);
+	}
+
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%u producers, %u consumers: %d reports, %d overflows, %.0f reports/s\n",
+		PRODUCERS, consumers, pushed, failed, pushed / seconds);
+}
+
+int main(void) {
+	test_bounds();
+	run_stress(1);
+	run_stress(CONSUMERS);
+	return CHECK_EXIT();
+}
@@ -0,0 +1,184 @@
+#include "sim.h"
+#include "registers.h"
+#include "registers-aad.h"
+#include "check.h"
+
+static uint8_t read1(DA7219_BUS* bus, uint8_t reg) {
+	uint8_t val = 0;
+	bus->Read(bus->Context, reg, &val, 1);
+	return val;
+}
+
+static VOID write1(DA7219_BUS* bus, uint8_t reg, uint8_t val) {
+	bus->Write(bus->Context, reg, &val, 1);
+}
+
+static VOID test_registers(VOID) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+
+	//Reset defaults
+	CHECK_EQ(read1(&bus, DA7219_SR), 0x0A);
+	CHECK_EQ(read1(&bus, DA7219_CHIP_ID1), 0x23);
+	CHECK_EQ(read1(&bus, DA7219_ACCDET_CONFIG_1), 0xD6);
+	CHECK_EQ(read1(&bus, DA7219_SYSTEM_ACTIVE), 0);
+
+	//Read-only and unmapped addresses drop writes
+	write1(&bus, DA7219_CHIP_ID1, 0x00);
+	write1(&bus, 0xFF, 0x55);
+	CHECK_EQ(read1(&bus, DA7219_CHIP_ID1), 0x23);
+	CHECK_EQ(read1(&bus, 0xFF), 0);
+	CHECK_EQ(sim.DroppedWrites, 2);
+
+	//Page mode auto-increments, gain status follows the gain
+	uint8_t gains[2] = { 0x30, 0x31 };
+	bus.Write(bus.Context, DA7219_HP_L_GAIN, gains, 2);
+	CHECK_EQ(read1(&bus, DA7219_HP_R_GAIN), 0x31);
+	CHECK_EQ(read1(&bus, DA7219_HP_L_GAIN_STATUS), 0x30);
+
+	//Repeat mode takes address/data pairs after the first byte
+	write1(&bus, DA7219_CIF_CTRL, DA7219_CIF_I2C_WRITE_MODE_MASK);
+	uint8_t pairs[3] = { 0x20, DA7219_HP_R_GAIN, 0x21 };
+	bus.Write(bus.Context, DA7219_HP_L_GAIN, pairs, 3);
+	CHECK_EQ(read1(&bus, DA7219_HP_L_GAIN), 0x20);
+	CHECK_EQ(read1(&bus, DA7219_HP_R_GAIN), 0x21);
+
+	//Soft reset restores the defaults and clears itself
+	write1(&bus, DA7219_SR, 0x01);
+	write1(&bus, DA7219_CIF_CTRL, DA7219_CIF_REG_SOFT_RESET_MASK);
+	CHECK_EQ(read1(&bus, DA7219_SR), 0x0A);
+	CHECK_EQ(read1(&bus, DA7219_HP_L_GAIN), 0x39);
+	CHECK_EQ(read1(&bus, DA7219_CIF_CTRL), 0);
+}
+
+static VOID test_settle(VOID) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+
+	CHECK_EQ(read1(&bus, DA7219_SYSTEM_STATUS), 0);
+	write1(&bus, DA7219_SYSTEM_MODES_OUTPUT, 0x01);
+	CHECK(read1(&bus, DA7219_SYSTEM_STATUS) != 0);
+	bus.Delay(bus.Context, DA7219_SIM_SETTLE_US / 1000 - 1);
+	CHECK(read1(&bus, DA7219_SYSTEM_STATUS) != 0);
+	bus.Delay(bus.Context, 1);
+	CHECK_EQ(read1(&bus, DA7219_SYSTEM_STATUS), 0);
+
+	sim.SettleUs = DA7219_SIM_NEVER_SETTLES;
+	write1(&bus, DA7219_SYSTEM_MODES_INPUT, 0x00);
+	bus.Delay(bus.Context, 1000);
+	CHECK(read1(&bus, DA7219_SYSTEM_STATUS) != 0);
+}
+
+static VOID test_accdet(VOID) {
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	uint8_t accdet[4];
+
+	da7219_sim_init(&sim);
+	da7219_sim_bus(&sim, &bus);
+	CHECK(!da7219_sim_irq_asserted(&sim));
+
+	da7219_sim_jack_insert(&sim);
+	da7219_sim_jack_detect(&sim, TRUE);
+	CHECK(da7219_sim_irq_asserted(&sim));
+	bus.Read(bus.Context, DA7219_ACCDET_STATUS_A, accdet, sizeof(accdet));
+	CHECK_EQ(accdet[0] & (DA7219_JACK_INSERTION_STS_MASK | DA7219_JACK_TYPE_STS_MASK),
+		DA7219_JACK_INSERTION_STS_MASK | DA7219_JACK_TYPE_STS_MASK);
+	CHECK_EQ(accdet[2], DA7219_E_JACK_INSERTED_MASK | DA7219_E_JACK_DETECT_COMPLETE_MASK);
+
+	//Reading does not clear, writing 1 does and only for the bits written
+	CHECK(da7219_sim_irq_asserted(&sim));
+	write1(&bus, DA7219_ACCDET_IRQ_EVENT_A, DA7219_E_JACK_INSERTED_MASK);
+	CHECK_EQ(read1(&bus, DA7219_ACCDET_IRQ_EVENT_A), DA7219_E_JACK_DETECT_COMPLETE_MASK);
+	write1(&bus, DA7219_ACCDET_IRQ_EVENT_A, DA7219_E_JACK_DETECT_COMPLETE_MASK);
+	CHECK(!da7219_sim_irq_asserted(&sim));
+
+	//Status registers are the codec's, writes are dropped
+	write1(&bus, DA7219_ACCDET_STATUS_A, 0);
+	CHECK(read1(&bus, DA7219_ACCDET_STATUS_A) & DA7219_JACK_INSERTION_STS_MASK);
+
+	da7219_sim_button(&sim, 1, TRUE);
+	CHECK_EQ(read1(&bus, DA7219_ACCDET_IRQ_EVENT_B), DA7219_E_BUTTON_B_PRESSED_MASK);
+	write1(&bus, DA7219_ACCDET_IRQ_MASK_B, DA7219_M_BUTTON_B_PRESSED_MASK);
+	CHECK(!da7219_sim_irq_asserted(&sim));
+	da7219_sim_button(&sim, 1, FALSE);
+	CHECK(da7219_sim_irq_asserted(&sim));
+	CHECK_EQ(read1(&bus, DA7219_ACCDET_IRQ_EVENT_B), DA7219_E_BUTTON_B_PRESSED_MASK | DA7219_E_BUTTON_B_RELEASED_MASK);
+
+	da7219_sim_jack_remove(&sim);
+	CHECK_EQ(read1(&bus, DA7219_ACCDET_STATUS_A), 0);
+	CHECK(read1(&bus, DA7219_ACCDET_IRQ_EVENT_A) & DA7219_E_JACK_REMOVED_MASK);
+}
+
+static VOID test_cost(VOID) {
+	static const ULONG rates[] = { DA7219_I2C_STANDARD_HZ, DA7219_I2C_FAST_HZ, DA7219_I2C_FAST_PLUS_HZ };
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	DA7219_BUS_STATS stats;
+
+	for (ULONG i = 0; i < ARRAYSIZE(rates); i++) {
+		da7219_sim_init(&sim);
+		da7219_sim_set_cost(&sim, rates[i], 5000);
+		da7219_sim_bus(&sim, &bus);
+
+		//START, 3 bytes, repeated START and device address, STOP: 39 bit times
+		read1(&bus, DA7219_SR);
+		da7219_sim_stats(&sim, &stats, TRUE);
+		CHECK_EQ(stats.BusTimeNs, 39ULL * 1000000000ULL / rates[i] + 5000);
+
+		//START, 2 + 4 bytes, STOP: 56 bit times
+		uint8_t data[4] = { 0 };
+		bus.Write(bus.Context, DA7219_ACCDET_CONFIG_3, data, sizeof(data));
+		da7219_sim_stats(&sim, &stats, TRUE);
+		CHECK_EQ(stats.BusTimeNs, 56ULL * 1000000000ULL / rates[i] + 5000);
+		CHECK_EQ(bus.Now(bus.Context), (2 * 5000 + (39 + 56) * 1000000000ULL / rates[i]) / 1000);
+	}
+}
+
+//A whole boot and resume: the core's modeled bus time agrees with the simulator's at every rate
+static VOID test_boot_cost(VOID) {
+	static const ULONG rates[] = { DA7219_I2C_STANDARD_HZ, DA7219_I2C_FAST_HZ, DA7219_I2C_FAST_PLUS_HZ };
+	DA7219_SIM sim;
+	DA7219_BUS bus;
+	DA7219_CODEC codec;
+	DA7219_BUS_STATS seen, counted;
+
+	for (ULONG i = 0; i < ARRAYSIZE(rates); i++) {
+		da7219_sim_init(&sim);
+		da7219_sim_set_cost(&sim, rates[i], 20000);
+		da7219_sim_bus(&sim, &bus);
+		da7219_codec_init(&codec, &bus);
+		da7219_bus_set_cost(&codec, rates[i], 20000);
+
+		CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+		CHECK_EQ(sim.Regs[DA7219_SYSTEM_ACTIVE], DA7219_SYSTEM_ACTIVE_MASK);
+		CHECK_EQ(sim.DroppedWrites, 0);
+		da7219_sim_stats(&sim, &seen, TRUE);
+		da7219_bus_stats(&codec, &counted, TRUE);
+		CHECK_EQ(counted.BusTimeNs, seen.BusTimeNs);
+
+		da7219_suspend_blocking(&codec);
+		CHECK_EQ(da7219_boot_blocking(&codec, PlatformIntel), STATUS_SUCCESS);
+		CHECK(codec.BootResume);
+		da7219_sim_stats(&sim, &seen, TRUE);
+		da7219_bus_stats(&codec, &counted, TRUE);
+		CHECK_EQ(counted.BusTimeNs, seen.BusTimeNs);
+		CHECK_EQ(counted.Reads, seen.Reads);
+		CHECK_EQ(counted.Writes, seen.Writes);
+	}
+}
+
+int main(void) {
+	test_registers();
+	test_settle();
+	test_accdet();
+	test_cost();
+	test_boot_cost();
+	return CHECK_EXIT();
+}
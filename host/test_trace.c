@@ -0,0 +1,96 @@
+#include <pthread.h>
+
+#include "codec.h"
+#include "check.h"
+
+#define WRITERS         4
+#define PER_WRITER      200000
+
+static DA7219_TRACE trace;
+
+static volatile LONG writers_done;
+
+//Every field of a record is derived from one value, so a torn copy shows up as a mismatch
+static VOID write_record(ULONG value) {
+	da7219_trace_write(&trace, DA7219_TRACE_LEVEL_ERROR, (USHORT)(value & 0xFFFF), (uint8_t)value, value, (NTSTATUS)~value);
+}
+
+static BOOLEAN record_whole(const DA7219_TRACE_RECORD* record) {
+	return record->Event == (USHORT)(record->Value & 0xFFFF) &&
+		record->Reg == (uint8_t)record->Value &&
+		record->Status == (NTSTATUS)~record->Value &&
+		record->Level == DA7219_TRACE_LEVEL_ERROR;
+}
+
+static void* writer(void* context) {
+	ULONG base = (ULONG)(uintptr_t)context * PER_WRITER;
+
+	for (ULONG i = 0; i < PER_WRITER; i++) {
+		write_record(base + i);
+	}
+	__sync_add_and_fetch(&writers_done, 1);
+	return NULL;
+}
+
+//Sequences run on from the cursor in order, and a reader that falls behind skips ahead
+static VOID test_read(VOID) {
+	DA7219_TRACE_RECORD records[8];
+	ULONG first;
+
+	da7219_trace_init(&trace);
+	CHECK_EQ(da7219_trace_read(&trace, &first, records, ARRAYSIZE(records)), 0);
+
+	for (ULONG i = 0; i < 4; i++) {
+		write_record(i);
+	}
+	CHECK_EQ(da7219_trace_read(&trace, &first, records, ARRAYSIZE(records)), 4);
+	CHECK_EQ(first, 0);
+	for (ULONG i = 0; i < 4; i++) {
+		CHECK_EQ(records[i].Sequence, i);
+		CHECK(record_whole(&records[i]));
+	}
+
+	for (ULONG i = 0; i < DA7219_TRACE_RECORDS + 10; i++) {
+		write_record(i);
+	}
+	CHECK_EQ(da7219_trace_read(&trace, &first, records, ARRAYSIZE(records)), ARRAYSIZE(records));
+	CHECK_EQ(first, 4 + 10);
+}
+
+//Writers lap a reader that keeps reading, no copy it accepts may be torn
+static VOID test_concurrent(VOID) {
+	pthread_t threads[WRITERS];
+	DA7219_TRACE_RECORD records[16];
+	ULONG reads = 0, torn = 0;
+
+	da7219_trace_init(&trace);
+	writers_done = 0;
+	for (ULONG i = 0; i < WRITERS; i++) {
+		pthread_create(&threads[i], NULL, writer, (void*)(uintptr_t)i);
+	}
+
+	while (__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE) != WRITERS) {
+		ULONG first;
+		ULONG copied = da7219_trace_read(&trace, &first, records, ARRAYSIZE(records));
+
+		for (ULONG i = 0; i < copied; i++) {
+			if (records[i].Sequence != first + i || !record_whole(&records[i])) {
+				torn++;
+			}
+		}
+		reads += copied;
+	}
+
+	for (ULONG i = 0; i < WRITERS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	CHECK_EQ(torn, 0);
+	CHECK_EQ(trace.Next, WRITERS * PER_WRITER);
+	printf("%u records read while %u were written\n", reads, WRITERS * PER_WRITER);
+}
+
+int main(void) {
+	test_read();
+	test_concurrent();
+	return CHECK_EXIT();
+}